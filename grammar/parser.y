@@ -3,6 +3,7 @@
 
 %{
 	#include "parser.tab.hh"
+	#include "stream_compiler.hh"
 	// #include "lexer.hh"
 
 	extern int yylex(yy::parser::value_type *yylval, yy::parser::location_type* loc);
@@ -86,13 +87,36 @@
 
 // Root
 program: 
-	translation_unit { g_root = $$ = new program((translation_unit *) $1); }
+	translation_unit { g_root = $$ = $1 ? new program((translation_unit *) $1) : nullptr; }
 ;
 
 // Recursive rule for full program
 translation_unit:
-	translation_unit external_declaration { $$ = new translation_unit((translation_unit *) $1, (external_declaration *) $2); }
-|   external_declaration { $$ = new translation_unit((external_declaration *) $1); }
+	translation_unit external_declaration
+	{
+		if (g_stream)
+		{
+			// Streaming: compiled and freed right away, no tree is built
+			g_stream->compile((external_declaration *) $2);
+			$$ = $1;
+		}
+		else
+		{
+			$$ = new translation_unit((translation_unit *) $1, (external_declaration *) $2);
+		}
+	}
+|   external_declaration
+	{
+		if (g_stream)
+		{
+			g_stream->compile((external_declaration *) $1);
+			$$ = nullptr;
+		}
+		else
+		{
+			$$ = new translation_unit((external_declaration *) $1);
+		}
+	}
 ;
 
 // Global declarations: Functions and global variables
@@ -188,11 +212,11 @@ if_statement:
 ;
 
 while_statement:
-	WHILE condition statement { $$ = new while_statement((condition *) $2, (statement *) $3); }
+	WHILE condition statement { $$ = new while_statement((condition *) $2, (statement *) $3); $$->setLocation(@1.begin.line, @1.begin.column); }
 ;
 
 do_while_statement:
-	DO compound_statement WHILE condition { $$ = new do_while_statement((compound_statement *) $2, (condition *) $4); }
+	DO compound_statement WHILE condition { $$ = new do_while_statement((compound_statement *) $2, (condition *) $4); $$->setLocation(@1.begin.line, @1.begin.column); }
 ;
 
 expression_statement:
@@ -202,9 +226,9 @@ expression_statement:
 
 for_statement:
 	FOR OPEN_PAREN expression_statement expression_statement expression CLOSE_PAREN compound_statement
-	{ $$ = new for_statement((expression *) $3, (expression *) $4, (expression *) $5, (compound_statement *) $7); }
+	{ $$ = new for_statement((expression *) $3, (expression *) $4, (expression *) $5, (compound_statement *) $7); $$->setLocation(@1.begin.line, @1.begin.column); }
 |	FOR OPEN_PAREN expression_statement expression_statement CLOSE_PAREN compound_statement
-	{ $$ = new for_statement((expression *) $3, (expression *) $4, (compound_statement *) $6); }
+	{ $$ = new for_statement((expression *) $3, (expression *) $4, (compound_statement *) $6); $$->setLocation(@1.begin.line, @1.begin.column); }
 ;
 
 expression:
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef BITCODE_WRITER_
+#define BITCODE_WRITER_
+
+#include "ir_module.hh"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Writes an IRModule as LLVM bitcode (the format of LLVM 4.0 and later, with
+// a string table) so clang skips parsing text. Records are written
+// unabbreviated, only the string table blob needs an abbreviation.
+class BitcodeWriter
+{
+  private:
+    std::ostream &m_out;
+
+    // The bitstream: whole 32 bit words go to m_bytes, the rest waits in
+    // m_bits
+    std::string m_bytes;
+    uint64_t m_bits;
+    unsigned int m_bit_count;
+    unsigned int m_abbrev_width;
+
+    struct open_block
+    {
+        unsigned int abbrev_width;
+        size_t length_pos;
+    };
+    std::vector<open_block> m_open_blocks;
+
+    std::string m_strtab;
+    std::map<std::vector<uint64_t>, unsigned int> m_function_types;
+    std::map<std::vector<std::string>, unsigned int> m_attribute_lists;
+
+    // Value ids: globals, then functions, then the globals' initializers.
+    // Inside a function the arguments, its constants and the instruction
+    // results follow.
+    std::unordered_map<std::string, unsigned int> m_global_ids;
+    unsigned int m_module_values;
+    std::unordered_map<int, unsigned int> m_reg_ids;
+    std::map<std::pair<int, uint64_t>, unsigned int> m_constant_ids;
+    std::unordered_map<ir_block *, unsigned int> m_block_ids;
+
+    void emit(uint32_t value, unsigned int width);
+    void emitVBR(uint64_t value, unsigned int width);
+    void alignWord();
+    void enterBlock(unsigned int id, unsigned int abbrev_width);
+    void exitBlock();
+    void record(unsigned int code, std::vector<uint64_t> ops);
+    void textRecord(unsigned int code, std::vector<uint64_t> ops,
+                    std::string text);
+
+    unsigned int typeId(irType type);
+    unsigned int functionTypeId(ir_function &function);
+    uint64_t constantBits(const ir_value &value);
+    unsigned int valueId(const ir_value &value);
+    void pushValue(std::vector<uint64_t> &ops, const ir_value &value,
+                   unsigned int inst_id);
+    void pushValueAndType(std::vector<uint64_t> &ops, const ir_value &value,
+                          unsigned int inst_id);
+    void pushConstant(unsigned int &type, const ir_value &value);
+
+    void writeTypeTable(IRModule &module);
+    void writeAttributes(IRModule &module);
+    void writeModuleInfo(IRModule &module);
+    void writeFunction(ir_function &function);
+    void writeInstruction(ir_instruction &instr, unsigned int inst_id);
+
+  public:
+    BitcodeWriter(std::ostream &out);
+
+    void write(IRModule &module);
+};
+
+#endif
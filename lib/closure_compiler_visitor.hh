@@ -0,0 +1,230 @@
+#pragma once
+#ifndef CLOSURE_COMPILER_
+#define CLOSURE_COMPILER_
+
+#include "composite.hh"
+#include "composite_concrete.hh"
+#include "native_stack.hh"
+#include "symbol_table.hh"
+#include "task_pool.hh"
+#include "types.hh"
+#include "visitor.hh"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Closure compilation: every type checked function is translated once into a
+// tree of C++ lambdas that capture their children, slot indices and resolved
+// types. Running the program is a call of main's root lambda, so the hot path
+// has no visitor dispatch, no child list walking and no name lookup.
+class ClosureCompilerVisitor : public Visitor
+{
+  private:
+    union slot
+    {
+        int i;
+        float f;
+    };
+
+    // How a statement finished, replaces the evaluator's signal exceptions
+    enum flow
+    {
+        FLOW_NEXT,
+        FLOW_BREAK,
+        FLOW_CONTINUE,
+        FLOW_RETURN
+    };
+
+    // Thrown when a trial run runs out of steps or hits an error
+    struct stop_signal
+    {
+    };
+
+    struct compiled_function;
+
+    // Run state of one thread: a slot stack shared by all of its frames.
+    // Lambdas get it passed in, so forked calls can run on other threads.
+    struct machine
+    {
+        std::vector<slot> stack;
+        size_t base = 0;
+        size_t sp = 0;
+        slot ret = {0};
+        size_t depth = 0;
+        // Set by a tail call return, the caller's frame is reused for it
+        compiled_function *tail = nullptr;
+        unsigned long steps = 0;
+    };
+
+    typedef std::function<slot(machine &)> expr_fn;
+    typedef std::function<flow(machine &)> stmt_fn;
+
+    // Where a variable lives: a global index or an offset from machine::base
+    struct var_ref
+    {
+        bool global;
+        size_t index;
+    };
+
+    struct compiled_function
+    {
+        std::string name;
+        size_t frame_size;
+        stmt_fn body;
+    };
+
+    // Compile state, every visit leaves its result in m_expr/m_type or m_stmt
+    expr_fn m_expr;
+    dataType m_type;
+    stmt_fn m_stmt;
+    dataType m_return_type;
+    size_t m_frame_size;
+
+    std::vector<parameter> m_params;
+    std::vector<STNode *> m_args;
+    std::vector<STNode *> m_vars;
+
+    std::unordered_map<std::string, std::unique_ptr<compiled_function>>
+        m_functions;
+    std::vector<stmt_fn> m_init;
+    size_t m_global_count;
+
+    // Run state, the thread running main uses m_main
+    machine m_main;
+    std::vector<slot> m_globals;
+    std::unordered_map<std::string, size_t> m_global_slots;
+    std::vector<std::pair<std::string, dataType>> m_global_decls;
+    size_t m_max_call_depth;
+    // Deepest function body and the native stack one call of it can take
+    size_t m_nesting;
+    size_t m_stack_reserve;
+
+    // Calls plus loop iterations, 0 budget means unlimited
+    unsigned long m_step_budget;
+    bool m_finished;
+
+    // Parallel mode: the right operand of a binary expression between two
+    // pure calls is forked while the left one runs, down to m_fork_depth
+    std::unordered_set<std::string> m_pure;
+    std::unique_ptr<TaskPool> m_pool;
+    size_t m_threads;
+    size_t m_fork_depth;
+    std::mutex m_machines_lock;
+    std::vector<std::unique_ptr<machine>> m_machines;
+    static thread_local machine *t_machine;
+
+    void stop(std::string message);
+    void runtimeError(std::string s);
+    void countStep(machine &m);
+    compiled_function *functionNamed(std::string name);
+
+    expr_fn compileExpr(STNode *node, dataType &type);
+    stmt_fn compileStmt(STNode *node);
+    void compileBlock(STNode *node, std::vector<stmt_fn> &block);
+
+    var_ref resolve(std::string name, dataType &type);
+    slot &at(machine &m, var_ref ref);
+    expr_fn load(var_ref ref);
+    expr_fn store(var_ref ref, expr_fn value);
+    expr_fn convert(expr_fn fn, dataType from, dataType to);
+    expr_fn truth(expr_fn fn, dataType type);
+    expr_fn binary(nodeType op, expr_fn left, dataType left_type,
+                   expr_fn right, dataType right_type, dataType &type);
+
+    void binaryNode(STNode *node, nodeType op);
+    void compoundAssignment(STNode *node, nodeType op);
+    void increment(STNode *node, int delta, bool prefix);
+    void ensureStack(machine &m, size_t size);
+    void pushArguments(machine &m, std::vector<expr_fn> &args);
+    void enter(machine &m, compiled_function *fn, size_t base);
+    bool isForkable(STNode *node);
+    bool isPureExpression(STNode *node);
+    machine &threadMachine();
+    std::vector<expr_fn> compileArguments(function_call *node,
+                                          compiled_function *&callee);
+    int runMain();
+
+  public:
+    ClosureCompilerVisitor();
+
+    void setMaxCallDepth(size_t depth);
+
+    // Runs independent pure calls on threads workers, pure holds the names
+    // found by the PurityVisitor. Must be set before the tree is visited.
+    void setParallel(std::unordered_set<std::string> &pure, size_t threads,
+                     size_t fork_depth);
+
+    // Turns run() into a trial: it gives up after this many calls and loop
+    // iterations or on a runtime error instead of exiting
+    void setStepBudget(unsigned long steps);
+    bool isFinished();
+
+    // Globals in declaration order and their values once run() finished
+    std::vector<std::pair<std::string, dataType>> &getGlobals();
+    int getIntGlobal(std::string name);
+    float getFloatGlobal(std::string name);
+
+    // Runs the global initializers and main on a thread with room for
+    // m_max_call_depth calls of its most deeply nested function, returns
+    // main's result
+    int run();
+
+    void visitIDENTIFIER(IDENTIFIER *node) override;
+    void visitNUMBER(NUMBER *node) override;
+    void visitAddition(addition *node) override;
+    void visitSubtraction(subtraction *node) override;
+    void visitMultiplication(multiplication *node) override;
+    void visitDivision(division *node) override;
+    void visitMod(mod *node) override;
+    void visitLess(less *node) override;
+    void visitLessEquals(less_equals *node) override;
+    void visitGreater(greater *node) override;
+    void visitGreaterEquals(greater_equals *node) override;
+    void visitLogicEquals(logic_equals *node) override;
+    void visitLogicNotEquals(logic_not_equals *node) override;
+    void visitLogicAnd(logic_and *node) override;
+    void visitLogicOr(logic_or *node) override;
+    void visitLogicNot(logic_not *node) override;
+    void visitUnaryPlus(unary_plus *node) override;
+    void visitUnaryMinus(unary_minus *node) override;
+    void visitBitWiseAnd(bit_wise_and *node) override;
+    void visitBitWiseOr(bit_wise_or *node) override;
+    void visitBitWiseXor(bit_wise_xor *node) override;
+    void visitBitWiseNot(bit_wise_not *node) override;
+    void visitShiftLeft(shift_left *node) override;
+    void visitShiftRight(shift_right *node) override;
+    void visitPostfixIncrement(postfix_increment *node) override;
+    void visitPostfixDecrement(postfix_decrement *node) override;
+    void visitPrefixIncrement(prefix_increment *node) override;
+    void visitPrefixDecrement(prefix_decrement *node) override;
+    void visitAssignment(assignment *node) override;
+    void visitPlusAssignment(plus_assignment *node) override;
+    void visitMinusAssignment(minus_assignment *node) override;
+    void visitMulAssignment(mul_assignment *node) override;
+    void visitDivAssignment(div_assignment *node) override;
+    void visitModAssignment(mod_assignment *node) override;
+    void visitVariableDeclarationList(variable_declaration_list *node) override;
+    void visitVariableDeclarationStatement(
+        variable_declaration_statement *node) override;
+    void visitCompoundStatement(compound_statement *node) override;
+    void visitStatement(statement *node) override;
+    void visitCondition(condition *node) override;
+    void visitIfStatement(if_statement *node) override;
+    void visitWhileStatement(while_statement *node) override;
+    void visitDoWhileStatement(do_while_statement *node) override;
+    void visitForStatement(for_statement *node) override;
+    void visitContinue(continue_node *node) override;
+    void visitBreak(break_node *node) override;
+    void visitReturn(return_node *node) override;
+    void visitFunctionCall(function_call *node) override;
+    void visitFunctionDefinition(function_definition *node) override;
+    void visitFunctionDeclaration(function_declaration *node) override;
+    void visitParameterList(parameter_list *node) override;
+    void visitArgumentList(argument_list *node) override;
+};
+
+#endif
@@ -18,6 +18,12 @@ class STNode
     static int m_serialCounter;
     std::list<STNode *> m_children;
     STNode *m_parent;
+    // Where the node starts in the source, 0 when the parser didn't set it
+    unsigned int m_line;
+    unsigned int m_column;
+    // Shared by structurally equal subtrees of a function, -1 when the
+    // subtree appears once or isn't numbered
+    int m_value_number;
 
   public:
     STNode(nodeType nodeType, std::initializer_list<STNode *> children);
@@ -34,9 +40,14 @@ class STNode
     nodeType getNodeType();
     STNode *getParent();
     dataType getResolvedType();
+    unsigned int getLine();
+    unsigned int getColumn();
+    int getValueNumber();
 
     void setParent(STNode *parent);
     void setResolvedType(dataType type);
+    void setLocation(unsigned int line, unsigned int column);
+    void setValueNumber(int number);
 
     void printSyntaxTree(std::ofstream *dot);
     std::list<STNode *> &getChildrenList();
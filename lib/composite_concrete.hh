@@ -515,10 +515,16 @@ class translation_unit : public STNode
 
 class return_node : public STNode
 {
+  private:
+    tailCallKind m_tail_call;
+
   public:
     return_node(expression *expression);
     return_node();
 
+    tailCallKind getTailCall();
+    void setTailCall(tailCallKind kind);
+
     void accept(Visitor &v) override;
 };
 
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef CONSTANT_FOLDER_
+#define CONSTANT_FOLDER_
+
+#include "composite.hh"
+#include "composite_concrete.hh"
+#include "visitor.hh"
+
+// Replaces expressions whose operands are all literals by the literal they
+// evaluate to. Runs after the type checker and follows the emitter's rules:
+// an int meeting a float is promoted, ints wrap like i32 and anything that
+// would trap or is undefined at run time (x / 0, overlong shifts) is kept.
+class ConstantFolderVisitor : public Visitor
+{
+  private:
+    unsigned int m_folded;
+
+    void fold(STNode *node);
+    bool foldBinary(STNode *node, NUMBER *left, NUMBER *right,
+                    NUMBER *&result);
+    bool foldUnary(STNode *node, NUMBER *operand, NUMBER *&result);
+    void replace(STNode *node, NUMBER *value);
+
+  public:
+    ConstantFolderVisitor();
+
+    unsigned int getFolded();
+
+    // i32 arithmetic wraps in the emitted IR, so whatever computes it ahead
+    // of time does it in unsigned int and converts back with this
+    static int wrap(unsigned int value);
+
+    // Every node is folded after its children
+    void visitChildren(STNode *node) override;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef CSE_PASS_
+#define CSE_PASS_
+
+#include "pass_manager.hh"
+#include <string>
+
+// Common subexpression elimination: an instruction computing the same
+// operation on the same operands as one that dominates it is replaced by
+// that one's register. Loads of a global are reused within a block until a
+// store to it or a call, and a store's value stands in for the next load.
+class CsePass : public FunctionPass
+{
+  private:
+    static std::string key(ir_instruction &instr);
+
+  public:
+    std::string getName() override;
+    bool runOnFunction(ir_function &function) override;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#ifndef DEAD_CODE_PASS_
+#define DEAD_CODE_PASS_
+
+#include "pass_manager.hh"
+
+// Drops instructions whose result is never used and that have no side
+// effects, until none are left
+class DeadCodePass : public FunctionPass
+{
+  public:
+    std::string getName() override;
+    bool runOnFunction(ir_function &function) override;
+};
+
+#endif
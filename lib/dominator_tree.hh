@@ -0,0 +1,40 @@
+#pragma once
+#ifndef DOMINATOR_TREE_
+#define DOMINATOR_TREE_
+
+#include "ir_module.hh"
+#include <unordered_map>
+#include <vector>
+
+// Which blocks every path from the entry passes through, for the passes that
+// need to know that a value is computed before a use or a loop. Blocks the
+// entry can't reach are left out. The tree describes the function as it was
+// built and isn't updated when a pass changes the control flow.
+class DominatorTree
+{
+  public:
+    // One entry per edge, a block branching twice to the same target is
+    // listed twice
+    typedef std::unordered_map<ir_block *, std::vector<ir_block *>> pred_map;
+
+  private:
+    ir_block *m_entry;
+    std::vector<ir_block *> m_order;
+    std::unordered_map<ir_block *, size_t> m_index;
+    std::unordered_map<ir_block *, ir_block *> m_idom;
+    pred_map m_preds;
+
+  public:
+    DominatorTree(ir_function &function);
+
+    // The branch targets of the block's terminator, empty for ret and
+    // unreachable
+    static std::vector<ir_block *> successors(ir_block *block);
+
+    // Reverse postorder, a block comes after all of its dominators
+    std::vector<ir_block *> &getOrder();
+    pred_map &getPredecessors();
+    bool dominates(ir_block *dom, ir_block *block);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef DRIVER_
+#define DRIVER_
+
+#include "ir_module.hh"
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// Passes everything written to it straight on to a FILE *, the IRPrinter and
+// the BitcodeWriter already write in large pieces
+class PipeBuffer : public std::streambuf
+{
+  private:
+    FILE *m_file;
+
+  protected:
+    int overflow(int c) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+
+  public:
+    PipeBuffer();
+
+    void setFile(FILE *file);
+};
+
+// Turns the IR module into an executable with the local clang, which runs
+// the -O pipeline and links. The IR (text or bitcode) is piped to it, only
+// --save-temps puts it (and clang's own intermediates) on disk.
+class Driver
+{
+  private:
+    std::string m_clang;
+    unsigned int m_opt_level;
+    bool m_save_temps;
+    bool m_bitcode;
+
+    // State between open() and close()
+    std::string m_output;
+    std::string m_command;
+    std::ofstream m_file;
+    FILE *m_pipe;
+    PipeBuffer m_pipe_buffer;
+    std::ostream m_pipe_stream;
+
+    std::string quote(std::string arg);
+    void writeModule(IRModule &module, std::ostream &out);
+
+  public:
+    Driver();
+
+    void setClang(std::string clang);
+    void setOptLevel(unsigned int opt_level);
+    void setSaveTemps(bool save_temps);
+    void setBitcode(bool bitcode);
+
+    // The IR written to the returned stream becomes output once close()
+    // returns, --stream writes it one function at a time
+    std::ostream &open(std::string output);
+    void close();
+    void build(IRModule &module, std::string output);
+};
+
+#endif
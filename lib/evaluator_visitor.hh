@@ -1,7 +1,13 @@
 #pragma once
 #include "composite.hh"
 #include "composite_concrete.hh"
+#include "jit_compiler_visitor.hh"
+#include "memo_cache.hh"
+#include "native_stack.hh"
+#include "profiler.hh"
 #include "symbol_table.hh"
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #ifndef _EVALUATOR
 #define _EVALUATOR
@@ -30,13 +36,106 @@ class EvaluatorVisitor : public Visitor
     {
     };
 
+    struct tail_call_signal
+    {
+        FuncSymbol *func;
+        std::vector<Value> args;
+    };
+
+    // One interpreted call, the variables themselves live in the symbol
+    // table's scope frames
+    struct call_frame
+    {
+        FuncSymbol *func;
+    };
+
+    // The interpreter's call stack lives on the heap and is bounded by
+    // m_max_call_depth, run() sizes the native stack to match
+    std::vector<call_frame> m_call_stack;
+    size_t m_max_call_depth = 10000;
+    // Native stack one call of the most deeply nested function can take
+    size_t m_stack_reserve = 0;
+
+    // Tiered execution: every function starts interpreted, calls and loop
+    // back-edges are counted per function and once a function reaches the
+    // threshold it is handed to the JIT and the next call runs native code
+    unsigned long m_tier_threshold = 0;
+    STNode *m_program = nullptr;
+#if defined(__x86_64__)
+    std::vector<JitCompilerVisitor *> m_tiers;
+#endif
+    std::unordered_map<FuncSymbol *, unsigned long> m_hotness;
+    std::unordered_map<FuncSymbol *, bool> m_compilable;
+    std::unordered_map<FuncSymbol *, void *> m_compiled;
+
+    // Calls to pure int functions are answered from m_memo when possible
+    MemoCache *m_memo = nullptr;
+    std::unordered_set<FuncSymbol *> m_memoizable;
+
+    // Shadow stack samples and loop counts for --profile
+    Profiler *m_profiler = nullptr;
+
+    // A function whose body is just "return <small expression>;" without
+    // calls or assignments is evaluated right at the call: no frame, no
+    // scope and no symbols, identifiers are read from the arguments.
+    // nullptr for every function that doesn't qualify.
+    std::unordered_map<FuncSymbol *, STNode *> m_inline_bodies;
+    FuncSymbol *m_inline_func = nullptr;
+    std::vector<Value> *m_inline_args = nullptr;
+
+    // Subtrees that only read and compute and appear more than once in a
+    // function share a value number, the first one evaluated leaves its
+    // value in m_values. A value only counts while m_stamp is unchanged:
+    // every write, declaration, scope exit and call moves it on.
+    struct numbered_value
+    {
+        Value value;
+        unsigned long stamp;
+    };
+    std::vector<numbered_value> m_values;
+    unsigned long m_stamp = 1;
+
+    void numberValues(STNode *node);
+    void numberFunction(STNode *function);
+    void evaluate(STNode *node);
+
+    void countBackEdge();
+    void countIteration(STNode *loop);
+    void sampleStack();
+    bool isCompilable(FuncSymbol *func);
+    bool isCompilableTree(STNode *node);
+    void collectCallees(STNode *node, std::vector<FuncSymbol *> &callees);
+#if defined(__x86_64__)
+    void promote(FuncSymbol *func);
+    Value callCompiled(void *code, std::vector<Value> &values);
+#endif
+
+    STNode *inlineBody(FuncSymbol *func);
+    FuncSymbol *evaluateCall(function_call *node, std::vector<Value> &values);
+    void invoke(FuncSymbol *def, std::vector<Value> &values);
+
   public:
     EvaluatorVisitor();
-    ~EvaluatorVisitor() = default;
+    ~EvaluatorVisitor();
 
     // Helper to get the calculation result
     Value getResult();
 
+    // 0 keeps every function in the interpreter
+    void setTierThreshold(unsigned long threshold);
+
+    void setMaxCallDepth(size_t depth);
+    // Evaluates the program on a thread with room for m_max_call_depth calls
+    // of its most deeply nested function
+    void run(STNode *root);
+
+    // pure holds the names found by the PurityVisitor, 0 entries disables
+    void setMemoization(std::unordered_set<std::string> &pure, size_t entries);
+    MemoCache *getMemoCache();
+
+    // Samples the call stack and counts loop iterations while running
+    void setProfiler(Profiler *profiler);
+
     // Leaf Nodes
     void visitIDENTIFIER(IDENTIFIER *node) override;
     void visitNUMBER(NUMBER *node) override;
@@ -82,6 +181,7 @@ class EvaluatorVisitor : public Visitor
     void visitModAssignment(mod_assignment *node) override;
 
     // Statements & Control Flow
+    void visitCompoundStatement(compound_statement *node) override;
     void visitStatement(statement *node) override;
     void visitIfStatement(if_statement *node) override;
     void visitWhileStatement(while_statement *node) override;
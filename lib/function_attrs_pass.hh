@@ -0,0 +1,31 @@
+#pragma once
+#ifndef FUNCTION_ATTRS_PASS_
+#define FUNCTION_ATTRS_PASS_
+
+#include "pass_manager.hh"
+#include <unordered_map>
+
+// Infers function attributes from the call graph and the globals every
+// function reads or writes: nounwind, readnone / readonly and norecurse.
+// The summaries outlive a run, --stream hands the functions over one at a
+// time and releases each one once it is printed.
+class FunctionAttrsPass : public IRPass
+{
+  private:
+    struct summary
+    {
+        bool reads = false;
+        bool writes = false;
+        std::vector<std::string> callees;
+    };
+
+    std::unordered_map<std::string, summary> m_summaries;
+
+    bool reaches(std::string from, std::string to);
+
+  public:
+    std::string getName() override;
+    bool run(IRModule &module) override;
+};
+
+#endif
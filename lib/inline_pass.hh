@@ -0,0 +1,34 @@
+#pragma once
+#ifndef INLINE_PASS_
+#define INLINE_PASS_
+
+#include "pass_manager.hh"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Replaces calls to small functions by a copy of their body. Callees are
+// handled before their callers, so a helper that calls helpers is measured
+// after those were inlined into it. Functions on a call cycle are never
+// inlined, and a caller stops taking bodies once it grew past a limit.
+class InlinePass : public IRPass
+{
+  private:
+    std::unordered_map<std::string, ir_function *> m_functions;
+    std::unordered_set<std::string> m_recursive;
+    unsigned int m_inline_count;
+
+    static size_t size(ir_function &function);
+    void findRecursive(IRModule &module);
+    void inlineCall(ir_function &caller, size_t block, size_t index,
+                    ir_function &callee);
+    bool inlineCalls(ir_function &function);
+
+  public:
+    InlinePass();
+
+    std::string getName() override;
+    bool run(IRModule &module) override;
+};
+
+#endif
@@ -4,48 +4,149 @@
 
 #include "composite.hh"
 #include "composite_concrete.hh"
+#include "ir_module.hh"
 #include "symbol_table.hh"
 #include "types.hh"
 #include "visitor.hh"
-#include <fstream>
-#include <sstream>
+#include <memory>
 #include <stack>
+#include <unordered_map>
 #include <vector>
 
 class IREmitterVisitor : public Visitor
 {
   private:
-    unsigned int m_reg_count;
     unsigned int m_label_count;
-    unsigned int m_var_count;
-    std::ofstream m_file_ll;
-    std::stringstream m_global_init_buff;
-    std::ostream *m_ll;
-    std::string m_last_reg;
+    IRModule m_module;
+    ir_function *m_function;
+    ir_value m_last_value;
+    dataType m_return_type;
 
     std::vector<parameter> m_params;
     std::vector<STNode *> m_args;
     std::vector<STNode *> m_vars;
 
+    // Global initializers in declaration order that are not constant, they
+    // run in _init_globals
+    std::vector<std::pair<std::string, STNode *>> m_global_inits;
+    // Set once one of them calls a function. That function may read a
+    // later global, so from then on every global is initialized in order at
+    // run time.
+    bool m_init_calls;
+
+    // Set when main was evaluated at compile time, the program is then just
+    // the globals' final values and a main returning the result
+    bool m_precomputed;
+    int m_precomputed_result;
+
+    // -ffast-math: float operations get the fast flags
+    bool m_fast_math;
+
+    // With more than one thread function bodies wait here until the whole
+    // program was walked
+    size_t m_threads;
+    std::vector<std::pair<function_definition *, ir_function *>> m_deferred;
+
     std::stack<std::string> m_break_stack;
     std::stack<std::string> m_continue_stack;
 
-    std::string typeToString(dataType type);
-    std::string getNextReg();
-    std::string operandType(dataType type);
-    std::string compareType(dataType type);
-    std::string comparatorType(dataType type);
-    std::string boolConvertor(dataType type, std::string reg);
-    std::string getOne(dataType type);
-    void toInteger(dataType &type, std::string &reg);
+    // Function bodies are built in SSA form while they are emitted: locals
+    // and parameters never touch memory, every definition is recorded per
+    // block and reads across blocks become phis (Braun et al.). Phis are put
+    // at the block heads once the function is done.
+    struct ssa_block
+    {
+        std::unique_ptr<ir_block> block;
+        std::vector<size_t> preds;
+        bool sealed = false;
+        bool terminated = false;
+        // Opened after a terminator, dropped again if nothing lands in it
+        bool dead = false;
+        std::unordered_map<int, ir_value> defs;
+        std::vector<size_t> incomplete_phis;
+    };
+
+    struct ssa_phi
+    {
+        ir_value result;
+        size_t block;
+        int var;
+        std::vector<ir_value> operands;
+    };
+
+    std::vector<ssa_block> m_blocks;
+    std::unordered_map<std::string, size_t> m_block_ids;
+    std::vector<size_t> m_block_order;
+    size_t m_current_block;
+    std::vector<ssa_phi> m_phis;
+    std::unordered_map<int, ir_value> m_replaced;
+    std::vector<std::string> m_var_names;
+    std::vector<dataType> m_var_types;
+
+    ir_value emit(irOpcode op, irType type, std::vector<ir_value> operands,
+                  std::string predicate = "");
+    ir_value convert(irOpcode op, irType type, ir_value value);
+    ir_value boolConvertor(dataType type, ir_value value);
+    ir_value getOne(dataType type);
+    ir_value getZero(dataType type);
+    bool constantInitializer(STNode *var, dataType type, ir_value &value);
+    void toInteger(dataType &type, ir_value &value);
     void assignmentTypeTransition(dataType type1, dataType &type2);
     void binaryTypeTransition(dataType &type1, dataType &type2,
-                              std::string &reg1, std::string &reg2);
+                              ir_value &value1, ir_value &value2);
+
+    void arithmetic(STNode *node, irOpcode int_op, irOpcode float_op);
+    bool comparisonPredicates(nodeType type, std::string &int_pred,
+                              std::string &float_pred);
+    ir_value compare(STNode *node);
+    void comparison(STNode *node);
+    ir_value truthValue(STNode *node);
+    void branchOn(STNode *cond, std::string label_true,
+                  std::string label_false);
+    void logicValue(STNode *node, bool is_and);
+    void bitwise(STNode *node, irOpcode op);
+
+    size_t blockNamed(std::string label);
+    void startBlock(std::string label);
+    void sealBlock(std::string label);
+    void branch(std::string label);
+    void condBranch(ir_value cond, std::string label_true,
+                    std::string label_false);
+    void terminate();
+    bool leaveDeadBlock();
+
+    int newVariable(std::string name, dataType type);
+    void writeVariable(int var, size_t block, ir_value value);
+    ir_value readVariable(int var, size_t block);
+    ir_value readVariableRecursive(int var, size_t block);
+    void addPhiOperands(size_t phi);
+    ir_value replacement(ir_value value);
+    void removeTrivialPhis();
+    void beginFunction(ir_function *function, dataType return_type);
+    void endFunction();
+    void emitFunction(function_definition *node, ir_function *function);
+    void emitDeferred();
+
+    ir_value loadVar(VarSymbol *sym);
+    void storeVar(VarSymbol *sym, ir_value value);
+    void compoundAssignment(STNode *node, irOpcode int_op, irOpcode float_op);
+    void increment(STNode *node, bool up, bool prefix);
 
   public:
     IREmitterVisitor();
     ~IREmitterVisitor();
 
+    void setPrecomputedResult(int result);
+    void setFastMath(bool fast_math);
+    void setThreads(size_t threads);
+    void setPrecomputedGlobal(std::string name, int value);
+    void setPrecomputedGlobal(std::string name, float value);
+
+    IRModule &getModule();
+    // Emits the deferred bodies and _init_globals once every declaration
+    // was visited
+    void finishProgram();
+
     void visitIDENTIFIER(IDENTIFIER *node) override;
     void visitNUMBER(NUMBER *node) override;
     void visitAddition(addition *node) override;
@@ -62,6 +163,8 @@ class IREmitterVisitor : public Visitor
     void visitLogicAnd(logic_and *node) override;
     void visitLogicOr(logic_or *node) override;
     void visitLogicNot(logic_not *node) override;
+    void visitUnaryPlus(unary_plus *node) override;
+    void visitUnaryMinus(unary_minus *node) override;
     void visitBitWiseAnd(bit_wise_and *node) override;
     void visitBitWiseOr(bit_wise_or *node) override;
     void visitBitWiseXor(bit_wise_xor *node) override;
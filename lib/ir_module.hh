@@ -0,0 +1,171 @@
+#pragma once
+#ifndef IR_MODULE_
+#define IR_MODULE_
+
+#include "types.hh"
+#include <memory>
+#include <string>
+#include <vector>
+
+// In memory LLVM IR: the emitter builds it, passes rewrite it and the
+// IRPrinter writes the .ll file. Values are typed virtual registers that get
+// their %N numbers only when printed, so passes can add and drop instructions
+// freely.
+
+enum irType
+{
+    IR_VOID,
+    IR_I1,
+    IR_I32,
+    IR_FLOAT,
+    IR_DOUBLE,
+    // Only inside strength reduced divisions, for the high half of a product
+    IR_I64
+};
+
+enum irValueKind
+{
+    VAL_NONE,
+    VAL_REG,
+    VAL_INT,
+    VAL_FLOAT,
+    VAL_GLOBAL
+};
+
+enum irOpcode
+{
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_SDIV,
+    OP_SREM,
+    OP_FADD,
+    OP_FSUB,
+    OP_FMUL,
+    OP_FDIV,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_SHL,
+    OP_ASHR,
+    OP_ICMP,
+    OP_FCMP,
+    OP_ZEXT,
+    OP_SITOFP,
+    OP_FPTOSI,
+    OP_FPTRUNC,
+    OP_SEXT,
+    OP_TRUNC,
+    OP_LOAD,
+    OP_STORE,
+    OP_CALL,
+    OP_PHI,
+    OP_BR,
+    OP_COND_BR,
+    OP_RET,
+    OP_UNREACHABLE
+};
+
+struct ir_value
+{
+    irValueKind kind = VAL_NONE;
+    irType type = IR_VOID;
+    // Register id, integer constant or global name depending on kind
+    int reg = -1;
+    int ivalue = 0;
+    double fvalue = 0;
+    std::string global;
+
+    bool operator==(const ir_value &other) const;
+    bool operator!=(const ir_value &other) const;
+};
+
+ir_value irReg(irType type, int reg);
+ir_value irInt(int value, irType type = IR_I32);
+ir_value irFloat(double value, irType type = IR_FLOAT);
+ir_value irGlobal(irType type, std::string name);
+
+struct ir_block;
+
+struct ir_instruction
+{
+    irOpcode op;
+    // VAL_NONE for stores, branches, returns and void calls
+    ir_value result;
+    std::vector<ir_value> operands;
+    // Branch targets, or the incoming block of every phi operand
+    std::vector<ir_block *> targets;
+    // icmp/fcmp condition code
+    std::string predicate;
+    std::string callee;
+    tailCallKind tail = NO_TAIL_CALL;
+    // Signed overflow is undefined (add/sub/mul)
+    bool nsw = false;
+    // Fast-math flags on float arithmetic and fcmp
+    bool fast = false;
+
+    bool isTerminator() const;
+    bool hasSideEffects() const;
+};
+
+struct ir_block
+{
+    std::string label;
+    std::vector<ir_instruction> instructions;
+};
+
+struct ir_function
+{
+    std::string name;
+    irType return_type;
+    std::vector<ir_value> params;
+    std::vector<std::unique_ptr<ir_block>> blocks;
+    // Name hint of every register, empty ones are printed as numbers
+    std::vector<std::string> reg_names;
+    // Function attributes like nounwind, printed after the parameters
+    std::vector<std::string> attributes;
+
+    ir_value newReg(irType type, std::string name = "");
+    // Name hints made unique against each other and the block labels,
+    // unnamed registers stay empty
+    std::vector<std::string> uniqueNames();
+    ir_block *addBlock(std::string label);
+    // Rewrites every use of register from to value to
+    void replaceUses(int from, ir_value to);
+};
+
+struct ir_global
+{
+    std::string name;
+    irType type;
+    ir_value init;
+};
+
+class IRModule
+{
+  private:
+    std::vector<ir_global> m_globals;
+    std::vector<std::unique_ptr<ir_function>> m_functions;
+    std::string m_triple;
+    std::string m_datalayout;
+
+  public:
+    // Targets the host MINIC was built for
+    IRModule();
+
+    ir_global &addGlobal(std::string name, irType type, ir_value init);
+    ir_function *addFunction(std::string name, irType return_type);
+
+    std::vector<ir_global> &getGlobals();
+    ir_global *getGlobal(std::string name);
+    std::vector<std::unique_ptr<ir_function>> &getFunctions();
+    ir_function *getFunction(std::string name);
+
+    // Empty when the host is not known, clang then picks its default
+    std::string getTriple();
+    std::string getDataLayout();
+};
+
+irType toIRType(dataType type);
+
+#endif
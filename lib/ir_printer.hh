@@ -0,0 +1,59 @@
+#pragma once
+#ifndef IR_PRINTER_
+#define IR_PRINTER_
+
+#include "ir_module.hh"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Writes an IRModule as textual LLVM IR. Unnamed registers are numbered in
+// the order they are printed, named ones get a suffix when the name is taken.
+// The text is formatted straight into one large buffer that goes to the
+// stream with a single write whenever it fills up, so printing an
+// instruction allocates nothing.
+class IRPrinter
+{
+  private:
+    std::ostream &m_out;
+    std::vector<char> m_buffer;
+    size_t m_used;
+
+    // Per register of the current function: its unique name, or an empty
+    // name and its %N number
+    std::vector<std::string> m_names;
+    std::vector<unsigned int> m_numbers;
+
+    void flush();
+    void reserve(size_t size);
+    void put(char c);
+    void put(const char *text, size_t length);
+    void put(const char *text);
+    void put(const std::string &text);
+    void putNumber(long long value);
+    void putHex(uint64_t value);
+
+    void nameRegisters(ir_function &function);
+    void putType(irType type);
+    void putValue(const ir_value &value);
+    void putTypedValue(const ir_value &value);
+    void putFlags(ir_instruction &instr);
+    void printInstruction(ir_instruction &instr);
+    void writeHeader(IRModule &module);
+    void writeGlobals(IRModule &module);
+    void writeFunction(ir_function &function);
+
+  public:
+    IRPrinter(std::ostream &out);
+    ~IRPrinter();
+
+    void print(IRModule &module);
+    // --stream prints the module piece by piece: the header first, each
+    // function once it is done and the globals at the end
+    void printHeader(IRModule &module);
+    void printFunction(ir_function &function);
+    void printGlobals(IRModule &module);
+};
+
+#endif
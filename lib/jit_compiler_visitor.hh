@@ -0,0 +1,214 @@
+#pragma once
+#ifndef JIT_COMPILER_
+#define JIT_COMPILER_
+
+#include "composite.hh"
+#include "composite_concrete.hh"
+#include "symbol_table.hh"
+#include "types.hh"
+#include "visitor.hh"
+#include <cstdint>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The generated code is x86-64, on other hosts the JIT is left out, --jit is
+// refused and the interpreter never tiers up
+#if defined(__x86_64__)
+
+// Baseline template JIT: every node is translated to a fixed x86-64 sequence.
+// Int results live in eax and float results in xmm0, binary operands are
+// spilled with push/pop, locals live in the rbp frame. The generated code
+// follows the System V ABI so it can be called directly from C++.
+class JitCompilerVisitor : public Visitor
+{
+  private:
+    struct label_fixup
+    {
+        size_t offset;
+        int label;
+    };
+
+    struct call_fixup
+    {
+        size_t offset;
+        std::string name;
+    };
+
+    struct global_fixup
+    {
+        size_t offset;
+        int index;
+    };
+
+    // One stream of machine code, functions and global initializers are kept
+    // apart the same way the IR emitter keeps _init_globals in its own buffer
+    struct code_buffer
+    {
+        std::vector<uint8_t> bytes;
+        std::vector<long> labels;
+        std::vector<label_fixup> label_fixups;
+        std::vector<call_fixup> call_fixups;
+        std::vector<global_fixup> global_fixups;
+    };
+
+    code_buffer m_text;
+    code_buffer m_init;
+    code_buffer *m_code;
+
+    // Type of the value currently held in eax/xmm0
+    dataType m_last_type;
+    dataType m_return_type;
+    int m_frame_size;
+    int m_push_depth;
+    int m_return_label;
+    size_t m_frame_patch;
+    // Sizes the stack runMain gives the generated code
+    size_t m_largest_frame;
+    size_t m_nesting;
+
+    uint8_t *m_memory;
+    size_t m_memory_size;
+    std::vector<uint32_t> m_global_data;
+    std::vector<VarSymbol *> m_globals;
+    std::unordered_map<std::string, size_t> m_functions;
+
+    // Globals read and written in place in their VarSymbol, set when the JIT
+    // runs as the compiled tier next to the evaluator
+    bool m_share_globals;
+    // When not empty only these function definitions are compiled
+    std::unordered_set<std::string> m_only;
+
+    std::vector<parameter> m_params;
+    std::vector<STNode *> m_args;
+    std::vector<STNode *> m_vars;
+
+    std::stack<int> m_break_stack;
+    std::stack<int> m_continue_stack;
+
+    // Calls left before the depth limit, every prologue takes one and every
+    // epilogue gives it back, and the lowest rsp the prologue accepts.
+    // Generated code only ever runs on one thread at a time.
+    static long s_call_budget;
+    static size_t s_max_call_depth;
+    static char *s_stack_limit;
+    static void callLimitReached(const char *name);
+    static void divisionByZero();
+
+    void jitError(std::string s);
+
+    // Raw encoding helpers
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emitInt32(int32_t value);
+    void emitInt64(uint64_t value);
+    int newLabel();
+    void bindLabel(int label);
+    void emitJump(std::initializer_list<uint8_t> opcode, int label);
+    void resolveLabels(code_buffer &code);
+
+    // Value movement
+    void push();
+    void popInto(dataType type);
+    void loadVariable(VarSymbol *sym);
+    void storeVariable(VarSymbol *sym);
+    void globalAddress(VarSymbol *sym);
+    bool isGlobal(VarSymbol *sym);
+    VarSymbol *lookupVariable(std::string name);
+    void convert(dataType from, dataType to);
+    void truthValue();
+
+    // Shared shapes of the node translations
+    dataType binaryOperands(STNode *node, bool integer_only);
+    void checkDivisor();
+    void applyOperator(nodeType op, dataType type);
+    void comparison(nodeType op, dataType type);
+    void binary(STNode *node, nodeType op, bool integer_only);
+    void compoundAssignment(STNode *node, nodeType op);
+    void increment(STNode *node, bool add, bool prefix);
+    void call(function_call *node, bool tail);
+    void prologue(std::vector<parameter> &params, const std::string &name);
+    void epilogue();
+    void finalize();
+
+  public:
+    JitCompilerVisitor();
+    ~JitCompilerVisitor();
+
+    // Address of a compiled function, nullptr if it was never defined
+    void *getFunctionAddress(std::string name);
+
+    template <typename T> T getFunction(std::string name)
+    {
+        return reinterpret_cast<T>(getFunctionAddress(name));
+    }
+
+    int runMain();
+
+    static void setMaxCallDepth(size_t depth);
+    // Nested calls allowed from the next call into generated code on, which
+    // runs on the calling thread's stack
+    static void setCallBudget(size_t calls);
+
+    void shareGlobals();
+    void restrictTo(std::unordered_set<std::string> names);
+
+    void visitIDENTIFIER(IDENTIFIER *node) override;
+    void visitNUMBER(NUMBER *node) override;
+    void visitAddition(addition *node) override;
+    void visitSubtraction(subtraction *node) override;
+    void visitMultiplication(multiplication *node) override;
+    void visitDivision(division *node) override;
+    void visitMod(mod *node) override;
+    void visitLess(less *node) override;
+    void visitLessEquals(less_equals *node) override;
+    void visitGreater(greater *node) override;
+    void visitGreaterEquals(greater_equals *node) override;
+    void visitLogicEquals(logic_equals *node) override;
+    void visitLogicNotEquals(logic_not_equals *node) override;
+    void visitLogicAnd(logic_and *node) override;
+    void visitLogicOr(logic_or *node) override;
+    void visitLogicNot(logic_not *node) override;
+    void visitUnaryPlus(unary_plus *node) override;
+    void visitUnaryMinus(unary_minus *node) override;
+    void visitBitWiseAnd(bit_wise_and *node) override;
+    void visitBitWiseOr(bit_wise_or *node) override;
+    void visitBitWiseXor(bit_wise_xor *node) override;
+    void visitBitWiseNot(bit_wise_not *node) override;
+    void visitShiftLeft(shift_left *node) override;
+    void visitShiftRight(shift_right *node) override;
+    void visitPostfixIncrement(postfix_increment *node) override;
+    void visitPostfixDecrement(postfix_decrement *node) override;
+    void visitPrefixIncrement(prefix_increment *node) override;
+    void visitPrefixDecrement(prefix_decrement *node) override;
+    void visitAssignment(assignment *node) override;
+    void visitPlusAssignment(plus_assignment *node) override;
+    void visitMinusAssignment(minus_assignment *node) override;
+    void visitMulAssignment(mul_assignment *node) override;
+    void visitDivAssignment(div_assignment *node) override;
+    void visitModAssignment(mod_assignment *node) override;
+    void visitVariableDeclaration(variable_declaration *node) override;
+    void visitVariableDeclarationList(variable_declaration_list *node) override;
+    void visitVariableDeclarationStatement(
+        variable_declaration_statement *node) override;
+    void visitStatement(statement *node) override;
+    void visitCondition(condition *node) override;
+    void visitIfStatement(if_statement *node) override;
+    void visitWhileStatement(while_statement *node) override;
+    void visitDoWhileStatement(do_while_statement *node) override;
+    void visitForStatement(for_statement *node) override;
+    void visitContinue(continue_node *node) override;
+    void visitBreak(break_node *node) override;
+    void visitReturn(return_node *node) override;
+    void visitFunctionCall(function_call *node) override;
+    void visitFunctionDefinition(function_definition *node) override;
+    void visitFunctionDeclaration(function_declaration *node) override;
+    void visitParameterList(parameter_list *node) override;
+    void visitArgumentList(argument_list *node) override;
+    void visitProgram(program *node) override;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef LICM_PASS_
+#define LICM_PASS_
+
+#include "dominator_tree.hh"
+#include "pass_manager.hh"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Loop invariant code motion: moves computations whose operands don't change
+// inside a loop to the block right before it, inner loops first so a value
+// can travel out of a whole nest. Only what is safe to run when the loop runs
+// zero times is moved, and a global is only loaded early when the loop
+// neither stores to it nor calls a function that may write globals.
+class LicmPass : public IRPass
+{
+  private:
+    typedef DominatorTree::pred_map pred_map;
+
+    struct loop
+    {
+        ir_block *header;
+        std::unordered_set<ir_block *> body;
+    };
+
+    // Functions that store to a global, themselves or through a call, and
+    // every function looked at so far. Both outlive a run, since --stream
+    // hands the functions over one at a time.
+    std::unordered_set<std::string> m_writers;
+    std::unordered_set<std::string> m_known;
+
+    bool mayWrite(std::string function);
+    void findWriters(IRModule &module);
+    std::vector<loop> findLoops(DominatorTree &tree);
+    ir_block *preheader(ir_function &function, loop &current,
+                        std::vector<loop> &loops, pred_map &preds,
+                        std::vector<ir_block *> &order);
+    bool hoist(ir_function &function, loop &current,
+               std::vector<loop> &loops, pred_map &preds,
+               std::vector<ir_block *> &order);
+    bool runOnFunction(ir_function &function);
+
+  public:
+    std::string getName() override;
+    bool run(IRModule &module) override;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef MEMO_CACHE_
+#define MEMO_CACHE_
+
+#include "symbol_table.hh"
+#include <vector>
+
+// Results of pure function calls keyed on the argument values. The cache is
+// direct mapped: a new result replaces whatever lived in its slot, so memory
+// stays fixed no matter how many distinct calls a program makes.
+class MemoCache
+{
+  private:
+    struct entry
+    {
+        FuncSymbol *func;
+        std::vector<Value> args;
+        Value result;
+    };
+
+    std::vector<entry> m_entries;
+    size_t m_mask;
+    unsigned long m_hits;
+    unsigned long m_misses;
+
+    entry &slotOf(FuncSymbol *func, std::vector<Value> &args);
+
+  public:
+    // capacity is rounded up to a power of two
+    MemoCache(size_t capacity);
+
+    bool lookup(FuncSymbol *func, std::vector<Value> &args, Value &result);
+    void store(FuncSymbol *func, std::vector<Value> &args, Value result);
+
+    unsigned long getHits();
+    unsigned long getMisses();
+};
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef NATIVE_STACK_
+#define NATIVE_STACK_
+
+#include "composite.hh"
+#include <cstddef>
+#include <pthread.h>
+
+// The tree walking interpreters nest a few C++ frames per syntax tree level
+// and per call. They run on a thread whose stack is sized from the call depth
+// limit and the program's deepest nesting, and check before every call that
+// one more body still fits, so running out becomes a runtime error.
+class NativeStack
+{
+  private:
+    // Lowest usable address of this thread's stack
+    static thread_local char *t_limit;
+
+    static void mark();
+
+  public:
+    // Longest chain of nodes from node down to a leaf
+    static size_t nesting(STNode *node);
+
+    // Bytes for the given number of calls, each taking per_call plus
+    // per_level for every level of nesting, capped at 4 GiB
+    static size_t sizeFor(size_t calls, size_t per_call, size_t nesting,
+                          size_t per_level);
+
+    // Starts body(arg) on a thread with up to size bytes of stack, false
+    // when not even a small stack is available
+    static bool start(pthread_t &thread, size_t size, void *(*body)(void *),
+                      void *arg);
+    // start() and wait for the thread to finish
+    static bool run(size_t size, void *(*body)(void *), void *arg);
+
+    // Lowest address the calling thread's stack may grow to
+    static char *limit();
+
+    // True when less than reserve bytes are left on the calling thread
+    static bool exhausted(size_t reserve);
+};
+
+#endif
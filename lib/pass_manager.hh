@@ -0,0 +1,45 @@
+#pragma once
+#ifndef PASS_MANAGER_
+#define PASS_MANAGER_
+
+#include "ir_module.hh"
+#include <memory>
+#include <string>
+#include <vector>
+
+// A transformation over the in memory IR, run() returns whether it changed
+// anything
+class IRPass
+{
+  public:
+    virtual ~IRPass() = default;
+
+    virtual std::string getName() = 0;
+    virtual bool run(IRModule &module) = 0;
+};
+
+// Most passes look at one function at a time
+class FunctionPass : public IRPass
+{
+  public:
+    bool run(IRModule &module) override;
+    virtual bool runOnFunction(ir_function &function) = 0;
+};
+
+class PassManager
+{
+  private:
+    std::vector<std::unique_ptr<IRPass>> m_passes;
+    bool m_verbose;
+
+  public:
+    PassManager();
+
+    // The manager owns the pass
+    void add(IRPass *pass);
+    // Prints every pass and whether it changed the module to stderr
+    void setVerbose(bool verbose);
+    void run(IRModule &module);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef PROFILER_
+#define PROFILER_
+
+#include "composite.hh"
+#include <csignal>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sampling profiler for the interpreter. A CPU timer only raises a flag, the
+// interpreter checks it at calls and loop back-edges and records its shadow
+// stack there, so samples land on the next safe point after the tick.
+class Profiler
+{
+  private:
+    struct loop_count
+    {
+        std::string function;
+        unsigned long iterations;
+    };
+
+    static volatile sig_atomic_t s_pending;
+
+    unsigned int m_interval_us;
+    unsigned long m_samples;
+    std::map<std::string, unsigned long> m_stacks;
+    std::unordered_map<STNode *, loop_count> m_loops;
+
+    static void onTick(int signal);
+
+  public:
+    Profiler(unsigned int interval_us);
+
+    void start();
+    void stop();
+
+    bool due() { return s_pending; }
+    // stack is the shadow stack outermost first, frames joined by ';'
+    void sample(const std::string &stack);
+    void countIteration(STNode *loop, const std::string &function);
+
+    unsigned long getSamples();
+
+    // One "main;f;g count" line per distinct stack, the format flamegraph.pl
+    // and speedscope read
+    void writeCollapsed(std::ostream &out);
+    void writeLoops(std::ostream &out);
+};
+
+#endif
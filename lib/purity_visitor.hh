@@ -0,0 +1,43 @@
+#pragma once
+#ifndef PURITY_VISITOR_
+#define PURITY_VISITOR_
+
+#include "composite.hh"
+#include "composite_concrete.hh"
+#include "symbol_table.hh"
+#include "visitor.hh"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Finds the functions whose result depends only on their arguments: they
+// never read or write a global and only call pure functions. Runs after the
+// type checker, which owns the global symbols.
+class PurityVisitor : public Visitor
+{
+  private:
+    std::string m_current;
+    std::vector<parameter> m_params;
+
+    std::unordered_set<std::string> m_defined;
+    std::unordered_set<std::string> m_touches_globals;
+    std::unordered_map<std::string, std::unordered_set<std::string>> m_callees;
+    std::unordered_set<std::string> m_pure;
+
+    void solve();
+
+  public:
+    bool isPure(std::string name);
+    std::unordered_set<std::string> &getPureFunctions();
+
+    void visitIDENTIFIER(IDENTIFIER *node) override;
+    void visitVariableDeclaration(variable_declaration *node) override;
+    void visitFunctionCall(function_call *node) override;
+    void visitFunctionDefinition(function_definition *node) override;
+    void visitFunctionDeclaration(function_declaration *node) override;
+    void visitParameterList(parameter_list *node) override;
+    void visitProgram(program *node) override;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef SIMPLIFY_CFG_PASS_
+#define SIMPLIFY_CFG_PASS_
+
+#include "pass_manager.hh"
+#include <unordered_map>
+#include <vector>
+
+// Cleans up the control flow the emitter leaves behind: folds branches on
+// constants, drops code after a terminator and blocks that can't be
+// reached, removes phis with a single value, merges a block into its only
+// predecessor and lets branches skip blocks that only branch on.
+class SimplifyCfgPass : public FunctionPass
+{
+  private:
+    // One entry per edge, a block branching twice to the same target is
+    // listed twice
+    typedef std::unordered_map<ir_block *, std::vector<ir_block *>> pred_map;
+
+    pred_map predecessors(ir_function &function);
+    void removeIncoming(ir_block *block, ir_block *pred, bool all);
+
+    bool foldBranches(ir_function &function);
+    bool removeUnreachable(ir_function &function);
+    bool removeTrivialPhis(ir_function &function);
+    bool mergeBlocks(ir_function &function);
+    bool forwardEmptyBlocks(ir_function &function);
+    void eraseBlocks(ir_function &function, std::vector<ir_block *> &removed);
+
+  public:
+    std::string getName() override;
+    bool runOnFunction(ir_function &function) override;
+};
+
+#endif
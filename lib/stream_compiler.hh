@@ -0,0 +1,46 @@
+#pragma once
+#ifndef STREAM_COMPILER_
+#define STREAM_COMPILER_
+
+#include "composite.hh"
+#include "composite_concrete.hh"
+#include "constant_folder_visitor.hh"
+#include "ir_emitter_visitor.hh"
+#include "ir_printer.hh"
+#include "pass_manager.hh"
+#include "type_checker_visitor.hh"
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// --stream: the parser hands over every external declaration as soon as it is
+// reduced. It is type checked, folded and emitted right away and a function
+// is freed afterwards. Its IR goes through the passes, is printed and freed
+// too, so only one function body is in memory at a time. Passes that look
+// across functions only know summaries of the earlier ones, inline finds no
+// bodies to copy. Global declarations are kept because their initializers
+// run in _init_globals, and main waits for it.
+class StreamCompiler
+{
+  private:
+    TypeCheckerVisitor &m_checker;
+    ConstantFolderVisitor m_folder;
+    IREmitterVisitor &m_emitter;
+    PassManager &m_passes;
+    IRPrinter m_printer;
+    std::vector<external_declaration *> m_globals;
+    std::unique_ptr<ir_function> m_main;
+
+  public:
+    StreamCompiler(TypeCheckerVisitor &checker, IREmitterVisitor &emitter,
+                   PassManager &passes, std::ostream &out);
+    ~StreamCompiler();
+
+    void compile(external_declaration *node);
+    void finish();
+};
+
+// Set while parsing in streaming mode, the parser builds no tree then
+extern StreamCompiler *g_stream;
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef STRENGTH_REDUCE_PASS_
+#define STRENGTH_REDUCE_PASS_
+
+#include "pass_manager.hh"
+#include <vector>
+
+// Replaces integer mul, sdiv and srem by a constant with cheaper
+// instructions: a multiply by a power of two becomes a shift, a division by
+// a power of two a shift with a rounding fix for negative dividends, and any
+// other divisor a multiply by its magic number keeping the high half of the
+// product. A remainder subtracts the rounded down multiple.
+class StrengthReducePass : public FunctionPass
+{
+  private:
+    ir_function *m_function;
+    std::vector<ir_instruction> *m_out;
+
+    // Appends an instruction, into result when given or a new register
+    ir_value append(irOpcode op, irType type, std::vector<ir_value> operands,
+                    ir_value result = ir_value());
+
+    bool reduceMultiply(ir_instruction &instr);
+    ir_value divide(ir_value x, int divisor, ir_value result);
+    ir_value remainder(ir_value x, int divisor, ir_value result);
+
+  public:
+    std::string getName() override;
+    bool runOnFunction(ir_function &function) override;
+};
+
+#endif
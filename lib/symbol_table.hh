@@ -70,16 +70,21 @@ class VarSymbol : public Symbol
     Value m_value;
     dataType m_value_type;
     std::string m_ir_addr;
+    // Frame offset or storage index for back ends that don't use names
+    int m_slot;
 
   public:
     VarSymbol(Value value, std::string name, dataType type);
 
     Value getValue();
+    Value *getValueAddress();
     dataType getValueType();
     std::string getAddress();
+    int getSlot();
 
     void setValue(Value value);
     void setAddress(std::string addr);
+    void setSlot(int slot);
 };
 
 class ScopeFrame
@@ -100,14 +105,22 @@ class SymbolTable
 {
   private:
     SymbolTable();
+    SymbolTable(ScopeFrame *global);
 
     static SymbolTable *m_instance;
+    // Set on threads that work on their own scopes, see attachThread
+    static thread_local SymbolTable *t_instance;
     std::vector<std::unique_ptr<ScopeFrame>> scopeStack;
+    ScopeFrame *m_global;
 
   public:
     ~SymbolTable();
 
     static SymbolTable *getInstance();
+    // Gives the calling thread its own scope stack on top of the shared
+    // global frame, which must not change until detachThread
+    static void attachThread();
+    static void detachThread();
     int getCurrentId();
     void enterScope(int id);
     void exitScope();
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TASK_POOL_
+#define TASK_POOL_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <vector>
+
+// Work stealing pool. Every thread owns a deque, spawn() pushes on the
+// caller's own deque and idle threads steal from the other end. A thread
+// waiting in join() runs other tasks meanwhile, so joins never block a core.
+class TaskPool
+{
+  public:
+    struct task
+    {
+        std::function<void()> run;
+        std::atomic<bool> done{false};
+    };
+
+  private:
+    struct worker
+    {
+        std::mutex lock;
+        std::deque<task *> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::vector<pthread_t> m_threads;
+    std::atomic<bool> m_stop;
+
+    // Index of the calling thread's deque, threads outside the pool use 0
+    static thread_local size_t t_index;
+
+    task *pop(size_t index);
+    task *steal(size_t thief);
+    bool runOne(size_t index);
+    void loop(size_t index);
+
+  public:
+    // threads counts the caller, so threads - 1 helpers are started
+    TaskPool(size_t threads, size_t stack_size);
+    ~TaskPool();
+
+    void spawn(task *t);
+    void join(task *t);
+};
+
+#endif
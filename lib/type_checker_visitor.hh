@@ -17,6 +17,7 @@ class TypeCheckerVisitor : public Visitor
 
     // Helper fields to identify function correctness
     dataType m_expected_return_type;
+    FuncSymbol *m_current_function;
     bool m_found_return;
     unsigned int m_loop_depth;
 
@@ -82,6 +83,8 @@ class TypeCheckerVisitor : public Visitor
     void visitMultiplication(multiplication *node) override;
     void visitDivision(division *node) override;
     void visitMod(mod *node) override;
+    void visitUnaryPlus(unary_plus *node) override;
+    void visitUnaryMinus(unary_minus *node) override;
 
     // 7. Relational Operations (Result is T_INT/Bool)
     void visitLess(less *node) override;
@@ -10,6 +10,15 @@ enum dataType
     T_VOID
 };
 
+// How a return statement hands back the result of a call in tail position
+enum tailCallKind
+{
+    NO_TAIL_CALL,
+    TAIL_CALL,
+    // Caller and callee have the same signature
+    MUST_TAIL_CALL
+};
+
 enum SymbolType
 {
     VAR_SYM,
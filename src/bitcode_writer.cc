@@ -0,0 +1,850 @@
+#include "../lib/bitcode_writer.hh"
+#include <cstring>
+
+// Block ids, record codes and enum values of LLVM's bitcode format
+// (llvm/Bitcode/LLVMBitCodes.h)
+enum
+{
+    MODULE_BLOCK_ID = 8,
+    PARAMATTR_BLOCK_ID = 9,
+    PARAMATTR_GROUP_BLOCK_ID = 10,
+    CONSTANTS_BLOCK_ID = 11,
+    FUNCTION_BLOCK_ID = 12,
+    IDENTIFICATION_BLOCK_ID = 13,
+    VALUE_SYMTAB_BLOCK_ID = 14,
+    TYPE_BLOCK_ID = 17,
+    STRTAB_BLOCK_ID = 23
+};
+
+enum
+{
+    IDENTIFICATION_CODE_STRING = 1,
+    IDENTIFICATION_CODE_EPOCH = 2,
+
+    MODULE_CODE_VERSION = 1,
+    MODULE_CODE_TRIPLE = 2,
+    MODULE_CODE_DATALAYOUT = 3,
+    MODULE_CODE_GLOBALVAR = 7,
+    MODULE_CODE_FUNCTION = 8,
+
+    TYPE_CODE_NUMENTRY = 1,
+    TYPE_CODE_VOID = 2,
+    TYPE_CODE_FLOAT = 3,
+    TYPE_CODE_DOUBLE = 4,
+    TYPE_CODE_INTEGER = 7,
+    TYPE_CODE_FUNCTION = 21,
+
+    PARAMATTR_CODE_ENTRY = 2,
+    PARAMATTR_GRP_CODE_ENTRY = 3,
+
+    CST_CODE_SETTYPE = 1,
+    CST_CODE_INTEGER = 4,
+    CST_CODE_FLOAT = 6,
+
+    FUNC_CODE_DECLAREBLOCKS = 1,
+    FUNC_CODE_INST_BINOP = 2,
+    FUNC_CODE_INST_CAST = 3,
+    FUNC_CODE_INST_RET = 10,
+    FUNC_CODE_INST_BR = 11,
+    FUNC_CODE_INST_UNREACHABLE = 15,
+    FUNC_CODE_INST_PHI = 16,
+    FUNC_CODE_INST_LOAD = 20,
+    FUNC_CODE_INST_CMP2 = 28,
+    FUNC_CODE_INST_CALL = 34,
+    FUNC_CODE_INST_STORE = 44,
+
+    VST_CODE_ENTRY = 1,
+    VST_CODE_BBENTRY = 2,
+
+    STRTAB_BLOB = 1
+};
+
+// The four abbreviation ids every block has
+enum
+{
+    END_BLOCK = 0,
+    ENTER_SUBBLOCK = 1,
+    DEFINE_ABBREV = 2,
+    UNABBREV_RECORD = 3,
+    FIRST_ABBREV = 4
+};
+
+// Types 0 to 5 are always there, function types follow
+enum
+{
+    TYPE_VOID,
+    TYPE_I1,
+    TYPE_I32,
+    TYPE_FLOAT,
+    TYPE_DOUBLE,
+    TYPE_I64,
+    FIRST_FUNCTION_TYPE
+};
+
+const uint64_t FUNCTION_ATTRIBUTE_INDEX = 0xFFFFFFFF;
+const uint64_t ATTRIBUTE_ENUM = 0;
+const uint64_t ATTRIBUTE_STRING = 3;
+const uint64_t OBO_NO_SIGNED_WRAP = 1 << 1;
+// Every fast-math flag except the legacy unsafe-algebra bit
+const uint64_t FAST_MATH_FLAGS = 0xFE;
+const uint64_t CALL_TAIL = 1 << 0;
+const uint64_t CALL_MUSTTAIL = 1 << 14;
+const uint64_t CALL_EXPLICIT_TYPE = 1 << 15;
+// log2(4) + 1, i32 and float are both 4 byte aligned
+const uint64_t ALIGN_4 = 3;
+
+static uint64_t attributeKind(std::string name)
+{
+    if (name == "nounwind")
+    {
+        return 18;
+    }
+    if (name == "readnone")
+    {
+        return 20;
+    }
+    if (name == "readonly")
+    {
+        return 21;
+    }
+    if (name == "norecurse")
+    {
+        return 48;
+    }
+
+    return 0;
+}
+
+static uint64_t binaryOpcode(irOpcode op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+    case OP_FADD:
+        return 0;
+    case OP_SUB:
+    case OP_FSUB:
+        return 1;
+    case OP_MUL:
+    case OP_FMUL:
+        return 2;
+    case OP_SDIV:
+    case OP_FDIV:
+        return 4;
+    case OP_SREM:
+        return 6;
+    case OP_SHL:
+        return 7;
+    case OP_ASHR:
+        return 9;
+    case OP_AND:
+        return 10;
+    case OP_OR:
+        return 11;
+    default:
+        return 12; // xor
+    }
+}
+
+static uint64_t castOpcode(irOpcode op)
+{
+    switch (op)
+    {
+    case OP_TRUNC:
+        return 0;
+    case OP_ZEXT:
+        return 1;
+    case OP_SEXT:
+        return 2;
+    case OP_FPTOSI:
+        return 4;
+    case OP_SITOFP:
+        return 6;
+    default:
+        return 7; // fptrunc
+    }
+}
+
+static uint64_t predicateCode(std::string predicate)
+{
+    static const char *codes[] = {
+        "false", "oeq", "ogt", "oge", "olt", "ole", "one", "ord",
+        "uno",   "ueq", "ugt", "uge", "ult", "ule", "une", "true"};
+    static const char *int_codes[] = {"eq",  "ne",  "ugt", "uge", "ult",
+                                      "ule", "sgt", "sge", "slt", "sle"};
+
+    for (uint64_t i = 0; i < 16; i++)
+    {
+        if (predicate == codes[i])
+        {
+            return i;
+        }
+    }
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        if (predicate == int_codes[i])
+        {
+            return 32 + i;
+        }
+    }
+
+    return 0;
+}
+
+// Small negative numbers stay small: the sign goes to the lowest bit
+static uint64_t signRotated(int64_t value)
+{
+    if (value >= 0)
+    {
+        return static_cast<uint64_t>(value) << 1;
+    }
+
+    return (static_cast<uint64_t>(-value) << 1) | 1;
+}
+
+BitcodeWriter::BitcodeWriter(std::ostream &out) : m_out(out)
+{
+    m_bits = 0;
+    m_bit_count = 0;
+    m_abbrev_width = 2;
+    m_module_values = 0;
+}
+
+// --- Bitstream ---
+
+void BitcodeWriter::emit(uint32_t value, unsigned int width)
+{
+    if (width < 32)
+    {
+        value &= (1u << width) - 1;
+    }
+
+    m_bits |= static_cast<uint64_t>(value) << m_bit_count;
+    m_bit_count += width;
+
+    while (m_bit_count >= 32)
+    {
+        uint32_t word = static_cast<uint32_t>(m_bits);
+        for (int i = 0; i < 4; i++)
+        {
+            m_bytes += static_cast<char>((word >> (8 * i)) & 0xFF);
+        }
+        m_bits >>= 32;
+        m_bit_count -= 32;
+    }
+}
+
+// Chunks of width - 1 bits, the top bit says another chunk follows
+void BitcodeWriter::emitVBR(uint64_t value, unsigned int width)
+{
+    uint64_t threshold = 1ull << (width - 1);
+
+    while (value >= threshold)
+    {
+        emit(static_cast<uint32_t>((value & (threshold - 1)) | threshold),
+             width);
+        value >>= width - 1;
+    }
+
+    emit(static_cast<uint32_t>(value), width);
+}
+
+void BitcodeWriter::alignWord()
+{
+    if (m_bit_count > 0)
+    {
+        emit(0, 32 - m_bit_count);
+    }
+}
+
+// The block length is only known at its end, a placeholder word is patched
+void BitcodeWriter::enterBlock(unsigned int id, unsigned int abbrev_width)
+{
+    emit(ENTER_SUBBLOCK, m_abbrev_width);
+    emitVBR(id, 8);
+    emitVBR(abbrev_width, 4);
+    alignWord();
+
+    m_open_blocks.push_back({m_abbrev_width, m_bytes.size()});
+    m_bytes.append(4, '\0');
+    m_abbrev_width = abbrev_width;
+}
+
+void BitcodeWriter::exitBlock()
+{
+    emit(END_BLOCK, m_abbrev_width);
+    alignWord();
+
+    open_block block = m_open_blocks.back();
+    m_open_blocks.pop_back();
+
+    uint32_t words = (m_bytes.size() - block.length_pos - 4) / 4;
+    for (int i = 0; i < 4; i++)
+    {
+        m_bytes[block.length_pos + i] =
+            static_cast<char>((words >> (8 * i)) & 0xFF);
+    }
+    m_abbrev_width = block.abbrev_width;
+}
+
+void BitcodeWriter::record(unsigned int code, std::vector<uint64_t> ops)
+{
+    emit(UNABBREV_RECORD, m_abbrev_width);
+    emitVBR(code, 6);
+    emitVBR(ops.size(), 6);
+    for (auto op : ops)
+    {
+        emitVBR(op, 6);
+    }
+}
+
+// Strings are records with one operand per character
+void BitcodeWriter::textRecord(unsigned int code, std::vector<uint64_t> ops,
+                               std::string text)
+{
+    for (char c : text)
+    {
+        ops.push_back(static_cast<unsigned char>(c));
+    }
+
+    record(code, ops);
+}
+
+// --- Values ---
+
+unsigned int BitcodeWriter::typeId(irType type)
+{
+    switch (type)
+    {
+    case IR_I1:
+        return TYPE_I1;
+    case IR_I32:
+        return TYPE_I32;
+    case IR_FLOAT:
+        return TYPE_FLOAT;
+    case IR_DOUBLE:
+        return TYPE_DOUBLE;
+    case IR_I64:
+        return TYPE_I64;
+    default:
+        return TYPE_VOID;
+    }
+}
+
+unsigned int BitcodeWriter::functionTypeId(ir_function &function)
+{
+    std::vector<uint64_t> key = {typeId(function.return_type)};
+    for (auto &param : function.params)
+    {
+        key.push_back(typeId(param.type));
+    }
+
+    return m_function_types.at(key);
+}
+
+// Floats are stored as their own 32 bits, not the double's
+uint64_t BitcodeWriter::constantBits(const ir_value &value)
+{
+    if (value.kind == VAL_INT)
+    {
+        return static_cast<uint32_t>(value.ivalue);
+    }
+
+    if (value.type == IR_FLOAT)
+    {
+        float single = static_cast<float>(value.fvalue);
+        uint32_t bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        return bits;
+    }
+
+    uint64_t bits;
+    std::memcpy(&bits, &value.fvalue, sizeof(bits));
+    return bits;
+}
+
+unsigned int BitcodeWriter::valueId(const ir_value &value)
+{
+    switch (value.kind)
+    {
+    case VAL_REG:
+        return m_reg_ids.at(value.reg);
+    case VAL_GLOBAL:
+        return m_global_ids.at(value.global);
+    default:
+        return m_constant_ids.at({typeId(value.type), constantBits(value)});
+    }
+}
+
+// Operands are relative to the id the instruction would get
+void BitcodeWriter::pushValue(std::vector<uint64_t> &ops, const ir_value &value,
+                              unsigned int inst_id)
+{
+    ops.push_back(static_cast<uint32_t>(inst_id - valueId(value)));
+}
+
+// A forward reference also needs its type, the reader has not seen it yet
+void BitcodeWriter::pushValueAndType(std::vector<uint64_t> &ops,
+                                     const ir_value &value,
+                                     unsigned int inst_id)
+{
+    unsigned int id = valueId(value);
+    ops.push_back(static_cast<uint32_t>(inst_id - id));
+    if (id >= inst_id)
+    {
+        ops.push_back(typeId(value.type));
+    }
+}
+
+void BitcodeWriter::pushConstant(unsigned int &type, const ir_value &value)
+{
+    if (typeId(value.type) != type)
+    {
+        type = typeId(value.type);
+        record(CST_CODE_SETTYPE, {type});
+    }
+
+    if (value.kind == VAL_INT)
+    {
+        // i1 true is -1 when sign extended
+        int64_t number =
+            (value.type == IR_I1) ? -(value.ivalue & 1) : value.ivalue;
+        record(CST_CODE_INTEGER, {signRotated(number)});
+    }
+    else
+    {
+        record(CST_CODE_FLOAT, {constantBits(value)});
+    }
+}
+
+// --- Module ---
+
+void BitcodeWriter::writeTypeTable(IRModule &module)
+{
+    std::vector<std::vector<uint64_t>> function_types;
+    for (auto &function : module.getFunctions())
+    {
+        std::vector<uint64_t> key = {typeId(function->return_type)};
+        for (auto &param : function->params)
+        {
+            key.push_back(typeId(param.type));
+        }
+
+        if (!m_function_types.count(key))
+        {
+            m_function_types[key] = FIRST_FUNCTION_TYPE + function_types.size();
+            function_types.push_back(key);
+        }
+    }
+
+    enterBlock(TYPE_BLOCK_ID, 4);
+    record(TYPE_CODE_NUMENTRY, {FIRST_FUNCTION_TYPE + function_types.size()});
+    record(TYPE_CODE_VOID, {});
+    record(TYPE_CODE_INTEGER, {1});
+    record(TYPE_CODE_INTEGER, {32});
+    record(TYPE_CODE_FLOAT, {});
+    record(TYPE_CODE_DOUBLE, {});
+    record(TYPE_CODE_INTEGER, {64});
+
+    for (auto &key : function_types)
+    {
+        // Not vararg, return type, parameter types
+        std::vector<uint64_t> ops = {0};
+        ops.insert(ops.end(), key.begin(), key.end());
+        record(TYPE_CODE_FUNCTION, ops);
+    }
+    exitBlock();
+}
+
+// Every distinct set of function attributes is one group and one list
+void BitcodeWriter::writeAttributes(IRModule &module)
+{
+    std::vector<std::vector<std::string>> lists;
+    for (auto &function : module.getFunctions())
+    {
+        auto &attributes = function->attributes;
+        if (!attributes.empty() && !m_attribute_lists.count(attributes))
+        {
+            lists.push_back(attributes);
+            m_attribute_lists[attributes] = lists.size();
+        }
+    }
+
+    if (lists.empty())
+    {
+        return;
+    }
+
+    enterBlock(PARAMATTR_GROUP_BLOCK_ID, 3);
+    for (size_t i = 0; i < lists.size(); i++)
+    {
+        std::vector<uint64_t> ops = {i + 1, FUNCTION_ATTRIBUTE_INDEX};
+        for (auto &attribute : lists[i])
+        {
+            uint64_t kind = attributeKind(attribute);
+            if (kind != 0)
+            {
+                ops.push_back(ATTRIBUTE_ENUM);
+                ops.push_back(kind);
+            }
+            else
+            {
+                ops.push_back(ATTRIBUTE_STRING);
+                for (char c : attribute)
+                {
+                    ops.push_back(static_cast<unsigned char>(c));
+                }
+                ops.push_back(0);
+            }
+        }
+        record(PARAMATTR_GRP_CODE_ENTRY, ops);
+    }
+    exitBlock();
+
+    enterBlock(PARAMATTR_BLOCK_ID, 3);
+    for (size_t i = 0; i < lists.size(); i++)
+    {
+        record(PARAMATTR_CODE_ENTRY, {i + 1});
+    }
+    exitBlock();
+}
+
+// Names are offsets into the string table written after the module
+void BitcodeWriter::writeModuleInfo(IRModule &module)
+{
+    if (!module.getTriple().empty())
+    {
+        textRecord(MODULE_CODE_TRIPLE, {}, module.getTriple());
+    }
+    if (!module.getDataLayout().empty())
+    {
+        textRecord(MODULE_CODE_DATALAYOUT, {}, module.getDataLayout());
+    }
+
+    auto &globals = module.getGlobals();
+    auto &functions = module.getFunctions();
+    unsigned int first_init = globals.size() + functions.size();
+
+    for (size_t i = 0; i < globals.size(); i++)
+    {
+        m_global_ids[globals[i].name] = i;
+
+        // [name, value type, explicit type, initializer id + 1, linkage,
+        //  alignment, section]
+        record(MODULE_CODE_GLOBALVAR,
+               {m_strtab.size(), globals[i].name.size(),
+                typeId(globals[i].type), 2, first_init + i + 1, 0, 0, 0});
+        m_strtab += globals[i].name;
+    }
+
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        ir_function &function = *functions[i];
+        m_global_ids[function.name] = globals.size() + i;
+
+        unsigned int attributes = 0;
+        if (!function.attributes.empty())
+        {
+            attributes = m_attribute_lists.at(function.attributes);
+        }
+
+        // [name, type, calling convention, is prototype, linkage,
+        //  attributes, alignment, section, visibility, gc]
+        record(MODULE_CODE_FUNCTION,
+               {m_strtab.size(), function.name.size(),
+                functionTypeId(function), 0, 0, 0, attributes, 0, 0, 0, 0});
+        m_strtab += function.name;
+    }
+
+    m_module_values = first_init + globals.size();
+}
+
+void BitcodeWriter::writeInstruction(ir_instruction &instr,
+                                     unsigned int inst_id)
+{
+    std::vector<uint64_t> ops;
+
+    switch (instr.op)
+    {
+    case OP_ICMP:
+    case OP_FCMP:
+        pushValueAndType(ops, instr.operands[0], inst_id);
+        pushValue(ops, instr.operands[1], inst_id);
+        ops.push_back(predicateCode(instr.predicate));
+        if (instr.fast)
+        {
+            ops.push_back(FAST_MATH_FLAGS);
+        }
+        record(FUNC_CODE_INST_CMP2, ops);
+        break;
+    case OP_ZEXT:
+    case OP_SITOFP:
+    case OP_FPTOSI:
+    case OP_FPTRUNC:
+    case OP_SEXT:
+    case OP_TRUNC:
+        pushValueAndType(ops, instr.operands[0], inst_id);
+        ops.push_back(typeId(instr.result.type));
+        ops.push_back(castOpcode(instr.op));
+        record(FUNC_CODE_INST_CAST, ops);
+        break;
+    case OP_LOAD:
+        pushValueAndType(ops, instr.operands[0], inst_id);
+        ops.push_back(typeId(instr.result.type));
+        ops.push_back(ALIGN_4);
+        ops.push_back(0);
+        record(FUNC_CODE_INST_LOAD, ops);
+        break;
+    case OP_STORE:
+        pushValueAndType(ops, instr.operands[1], inst_id);
+        pushValueAndType(ops, instr.operands[0], inst_id);
+        ops.push_back(ALIGN_4);
+        ops.push_back(0);
+        record(FUNC_CODE_INST_STORE, ops);
+        break;
+    case OP_CALL:
+    {
+        uint64_t flags = CALL_EXPLICIT_TYPE;
+        if (instr.tail == MUST_TAIL_CALL)
+        {
+            flags |= CALL_TAIL | CALL_MUSTTAIL;
+        }
+        else if (instr.tail == TAIL_CALL)
+        {
+            flags |= CALL_TAIL;
+        }
+
+        std::vector<uint64_t> key = {typeId(instr.result.type)};
+        for (auto &operand : instr.operands)
+        {
+            key.push_back(typeId(operand.type));
+        }
+
+        ops = {0, flags, m_function_types.at(key)};
+        ops.push_back(inst_id - m_global_ids.at(instr.callee));
+        for (auto &operand : instr.operands)
+        {
+            pushValue(ops, operand, inst_id);
+        }
+        record(FUNC_CODE_INST_CALL, ops);
+        break;
+    }
+    case OP_PHI:
+        // Incoming values may come from later blocks, so they are signed
+        ops.push_back(typeId(instr.result.type));
+        for (size_t i = 0; i < instr.operands.size(); i++)
+        {
+            int64_t relative = static_cast<int64_t>(inst_id) -
+                               static_cast<int64_t>(valueId(instr.operands[i]));
+            ops.push_back(signRotated(relative));
+            ops.push_back(m_block_ids.at(instr.targets[i]));
+        }
+        record(FUNC_CODE_INST_PHI, ops);
+        break;
+    case OP_BR:
+        record(FUNC_CODE_INST_BR, {m_block_ids.at(instr.targets[0])});
+        break;
+    case OP_COND_BR:
+        ops = {m_block_ids.at(instr.targets[0]),
+               m_block_ids.at(instr.targets[1])};
+        pushValue(ops, instr.operands[0], inst_id);
+        record(FUNC_CODE_INST_BR, ops);
+        break;
+    case OP_RET:
+        if (!instr.operands.empty())
+        {
+            pushValueAndType(ops, instr.operands[0], inst_id);
+        }
+        record(FUNC_CODE_INST_RET, ops);
+        break;
+    case OP_UNREACHABLE:
+        record(FUNC_CODE_INST_UNREACHABLE, {});
+        break;
+    default:
+        // Binary arithmetic
+        pushValueAndType(ops, instr.operands[0], inst_id);
+        pushValue(ops, instr.operands[1], inst_id);
+        ops.push_back(binaryOpcode(instr.op));
+        if (instr.nsw)
+        {
+            ops.push_back(OBO_NO_SIGNED_WRAP);
+        }
+        else if (instr.fast)
+        {
+            ops.push_back(FAST_MATH_FLAGS);
+        }
+        record(FUNC_CODE_INST_BINOP, ops);
+        break;
+    }
+}
+
+void BitcodeWriter::writeFunction(ir_function &function)
+{
+    m_reg_ids.clear();
+    m_constant_ids.clear();
+    m_block_ids.clear();
+
+    unsigned int next = m_module_values;
+    for (auto &param : function.params)
+    {
+        m_reg_ids[param.reg] = next++;
+    }
+
+    // Constants are numbered grouped by type, so each type is set once
+    std::map<std::pair<int, uint64_t>, ir_value> constants;
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            for (auto &operand : instr.operands)
+            {
+                if (operand.kind == VAL_INT || operand.kind == VAL_FLOAT)
+                {
+                    constants[{typeId(operand.type), constantBits(operand)}] =
+                        operand;
+                }
+            }
+        }
+    }
+    for (auto &constant : constants)
+    {
+        m_constant_ids[constant.first] = next++;
+    }
+
+    unsigned int first_inst = next;
+    for (size_t i = 0; i < function.blocks.size(); i++)
+    {
+        m_block_ids[function.blocks[i].get()] = i;
+        for (auto &instr : function.blocks[i]->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                m_reg_ids[instr.result.reg] = next++;
+            }
+        }
+    }
+
+    enterBlock(FUNCTION_BLOCK_ID, 4);
+    record(FUNC_CODE_DECLAREBLOCKS, {function.blocks.size()});
+
+    if (!constants.empty())
+    {
+        enterBlock(CONSTANTS_BLOCK_ID, 4);
+        unsigned int type = TYPE_VOID;
+        for (auto &constant : constants)
+        {
+            pushConstant(type, constant.second);
+        }
+        exitBlock();
+    }
+
+    unsigned int inst_id = first_inst;
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            writeInstruction(instr, inst_id);
+            if (instr.result.kind == VAL_REG)
+            {
+                inst_id++;
+            }
+        }
+    }
+
+    // Local names, unnamed values are numbered by the reader
+    std::vector<std::string> names = function.uniqueNames();
+    enterBlock(VALUE_SYMTAB_BLOCK_ID, 4);
+    auto name = [&](const ir_value &value) {
+        if (!names[value.reg].empty())
+        {
+            textRecord(VST_CODE_ENTRY, {m_reg_ids.at(value.reg)},
+                       names[value.reg]);
+        }
+    };
+    for (auto &param : function.params)
+    {
+        name(param);
+    }
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                name(instr.result);
+            }
+        }
+    }
+    for (size_t i = 0; i < function.blocks.size(); i++)
+    {
+        textRecord(VST_CODE_BBENTRY, {i}, function.blocks[i]->label);
+    }
+    exitBlock();
+
+    exitBlock();
+}
+
+void BitcodeWriter::write(IRModule &module)
+{
+    m_bytes.clear();
+    m_strtab.clear();
+    m_function_types.clear();
+    m_attribute_lists.clear();
+    m_global_ids.clear();
+
+    // 'BC' 0xC0DE
+    emit('B', 8);
+    emit('C', 8);
+    emit(0x0, 4);
+    emit(0xC, 4);
+    emit(0xE, 4);
+    emit(0xD, 4);
+
+    enterBlock(IDENTIFICATION_BLOCK_ID, 5);
+    textRecord(IDENTIFICATION_CODE_STRING, {}, "MINIC");
+    record(IDENTIFICATION_CODE_EPOCH, {0});
+    exitBlock();
+
+    enterBlock(MODULE_BLOCK_ID, 3);
+    // Version 2: relative operand ids and names in the string table
+    record(MODULE_CODE_VERSION, {2});
+    writeTypeTable(module);
+    writeAttributes(module);
+    writeModuleInfo(module);
+
+    auto &globals = module.getGlobals();
+    if (!globals.empty())
+    {
+        enterBlock(CONSTANTS_BLOCK_ID, 4);
+        unsigned int type = TYPE_VOID;
+        for (auto &global : globals)
+        {
+            pushConstant(type, global.init);
+        }
+        exitBlock();
+    }
+
+    for (auto &function : module.getFunctions())
+    {
+        writeFunction(*function);
+    }
+    exitBlock();
+
+    // The only abbreviated record: [STRTAB_BLOB, blob]
+    enterBlock(STRTAB_BLOCK_ID, 3);
+    emit(DEFINE_ABBREV, m_abbrev_width);
+    emitVBR(2, 5);
+    emit(1, 1);
+    emitVBR(STRTAB_BLOB, 8);
+    emit(0, 1);
+    emit(5, 3);
+
+    emit(FIRST_ABBREV, m_abbrev_width);
+    emitVBR(m_strtab.size(), 6);
+    alignWord();
+    m_bytes += m_strtab;
+    m_bytes.append((4 - m_strtab.size() % 4) % 4, '\0');
+    exitBlock();
+
+    m_out.write(m_bytes.data(), m_bytes.size());
+}
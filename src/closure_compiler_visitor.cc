@@ -0,0 +1,1443 @@
+#include "../lib/closure_compiler_visitor.hh"
+#include "../lib/constant_folder_visitor.hh"
+#include <iostream>
+
+// Wrapping i32 arithmetic, the same results as the emitted IR
+static int wrappingAdd(int a, int b)
+{
+    return ConstantFolderVisitor::wrap(static_cast<unsigned int>(a) +
+                                       static_cast<unsigned int>(b));
+}
+
+static int wrappingSub(int a, int b)
+{
+    return ConstantFolderVisitor::wrap(static_cast<unsigned int>(a) -
+                                       static_cast<unsigned int>(b));
+}
+
+static int wrappingMul(int a, int b)
+{
+    return ConstantFolderVisitor::wrap(static_cast<unsigned int>(a) *
+                                       static_cast<unsigned int>(b));
+}
+
+// The count is taken mod 32 like the JIT's shl and sar, the IR leaves a
+// count out of range undefined
+static int shiftLeft(int a, int b)
+{
+    return ConstantFolderVisitor::wrap(static_cast<unsigned int>(a)
+                                       << (b & 31));
+}
+
+static int shiftRight(int a, int b) { return a >> (b & 31); }
+
+// Native stack of one call: the call lambda and enter, plus the statement or
+// expression lambda and its std::function call for every level of nesting
+static const size_t g_stack_per_call = 2 * 1024;
+static const size_t g_stack_per_level = 256;
+
+thread_local ClosureCompilerVisitor::machine *ClosureCompilerVisitor::t_machine =
+    nullptr;
+
+ClosureCompilerVisitor::ClosureCompilerVisitor()
+{
+    m_type = T_VOID;
+    m_return_type = T_VOID;
+    m_frame_size = 0;
+    m_global_count = 0;
+    m_max_call_depth = 10000;
+    m_nesting = 0;
+    m_stack_reserve = 0;
+    m_step_budget = 0;
+    m_finished = false;
+    m_threads = 1;
+    m_fork_depth = 0;
+}
+
+void ClosureCompilerVisitor::setMaxCallDepth(size_t depth)
+{
+    m_max_call_depth = depth;
+}
+
+void ClosureCompilerVisitor::setParallel(std::unordered_set<std::string> &pure,
+                                         size_t threads, size_t fork_depth)
+{
+    m_pure = pure;
+    m_threads = threads;
+    m_fork_depth = fork_depth;
+}
+
+void ClosureCompilerVisitor::setStepBudget(unsigned long steps)
+{
+    m_step_budget = steps;
+}
+
+bool ClosureCompilerVisitor::isFinished() { return m_finished; }
+
+std::vector<std::pair<std::string, dataType>> &
+ClosureCompilerVisitor::getGlobals()
+{
+    return m_global_decls;
+}
+
+int ClosureCompilerVisitor::getIntGlobal(std::string name)
+{
+    return m_globals[m_global_slots.at(name)].i;
+}
+
+float ClosureCompilerVisitor::getFloatGlobal(std::string name)
+{
+    return m_globals[m_global_slots.at(name)].f;
+}
+
+// With a step budget the run is only a trial, errors end it quietly and the
+// caller falls back to running the program for real
+void ClosureCompilerVisitor::stop(std::string message)
+{
+    if (m_step_budget)
+    {
+        throw stop_signal();
+    }
+
+    std::cerr << message << std::endl;
+    exit(1);
+}
+
+void ClosureCompilerVisitor::runtimeError(std::string s)
+{
+    stop("Runtime Error: " + s);
+}
+
+void ClosureCompilerVisitor::countStep(machine &m)
+{
+    if (m_step_budget && ++m.steps > m_step_budget)
+    {
+        throw stop_signal();
+    }
+}
+
+ClosureCompilerVisitor::compiled_function *
+ClosureCompilerVisitor::functionNamed(std::string name)
+{
+    // Calls can be compiled before their callee, they share this record
+    std::unique_ptr<compiled_function> &fn = m_functions[name];
+    if (!fn)
+    {
+        fn.reset(new compiled_function{name, 0, nullptr});
+    }
+
+    return fn.get();
+}
+
+// Pool threads get their machine the first time they run a forked call
+ClosureCompilerVisitor::machine &ClosureCompilerVisitor::threadMachine()
+{
+    if (t_machine == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(m_machines_lock);
+        m_machines.emplace_back(new machine());
+        t_machine = m_machines.back().get();
+        t_machine->stack.assign(1024, slot());
+    }
+
+    return *t_machine;
+}
+
+int ClosureCompilerVisitor::run()
+{
+    m_stack_reserve = g_stack_per_call + m_nesting * g_stack_per_level;
+    size_t stack_size = NativeStack::sizeFor(
+        m_max_call_depth, g_stack_per_call, m_nesting, g_stack_per_level);
+
+    if (m_threads > 1)
+    {
+        m_pool.reset(new TaskPool(m_threads, stack_size));
+    }
+
+    bool started = NativeStack::run(
+        stack_size,
+        [](void *arg) -> void * {
+            auto self = static_cast<ClosureCompilerVisitor *>(arg);
+            try
+            {
+                self->m_main.ret.i = self->runMain();
+                self->m_finished = true;
+            }
+            catch (stop_signal)
+            {
+                self->m_finished = false;
+            }
+            return nullptr;
+        },
+        this);
+
+    if (!started)
+    {
+        std::cerr << "Runtime Error: Cannot allocate a stack for "
+                  << m_max_call_depth << " calls" << std::endl;
+        exit(1);
+    }
+
+    m_pool.reset();
+
+    return m_main.ret.i;
+}
+
+int ClosureCompilerVisitor::runMain()
+{
+    compiled_function *entry = functionNamed("main");
+    if (!entry->body)
+    {
+        stop("Linker Error: Undefined reference to \"main\"");
+    }
+
+    machine &m = m_main;
+    t_machine = &m;
+
+    m_globals.assign(m_global_count, slot());
+    m.stack.assign(1024, slot());
+    m.base = 0;
+    m.sp = 0;
+
+    for (auto &init : m_init)
+    {
+        init(m);
+    }
+
+    enter(m, entry, 0);
+
+    return m.ret.i;
+}
+
+// Runs fn with its arguments already in m.stack[base..], then every function
+// its body tail called, all in the same frame
+void ClosureCompilerVisitor::enter(machine &m, compiled_function *fn,
+                                   size_t base)
+{
+    if (m.depth >= m_max_call_depth)
+    {
+        runtimeError("Maximum call depth of " +
+                     std::to_string(m_max_call_depth) + " exceeded calling \"" +
+                     fn->name + "\"");
+    }
+    if (NativeStack::exhausted(m_stack_reserve))
+    {
+        runtimeError("Out of stack space at call depth " +
+                     std::to_string(m.depth) + " calling \"" + fn->name +
+                     "\"");
+    }
+    m.depth++;
+
+    size_t saved_base = m.base;
+    m.base = base;
+
+    while (fn != nullptr)
+    {
+        if (!fn->body)
+        {
+            stop("Linker Error: Undefined reference to \"" + fn->name + "\"");
+        }
+        countStep(m);
+
+        m.sp = base + fn->frame_size;
+        ensureStack(m, m.sp);
+
+        fn->body(m);
+
+        fn = m.tail;
+        m.tail = nullptr;
+    }
+
+    m.base = saved_base;
+    m.sp = base;
+    m.depth--;
+}
+
+// Evaluates the arguments into m.stack[m.sp..], m.sp moves past each one so
+// calls inside later arguments don't overwrite it
+void ClosureCompilerVisitor::pushArguments(machine &m,
+                                           std::vector<expr_fn> &args)
+{
+    size_t base = m.sp;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        slot v = args[i](m);
+        ensureStack(m, base + i + 1);
+        m.stack[base + i] = v;
+        m.sp = base + i + 1;
+    }
+}
+
+void ClosureCompilerVisitor::ensureStack(machine &m, size_t size)
+{
+    if (m.stack.size() < size)
+    {
+        m.stack.resize(std::max(size, m.stack.size() * 2));
+    }
+}
+
+// --- Compile helpers ---
+
+ClosureCompilerVisitor::expr_fn
+ClosureCompilerVisitor::compileExpr(STNode *node, dataType &type)
+{
+    node->accept(*this);
+    type = m_type;
+    return m_expr;
+}
+
+ClosureCompilerVisitor::stmt_fn
+ClosureCompilerVisitor::compileStmt(STNode *node)
+{
+    switch (node->getNodeType())
+    {
+    case COMPMOUNT_STATEMENT_NODE:
+    case STATEMENT_NODE:
+    case IF_STATEMENT_NODE:
+    case WHILE_STATEMENT_NODE:
+    case DO_WHILE_STATEMENT_NODE:
+    case FOR_STATEMENT_NODE:
+    case RETURN_NODE:
+    case CONTINUE_NODE:
+    case BREAK_NODE:
+    case VARIABLE_DECLARATION_STATEMENT_NODE:
+        node->accept(*this);
+        return m_stmt;
+    default:
+    {
+        // Expression statement
+        dataType type;
+        expr_fn expr = compileExpr(node, type);
+        return [expr](machine &m) {
+            expr(m);
+            return FLOW_NEXT;
+        };
+    }
+    }
+}
+
+// statement_list is left recursive, flatten it into one vector
+void ClosureCompilerVisitor::compileBlock(STNode *node,
+                                          std::vector<stmt_fn> &block)
+{
+    for (auto &child : node->getChildrenList())
+    {
+        if (child->getNodeType() == STATEMENT_LIST_NODE)
+        {
+            compileBlock(child, block);
+        }
+        else
+        {
+            block.push_back(compileStmt(child));
+        }
+    }
+}
+
+ClosureCompilerVisitor::var_ref ClosureCompilerVisitor::resolve(std::string name,
+                                                                dataType &type)
+{
+    VarSymbol *sym =
+        dynamic_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
+    if (!sym)
+    {
+        std::cerr << "Closure Error: Variable \"" << name
+                  << "\" is not declared" << std::endl;
+        exit(1);
+    }
+
+    type = sym->getValueType();
+    bool global = SymbolTable::getInstance()->lookupGlobal(name) == sym;
+
+    return {global, static_cast<size_t>(sym->getSlot())};
+}
+
+ClosureCompilerVisitor::slot &ClosureCompilerVisitor::at(machine &m,
+                                                        var_ref ref)
+{
+    return ref.global ? m_globals[ref.index] : m.stack[m.base + ref.index];
+}
+
+ClosureCompilerVisitor::expr_fn ClosureCompilerVisitor::load(var_ref ref)
+{
+    size_t index = ref.index;
+
+    if (ref.global)
+    {
+        return [this, index](machine &) { return m_globals[index]; };
+    }
+
+    return [index](machine &m) { return m.stack[m.base + index]; };
+}
+
+ClosureCompilerVisitor::expr_fn ClosureCompilerVisitor::store(var_ref ref,
+                                                              expr_fn value)
+{
+    size_t index = ref.index;
+
+    // The value may call functions that grow the stack, index after it
+    if (ref.global)
+    {
+        return [this, index, value](machine &m) {
+            slot v = value(m);
+            m_globals[index] = v;
+            return v;
+        };
+    }
+
+    return [this, index, value](machine &m) {
+        slot v = value(m);
+        m.stack[m.base + index] = v;
+        return v;
+    };
+}
+
+ClosureCompilerVisitor::expr_fn
+ClosureCompilerVisitor::convert(expr_fn fn, dataType from, dataType to)
+{
+    if (from == T_INT && to == T_FLOAT)
+    {
+        return [fn](machine &m) {
+            slot v = fn(m);
+            v.f = static_cast<float>(v.i);
+            return v;
+        };
+    }
+
+    if (from == T_FLOAT && to == T_INT)
+    {
+        return [fn](machine &m) {
+            slot v = fn(m);
+            v.i = static_cast<int>(v.f);
+            return v;
+        };
+    }
+
+    return fn;
+}
+
+// 0 or 1 in .i, C truth for both types
+ClosureCompilerVisitor::expr_fn ClosureCompilerVisitor::truth(expr_fn fn,
+                                                              dataType type)
+{
+    if (type == T_FLOAT)
+    {
+        return [fn](machine &m) {
+            slot v = fn(m);
+            v.i = v.f != 0.0f;
+            return v;
+        };
+    }
+
+    return [fn](machine &m) {
+        slot v = fn(m);
+        v.i = v.i != 0;
+        return v;
+    };
+}
+
+ClosureCompilerVisitor::expr_fn
+ClosureCompilerVisitor::binary(nodeType op, expr_fn left, dataType left_type,
+                               expr_fn right, dataType right_type,
+                               dataType &type)
+{
+    dataType common =
+        (left_type == T_FLOAT || right_type == T_FLOAT) ? T_FLOAT : T_INT;
+    left = convert(left, left_type, common);
+    right = convert(right, right_type, common);
+
+    // Operands are read into locals first so left runs before right
+    auto ints = [&](auto fn) -> expr_fn {
+        return [left, right, fn](machine &m) {
+            slot a = left(m);
+            slot b = right(m);
+            slot r;
+            r.i = fn(a.i, b.i);
+            return r;
+        };
+    };
+    auto floats = [&](auto fn) -> expr_fn {
+        return [left, right, fn](machine &m) {
+            slot a = left(m);
+            slot b = right(m);
+            slot r;
+            r.f = fn(a.f, b.f);
+            return r;
+        };
+    };
+    auto float_compare = [&](auto fn) -> expr_fn {
+        return [left, right, fn](machine &m) {
+            slot a = left(m);
+            slot b = right(m);
+            slot r;
+            r.i = fn(a.f, b.f);
+            return r;
+        };
+    };
+
+    type = (op == LESS_NODE || op == LESS_EQUALS_NODE || op == GREATER_NODE ||
+            op == GREATER_EQUALS_NODE || op == LOGIC_EQUALS_NODE ||
+            op == LOGIC_NOT_EQUALS_NODE)
+               ? T_INT
+               : common;
+
+    switch (op)
+    {
+    case ADDITION_NODE:
+    case PLUS_ASSIGNMENT_NODE:
+        return common == T_FLOAT ? floats(std::plus<float>())
+                                 : ints(wrappingAdd);
+    case SUBTRACTION_NODE:
+    case MINUS_ASSIGNMENT_NODE:
+        return common == T_FLOAT ? floats(std::minus<float>())
+                                 : ints(wrappingSub);
+    case MULTIPLICATION_NODE:
+    case MUL_ASSIGNMENT_NODE:
+        return common == T_FLOAT ? floats(std::multiplies<float>())
+                                 : ints(wrappingMul);
+    case DIVISION_NODE:
+    case DIV_ASSIGNMENT_NODE:
+        if (common == T_FLOAT)
+        {
+            return floats(std::divides<float>());
+        }
+        return [this, left, right](machine &m) {
+            slot a = left(m);
+            slot b = right(m);
+            if (!b.i)
+            {
+                runtimeError("Cant divide with 0");
+            }
+            slot r;
+            r.i = a.i / b.i;
+            return r;
+        };
+    case MOD_NODE:
+    case MOD_ASSIGNMENT_NODE:
+        return [this, left, right](machine &m) {
+            slot a = left(m);
+            slot b = right(m);
+            if (!b.i)
+            {
+                runtimeError("Cant divide with 0");
+            }
+            slot r;
+            r.i = a.i % b.i;
+            return r;
+        };
+    case LESS_NODE:
+        return common == T_FLOAT ? float_compare(std::less<float>())
+                                 : ints(std::less<int>());
+    case LESS_EQUALS_NODE:
+        return common == T_FLOAT ? float_compare(std::less_equal<float>())
+                                 : ints(std::less_equal<int>());
+    case GREATER_NODE:
+        return common == T_FLOAT ? float_compare(std::greater<float>())
+                                 : ints(std::greater<int>());
+    case GREATER_EQUALS_NODE:
+        return common == T_FLOAT ? float_compare(std::greater_equal<float>())
+                                 : ints(std::greater_equal<int>());
+    case LOGIC_EQUALS_NODE:
+        return common == T_FLOAT ? float_compare(std::equal_to<float>())
+                                 : ints(std::equal_to<int>());
+    case LOGIC_NOT_EQUALS_NODE:
+        return common == T_FLOAT ? float_compare(std::not_equal_to<float>())
+                                 : ints(std::not_equal_to<int>());
+    case BIT_WISE_AND_NODE:
+        return ints(std::bit_and<int>());
+    case BIT_WISE_OR_NODE:
+        return ints(std::bit_or<int>());
+    case BIT_WISE_XOR_NODE:
+        return ints(std::bit_xor<int>());
+    case SHIFT_LEFT_NODE:
+        return ints(shiftLeft);
+    case SHIFT_RIGHT_NODE:
+        return ints(shiftRight);
+    default:
+        std::cerr << "Closure Error: Unknown binary operator" << std::endl;
+        exit(1);
+    }
+}
+
+// Reads and writes of locals are fine, the values are taken before forking
+bool ClosureCompilerVisitor::isPureExpression(STNode *node)
+{
+    switch (node->getNodeType())
+    {
+    case ASSIGNMENT_NODE:
+    case PLUS_ASSIGNMENT_NODE:
+    case MINUS_ASSIGNMENT_NODE:
+    case MUL_ASSIGNMENT_NODE:
+    case DIV_ASSIGNMENT_NODE:
+    case MOD_ASSIGNMENT_NODE:
+    case PREFIX_INCREMENT_NODE:
+    case PREFIX_DECREMENT_NODE:
+    case POSTFIX_INCREMENT_NODE:
+    case POSTFIX_DECREMENT_NODE:
+        return false;
+    case FUNCTION_CALL_NODE:
+        if (!m_pure.count(static_cast<IDENTIFIER *>(
+                               node->getChildrenList().front())
+                               ->getLabel()))
+        {
+            return false;
+        }
+        break;
+    default:
+        break;
+    }
+
+    for (auto &child : node->getChildrenList())
+    {
+        if (!isPureExpression(child))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ClosureCompilerVisitor::isForkable(STNode *node)
+{
+    return node->getNodeType() == FUNCTION_CALL_NODE && isPureExpression(node);
+}
+
+void ClosureCompilerVisitor::binaryNode(STNode *node, nodeType op)
+{
+    STNode *left_node = node->getChildrenList().front();
+    STNode *right_node = node->getChildrenList().back();
+
+    dataType left_type, right_type;
+    expr_fn left = compileExpr(left_node, left_type);
+    expr_fn right = compileExpr(right_node, right_type);
+
+    m_expr = binary(op, left, left_type, right, right_type, m_type);
+
+    if (m_threads < 2 || !isForkable(left_node) || !isForkable(right_node))
+    {
+        return;
+    }
+
+    expr_fn sequential = m_expr;
+
+    compiled_function *callee;
+    std::vector<expr_fn> args =
+        compileArguments(static_cast<function_call *>(right_node), callee);
+
+    // Once both calls are done their results sit in the two slots at m.sp
+    expr_fn combine = binary(
+        op, [](machine &m) { return m.stack[m.sp]; }, left_type,
+        [](machine &m) { return m.stack[m.sp + 1]; }, right_type, m_type);
+
+    // The right call becomes a task with its arguments already evaluated, the
+    // left one runs here meanwhile. Below m_fork_depth a task costs more than
+    // it saves and the expression runs sequentially.
+    m_expr = [this, left, sequential, combine, callee, args](machine &m) mutable {
+        if (m.depth >= m_fork_depth)
+        {
+            return sequential(m);
+        }
+
+        std::vector<slot> values;
+        for (auto &arg : args)
+        {
+            values.push_back(arg(m));
+        }
+
+        slot result;
+        size_t depth = m.depth;
+
+        TaskPool::task task;
+        task.run = [this, callee, &values, &result, depth]() {
+            machine &w = threadMachine();
+            size_t base = w.sp;
+            ensureStack(w, base + values.size());
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                w.stack[base + i] = values[i];
+            }
+
+            // The task continues the forking call's depth, not the depth of
+            // whatever this thread was doing while it stole it
+            size_t saved_depth = w.depth;
+            w.depth = depth;
+            enter(w, callee, base);
+            w.depth = saved_depth;
+
+            result = w.ret;
+        };
+
+        m_pool->spawn(&task);
+        slot l = left(m);
+        m_pool->join(&task);
+
+        ensureStack(m, m.sp + 2);
+        m.stack[m.sp] = l;
+        m.stack[m.sp + 1] = result;
+        return combine(m);
+    };
+}
+
+// x op= e is x = (type of x)(x op e) with the usual promotion
+void ClosureCompilerVisitor::compoundAssignment(STNode *node, nodeType op)
+{
+    dataType var_type, value_type, type;
+    var_ref ref =
+        resolve(static_cast<IDENTIFIER *>(node->getChildrenList().front())
+                    ->getLabel(),
+                var_type);
+    expr_fn value = compileExpr(node->getChildrenList().back(), value_type);
+
+    // The right side may assign x itself, so like the other back ends it runs
+    // before x is read. Its value waits in the slot at m.sp.
+    expr_fn result = binary(
+        op, load(ref), var_type, [](machine &m) { return m.stack[m.sp]; },
+        value_type, type);
+    result = convert(result, type, var_type);
+    m_expr = store(ref, [this, value, result](machine &m) {
+        slot v = value(m);
+        ensureStack(m, m.sp + 1);
+        m.stack[m.sp] = v;
+        return result(m);
+    });
+    m_type = var_type;
+}
+
+void ClosureCompilerVisitor::increment(STNode *node, int delta, bool prefix)
+{
+    var_ref ref = resolve(
+        static_cast<IDENTIFIER *>(node->getChildrenList().front())->getLabel(),
+        m_type);
+
+    if (m_type == T_FLOAT)
+    {
+        m_expr = [this, ref, delta, prefix](machine &m) {
+            slot &s = at(m, ref);
+            slot old = s;
+            s.f += delta;
+            return prefix ? s : old;
+        };
+    }
+    else
+    {
+        m_expr = [this, ref, delta, prefix](machine &m) {
+            slot &s = at(m, ref);
+            slot old = s;
+            s.i = wrappingAdd(s.i, delta);
+            return prefix ? s : old;
+        };
+    }
+}
+
+// --- VISITORS ---
+
+void ClosureCompilerVisitor::visitIDENTIFIER(IDENTIFIER *node)
+{
+    m_expr = load(resolve(node->getLabel(), m_type));
+}
+
+void ClosureCompilerVisitor::visitNUMBER(NUMBER *node)
+{
+    slot value;
+    m_type = node->getResolvedType();
+
+    if (m_type == T_FLOAT)
+    {
+        value.f = node->getFValue();
+    }
+    else
+    {
+        value.i = node->getIValue();
+    }
+
+    m_expr = [value](machine &) { return value; };
+}
+
+void ClosureCompilerVisitor::visitAddition(addition *node)
+{
+    binaryNode(node, ADDITION_NODE);
+}
+
+void ClosureCompilerVisitor::visitSubtraction(subtraction *node)
+{
+    binaryNode(node, SUBTRACTION_NODE);
+}
+
+void ClosureCompilerVisitor::visitMultiplication(multiplication *node)
+{
+    binaryNode(node, MULTIPLICATION_NODE);
+}
+
+void ClosureCompilerVisitor::visitDivision(division *node)
+{
+    binaryNode(node, DIVISION_NODE);
+}
+
+void ClosureCompilerVisitor::visitMod(mod *node) { binaryNode(node, MOD_NODE); }
+
+void ClosureCompilerVisitor::visitLess(less *node)
+{
+    binaryNode(node, LESS_NODE);
+}
+
+void ClosureCompilerVisitor::visitLessEquals(less_equals *node)
+{
+    binaryNode(node, LESS_EQUALS_NODE);
+}
+
+void ClosureCompilerVisitor::visitGreater(greater *node)
+{
+    binaryNode(node, GREATER_NODE);
+}
+
+void ClosureCompilerVisitor::visitGreaterEquals(greater_equals *node)
+{
+    binaryNode(node, GREATER_EQUALS_NODE);
+}
+
+void ClosureCompilerVisitor::visitLogicEquals(logic_equals *node)
+{
+    binaryNode(node, LOGIC_EQUALS_NODE);
+}
+
+void ClosureCompilerVisitor::visitLogicNotEquals(logic_not_equals *node)
+{
+    binaryNode(node, LOGIC_NOT_EQUALS_NODE);
+}
+
+void ClosureCompilerVisitor::visitLogicAnd(logic_and *node)
+{
+    dataType left_type, right_type;
+    expr_fn left = compileExpr(node->getChildrenList().front(), left_type);
+    expr_fn right = compileExpr(node->getChildrenList().back(), right_type);
+    left = truth(left, left_type);
+    right = truth(right, right_type);
+
+    m_expr = [left, right](machine &m) {
+        slot r;
+        r.i = left(m).i && right(m).i;
+        return r;
+    };
+    m_type = T_INT;
+}
+
+void ClosureCompilerVisitor::visitLogicOr(logic_or *node)
+{
+    dataType left_type, right_type;
+    expr_fn left = compileExpr(node->getChildrenList().front(), left_type);
+    expr_fn right = compileExpr(node->getChildrenList().back(), right_type);
+    left = truth(left, left_type);
+    right = truth(right, right_type);
+
+    m_expr = [left, right](machine &m) {
+        slot r;
+        r.i = left(m).i || right(m).i;
+        return r;
+    };
+    m_type = T_INT;
+}
+
+void ClosureCompilerVisitor::visitLogicNot(logic_not *node)
+{
+    dataType type;
+    expr_fn value = compileExpr(node->getChildrenList().front(), type);
+    value = truth(value, type);
+
+    m_expr = [value](machine &m) {
+        slot r = value(m);
+        r.i = !r.i;
+        return r;
+    };
+    m_type = T_INT;
+}
+
+void ClosureCompilerVisitor::visitUnaryPlus(unary_plus *node)
+{
+    m_expr = compileExpr(node->getChildrenList().front(), m_type);
+}
+
+void ClosureCompilerVisitor::visitUnaryMinus(unary_minus *node)
+{
+    expr_fn value = compileExpr(node->getChildrenList().front(), m_type);
+
+    if (m_type == T_FLOAT)
+    {
+        m_expr = [value](machine &m) {
+            slot r = value(m);
+            r.f = -r.f;
+            return r;
+        };
+    }
+    else
+    {
+        m_expr = [value](machine &m) {
+            slot r = value(m);
+            r.i = wrappingSub(0, r.i);
+            return r;
+        };
+    }
+}
+
+void ClosureCompilerVisitor::visitBitWiseAnd(bit_wise_and *node)
+{
+    binaryNode(node, BIT_WISE_AND_NODE);
+}
+
+void ClosureCompilerVisitor::visitBitWiseOr(bit_wise_or *node)
+{
+    binaryNode(node, BIT_WISE_OR_NODE);
+}
+
+void ClosureCompilerVisitor::visitBitWiseXor(bit_wise_xor *node)
+{
+    binaryNode(node, BIT_WISE_XOR_NODE);
+}
+
+void ClosureCompilerVisitor::visitBitWiseNot(bit_wise_not *node)
+{
+    expr_fn value = compileExpr(node->getChildrenList().front(), m_type);
+
+    m_expr = [value](machine &m) {
+        slot r = value(m);
+        r.i = ~r.i;
+        return r;
+    };
+}
+
+void ClosureCompilerVisitor::visitShiftLeft(shift_left *node)
+{
+    binaryNode(node, SHIFT_LEFT_NODE);
+}
+
+void ClosureCompilerVisitor::visitShiftRight(shift_right *node)
+{
+    binaryNode(node, SHIFT_RIGHT_NODE);
+}
+
+void ClosureCompilerVisitor::visitPostfixIncrement(postfix_increment *node)
+{
+    increment(node, 1, false);
+}
+
+void ClosureCompilerVisitor::visitPostfixDecrement(postfix_decrement *node)
+{
+    increment(node, -1, false);
+}
+
+void ClosureCompilerVisitor::visitPrefixIncrement(prefix_increment *node)
+{
+    increment(node, 1, true);
+}
+
+void ClosureCompilerVisitor::visitPrefixDecrement(prefix_decrement *node)
+{
+    increment(node, -1, true);
+}
+
+void ClosureCompilerVisitor::visitAssignment(assignment *node)
+{
+    dataType var_type, value_type;
+    var_ref ref =
+        resolve(static_cast<IDENTIFIER *>(node->getChildrenList().front())
+                    ->getLabel(),
+                var_type);
+    expr_fn value = compileExpr(node->getChildrenList().back(), value_type);
+
+    m_expr = store(ref, convert(value, value_type, var_type));
+    m_type = var_type;
+}
+
+void ClosureCompilerVisitor::visitPlusAssignment(plus_assignment *node)
+{
+    compoundAssignment(node, PLUS_ASSIGNMENT_NODE);
+}
+
+void ClosureCompilerVisitor::visitMinusAssignment(minus_assignment *node)
+{
+    compoundAssignment(node, MINUS_ASSIGNMENT_NODE);
+}
+
+void ClosureCompilerVisitor::visitMulAssignment(mul_assignment *node)
+{
+    compoundAssignment(node, MUL_ASSIGNMENT_NODE);
+}
+
+void ClosureCompilerVisitor::visitDivAssignment(div_assignment *node)
+{
+    compoundAssignment(node, DIV_ASSIGNMENT_NODE);
+}
+
+void ClosureCompilerVisitor::visitModAssignment(mod_assignment *node)
+{
+    compoundAssignment(node, MOD_ASSIGNMENT_NODE);
+}
+
+void ClosureCompilerVisitor::visitVariableDeclarationList(
+    variable_declaration_list *node)
+{
+    auto &temp = node->getChildrenList();
+    auto it = temp.begin();
+
+    if (temp.size() == 2)
+    {
+        (*it)->accept(*this);
+        it++;
+        m_vars.push_back((*it));
+    }
+    else
+    {
+        m_vars.push_back((*it));
+    }
+}
+
+void ClosureCompilerVisitor::visitVariableDeclarationStatement(
+    variable_declaration_statement *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    dataType current_type = static_cast<type_specifier *>(*it)->getType();
+
+    it++;
+    (*it)->accept(*this);
+
+    std::vector<STNode *> vars = m_vars;
+    m_vars.clear();
+
+    bool global = node->getParent()->getNodeType() == EXTERNAL_DECLARATION_NODE;
+    std::vector<expr_fn> stores;
+
+    for (auto &var : vars)
+    {
+        auto &children = var->getChildrenList();
+        std::string name =
+            static_cast<IDENTIFIER *>(children.front())->getLabel();
+
+        // Uninitialized locals start at 0 like in the evaluator
+        expr_fn value = [this](machine &) { return slot(); };
+        if (children.size() > 1)
+        {
+            dataType type;
+            value = compileExpr(children.back(), type);
+            value = convert(value, type, current_type);
+        }
+
+        VarSymbol *sym;
+        if (global)
+        {
+            // The type checker already owns the global symbol
+            sym = dynamic_cast<VarSymbol *>(
+                SymbolTable::getInstance()->lookupGlobal(name));
+            sym->setSlot(m_global_count++);
+            m_global_slots[name] = sym->getSlot();
+            m_global_decls.push_back({name, current_type});
+        }
+        else
+        {
+            sym = new VarSymbol(0, name, current_type);
+            sym->setSlot(m_frame_size++);
+            SymbolTable::getInstance()->insert(sym);
+        }
+
+        expr_fn init = store({global, static_cast<size_t>(sym->getSlot())},
+                             value);
+
+        if (global)
+        {
+            m_init.push_back([init](machine &m) {
+                init(m);
+                return FLOW_NEXT;
+            });
+        }
+        else
+        {
+            stores.push_back(init);
+        }
+    }
+
+    m_stmt = [stores](machine &m) {
+        for (auto &init : stores)
+        {
+            init(m);
+        }
+        return FLOW_NEXT;
+    };
+}
+
+void ClosureCompilerVisitor::visitCompoundStatement(compound_statement *node)
+{
+    bool scoped = node->getParent()->getNodeType() != FUNCTION_DEFINITION_NODE;
+
+    if (scoped)
+    {
+        SymbolTable::getInstance()->enterScope(
+            SymbolTable::getInstance()->getCurrentId());
+    }
+
+    std::vector<stmt_fn> block;
+    compileBlock(node, block);
+
+    if (scoped)
+    {
+        SymbolTable::getInstance()->exitScope();
+    }
+
+    m_stmt = [block](machine &m) {
+        for (auto &stmt : block)
+        {
+            flow f = stmt(m);
+            if (f != FLOW_NEXT)
+            {
+                return f;
+            }
+        }
+        return FLOW_NEXT;
+    };
+}
+
+void ClosureCompilerVisitor::visitStatement(statement *)
+{
+    // Empty statement ";"
+    m_stmt = [](machine &) { return FLOW_NEXT; };
+}
+
+void ClosureCompilerVisitor::visitCondition(condition *node)
+{
+    m_expr = compileExpr(node->getChildrenList().front(), m_type);
+}
+
+void ClosureCompilerVisitor::visitIfStatement(if_statement *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    dataType type;
+    expr_fn cond = compileExpr(*it, type);
+    cond = truth(cond, type);
+    it++;
+
+    stmt_fn then_stmt = compileStmt(*it);
+
+    if (node->getChildrenList().size() == 3)
+    {
+        it++;
+        stmt_fn else_stmt = compileStmt(*it);
+
+        m_stmt = [cond, then_stmt, else_stmt](machine &m) {
+            return cond(m).i ? then_stmt(m) : else_stmt(m);
+        };
+    }
+    else
+    {
+        m_stmt = [cond, then_stmt](machine &m) {
+            return cond(m).i ? then_stmt(m) : FLOW_NEXT;
+        };
+    }
+}
+
+void ClosureCompilerVisitor::visitWhileStatement(while_statement *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    dataType type;
+    expr_fn cond = compileExpr(*it, type);
+    cond = truth(cond, type);
+    it++;
+
+    stmt_fn body = compileStmt(*it);
+
+    m_stmt = [this, cond, body](machine &m) {
+        while (cond(m).i)
+        {
+            countStep(m);
+            flow f = body(m);
+            if (f == FLOW_BREAK)
+            {
+                break;
+            }
+            if (f == FLOW_RETURN)
+            {
+                return f;
+            }
+        }
+        return FLOW_NEXT;
+    };
+}
+
+void ClosureCompilerVisitor::visitDoWhileStatement(do_while_statement *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    stmt_fn body = compileStmt(*it);
+    it++;
+
+    dataType type;
+    expr_fn cond = compileExpr(*it, type);
+    cond = truth(cond, type);
+
+    m_stmt = [this, cond, body](machine &m) {
+        do
+        {
+            countStep(m);
+            flow f = body(m);
+            if (f == FLOW_BREAK)
+            {
+                break;
+            }
+            if (f == FLOW_RETURN)
+            {
+                return f;
+            }
+        } while (cond(m).i);
+        return FLOW_NEXT;
+    };
+}
+
+void ClosureCompilerVisitor::visitForStatement(for_statement *node)
+{
+    auto &children = node->getChildrenList();
+    auto it = children.begin();
+
+    STNode *init_node = (*it++);
+    STNode *cond_node = (*it++);
+    STNode *step_node = nullptr;
+    if (children.size() == 4)
+    {
+        step_node = (*it++);
+    }
+    STNode *body_node = (*it);
+
+    stmt_fn init = compileStmt(init_node);
+
+    // for (;;) has an empty statement as its condition
+    expr_fn cond = [](machine &) {
+        slot r;
+        r.i = 1;
+        return r;
+    };
+    if (cond_node->getNodeType() != STATEMENT_NODE)
+    {
+        dataType type;
+        cond = compileExpr(cond_node, type);
+        cond = truth(cond, type);
+    }
+
+    expr_fn step = [](machine &) { return slot(); };
+    if (step_node != nullptr)
+    {
+        dataType type;
+        step = compileExpr(step_node, type);
+    }
+
+    stmt_fn body = compileStmt(body_node);
+
+    m_stmt = [this, init, cond, step, body](machine &m) {
+        for (init(m); cond(m).i; step(m))
+        {
+            countStep(m);
+            flow f = body(m);
+            if (f == FLOW_BREAK)
+            {
+                break;
+            }
+            if (f == FLOW_RETURN)
+            {
+                return f;
+            }
+        }
+        return FLOW_NEXT;
+    };
+}
+
+void ClosureCompilerVisitor::visitContinue(continue_node *)
+{
+    m_stmt = [](machine &) { return FLOW_CONTINUE; };
+}
+
+void ClosureCompilerVisitor::visitBreak(break_node *)
+{
+    m_stmt = [](machine &) { return FLOW_BREAK; };
+}
+
+void ClosureCompilerVisitor::visitReturn(return_node *node)
+{
+    if (node->getChildrenList().empty())
+    {
+        m_stmt = [](machine &) { return FLOW_RETURN; };
+        return;
+    }
+
+    STNode *child = node->getChildrenList().front();
+
+    // Marked tail calls replace the current frame: the arguments are
+    // evaluated above it, moved over the parameters and enter() runs the
+    // callee once this body has returned
+    if (node->getTailCall() != NO_TAIL_CALL &&
+        child->getNodeType() == FUNCTION_CALL_NODE)
+    {
+        compiled_function *callee;
+        std::vector<expr_fn> args =
+            compileArguments(static_cast<function_call *>(child), callee);
+
+        m_stmt = [this, callee, args](machine &m) mutable {
+            size_t scratch = m.sp;
+            pushArguments(m, args);
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                m.stack[m.base + i] = m.stack[scratch + i];
+            }
+            m.sp = scratch;
+            m.tail = callee;
+            return FLOW_RETURN;
+        };
+        return;
+    }
+
+    dataType type;
+    expr_fn value = compileExpr(child, type);
+    value = convert(value, type, m_return_type);
+
+    m_stmt = [this, value](machine &m) {
+        m.ret = value(m);
+        return FLOW_RETURN;
+    };
+}
+
+void ClosureCompilerVisitor::visitArgumentList(argument_list *node)
+{
+    auto childs = node->getChildrenList();
+
+    if (childs.size() == 2)
+    {
+        auto it = childs.begin();
+        (*it)->accept(*this);
+
+        it++;
+        m_args.push_back(*it);
+    }
+    else
+    {
+        m_args.push_back(node->getChildrenList().front());
+    }
+}
+
+std::vector<ClosureCompilerVisitor::expr_fn>
+ClosureCompilerVisitor::compileArguments(function_call *node,
+                                         compiled_function *&callee)
+{
+    auto it = node->getChildrenList().begin();
+    std::string name = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+    FuncSymbol *def = dynamic_cast<FuncSymbol *>(
+        SymbolTable::getInstance()->lookupGlobal(name));
+    callee = functionNamed(name);
+
+    std::vector<expr_fn> args;
+    if (node->getChildrenList().size() == 2)
+    {
+        it++;
+        (*it)->accept(*this);
+
+        // Arguments may contain calls of their own that reuse m_args
+        std::vector<STNode *> arg_nodes;
+        arg_nodes.swap(m_args);
+
+        std::vector<parameter> &params = def->getParameters();
+        for (size_t i = 0; i < arg_nodes.size(); i++)
+        {
+            dataType type;
+            expr_fn arg = compileExpr(arg_nodes[i], type);
+            args.push_back(convert(arg, type, params[i].type));
+        }
+    }
+
+    m_type = def->getReturnType();
+    return args;
+}
+
+void ClosureCompilerVisitor::visitFunctionCall(function_call *node)
+{
+    compiled_function *callee;
+    std::vector<expr_fn> args = compileArguments(node, callee);
+
+    // Arguments are written straight into the callee's parameter slots
+    m_expr = [this, callee, args](machine &m) mutable {
+        size_t base = m.sp;
+        pushArguments(m, args);
+        enter(m, callee, base);
+        return m.ret;
+    };
+}
+
+void ClosureCompilerVisitor::visitFunctionDefinition(function_definition *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    m_return_type = static_cast<type_specifier *>(*it)->getType();
+    it++;
+    std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+    it++;
+    (*it)->accept(*this);
+    it++;
+    compound_statement *body = static_cast<compound_statement *>(*it);
+    m_nesting = std::max(m_nesting, NativeStack::nesting(node));
+
+    compiled_function *fn = functionNamed(id);
+    m_frame_size = 0;
+
+    SymbolTable::getInstance()->enterScope(
+        SymbolTable::getInstance()->getCurrentId() + 1);
+
+    // Parameters take the first slots of the frame, in order
+    for (auto &param : m_params)
+    {
+        VarSymbol *sym = new VarSymbol(0, param.name, param.type);
+        sym->setSlot(m_frame_size++);
+        SymbolTable::getInstance()->insert(sym);
+    }
+    m_params.clear();
+
+    body->accept(*this);
+
+    SymbolTable::getInstance()->exitScope();
+
+    fn->body = m_stmt;
+    fn->frame_size = m_frame_size;
+}
+
+void ClosureCompilerVisitor::visitFunctionDeclaration(
+    function_declaration *)
+{
+    // The type checker already registered the prototype
+}
+
+void ClosureCompilerVisitor::visitParameterList(parameter_list *node)
+{
+    auto childs = node->getChildrenList();
+
+    if (childs.size() == 3)
+    {
+        auto it = childs.begin();
+        (*it)->accept(*this);
+
+        it++;
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        parameter param = {type, id};
+        m_params.push_back(param);
+    }
+    else if (childs.size() == 2)
+    {
+        auto it = childs.begin();
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        parameter param = {type, id};
+        m_params.push_back(param);
+    }
+    else
+    {
+        // Empty list
+    }
+}
@@ -73,6 +73,9 @@ STNode::STNode(nodeType nodeType, std::initializer_list<STNode *> children)
     m_serial = m_serialCounter++;
     m_graphvizLabel = g_nodeTypeLabels[m_nodeType];
     m_resolved_type = T_VOID;
+    m_line = 0;
+    m_column = 0;
+    m_value_number = -1;
     for (const auto &child : children)
     {
         m_children.push_back(child);
@@ -110,4 +113,18 @@ dataType STNode::getResolvedType() { return m_resolved_type; }
 
 void STNode::setResolvedType(dataType type) { m_resolved_type = type; }
 
+unsigned int STNode::getLine() { return m_line; }
+
+unsigned int STNode::getColumn() { return m_column; }
+
+void STNode::setLocation(unsigned int line, unsigned int column)
+{
+    m_line = line;
+    m_column = column;
+}
+
+int STNode::getValueNumber() { return m_value_number; }
+
+void STNode::setValueNumber(int number) { m_value_number = number; }
+
 void STNode::accept(Visitor &v) { v.visitChildren(this); }
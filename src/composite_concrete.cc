@@ -69,7 +69,7 @@ less::less(expression *left, expression *right)
 }
 
 greater::greater(expression *left, expression *right)
-    : STNode(GREATER_EQUALS_NODE, {left, right})
+    : STNode(GREATER_NODE, {left, right})
 {
 }
 
@@ -395,9 +395,13 @@ translation_unit::translation_unit(external_declaration *external_declaration)
 return_node::return_node(expression *expression)
     : STNode(RETURN_NODE, {expression})
 {
+    m_tail_call = NO_TAIL_CALL;
 }
 
-return_node::return_node() : STNode(RETURN_NODE, {}) {}
+return_node::return_node() : STNode(RETURN_NODE, {})
+{
+    m_tail_call = NO_TAIL_CALL;
+}
 
 program::program(translation_unit *translation_unit)
     : STNode(PROGRAM_NODE, {translation_unit})
@@ -429,6 +433,10 @@ std::string IDENTIFIER::getLabel() { return m_label; }
 int NUMBER::getIValue() { return i_value; }
 float NUMBER::getFValue() { return f_value; }
 dataType type_specifier::getType() { return m_type; }
+tailCallKind return_node::getTailCall() { return m_tail_call; }
+
+// Setters
+void return_node::setTailCall(tailCallKind kind) { m_tail_call = kind; }
 
 // Accepts for visitor
 // --- Leaf Nodes ---
@@ -0,0 +1,273 @@
+#include "../lib/constant_folder_visitor.hh"
+#include <climits>
+
+namespace
+{
+float asFloat(NUMBER *number)
+{
+    if (number->getResolvedType() == T_FLOAT)
+    {
+        return number->getFValue();
+    }
+
+    return static_cast<float>(number->getIValue());
+}
+
+bool isTrue(NUMBER *number)
+{
+    if (number->getResolvedType() == T_FLOAT)
+    {
+        return number->getFValue() != 0.0f;
+    }
+
+    return number->getIValue() != 0;
+}
+} // namespace
+
+ConstantFolderVisitor::ConstantFolderVisitor() { m_folded = 0; }
+
+int ConstantFolderVisitor::wrap(unsigned int value)
+{
+    return static_cast<int>(value);
+}
+
+unsigned int ConstantFolderVisitor::getFolded() { return m_folded; }
+
+void ConstantFolderVisitor::visitChildren(STNode *node)
+{
+    Visitor::visitChildren(node);
+    fold(node);
+}
+
+// The parent's child list is updated in place, so a parent that is walking
+// its children just continues with the next one
+void ConstantFolderVisitor::replace(STNode *node, NUMBER *value)
+{
+    STNode *parent = node->getParent();
+
+    value->setParent(parent);
+    value->setLocation(node->getLine(), node->getColumn());
+    for (auto &child : parent->getChildrenList())
+    {
+        if (child == node)
+        {
+            child = value;
+            break;
+        }
+    }
+
+    delete node;
+    m_folded++;
+}
+
+void ConstantFolderVisitor::fold(STNode *node)
+{
+    auto &children = node->getChildrenList();
+    if (children.empty() || node->getParent() == nullptr)
+    {
+        return;
+    }
+
+    NUMBER *left = nullptr;
+    NUMBER *right = nullptr;
+    if (children.front()->getNodeType() == NUMBER_NODE)
+    {
+        left = static_cast<NUMBER *>(children.front());
+    }
+    if (children.back()->getNodeType() == NUMBER_NODE)
+    {
+        right = static_cast<NUMBER *>(children.back());
+    }
+
+    NUMBER *result = nullptr;
+    switch (node->getNodeType())
+    {
+    case UNARY_PLUS_NODE:
+    case UNARY_MINUS_NODE:
+    case LOGIC_NOT_NODE:
+    case BIT_WISE_NOT_NODE:
+        if (left != nullptr && !foldUnary(node, left, result))
+        {
+            return;
+        }
+        break;
+    case LOGIC_AND_NODE:
+        // The right side is never evaluated after a false left side
+        if (left != nullptr && !isTrue(left))
+        {
+            result = new NUMBER(0);
+        }
+        else if (left != nullptr && right != nullptr)
+        {
+            result = new NUMBER(isTrue(right) ? 1 : 0);
+        }
+        break;
+    case LOGIC_OR_NODE:
+        if (left != nullptr && isTrue(left))
+        {
+            result = new NUMBER(1);
+        }
+        else if (left != nullptr && right != nullptr)
+        {
+            result = new NUMBER(isTrue(right) ? 1 : 0);
+        }
+        break;
+    default:
+        if (children.size() == 2 && left != nullptr && right != nullptr &&
+            !foldBinary(node, left, right, result))
+        {
+            return;
+        }
+        break;
+    }
+
+    if (result != nullptr)
+    {
+        replace(node, result);
+    }
+}
+
+bool ConstantFolderVisitor::foldUnary(STNode *node, NUMBER *operand,
+                                      NUMBER *&result)
+{
+    bool is_float = operand->getResolvedType() == T_FLOAT;
+
+    switch (node->getNodeType())
+    {
+    case UNARY_PLUS_NODE:
+        result = is_float ? new NUMBER(operand->getFValue())
+                          : new NUMBER(operand->getIValue());
+        return true;
+    case UNARY_MINUS_NODE:
+        result = is_float
+                     ? new NUMBER(-operand->getFValue())
+                     : new NUMBER(wrap(0u - static_cast<unsigned int>(
+                                               operand->getIValue())));
+        return true;
+    case LOGIC_NOT_NODE:
+        result = new NUMBER(isTrue(operand) ? 0 : 1);
+        return true;
+    case BIT_WISE_NOT_NODE:
+        if (is_float)
+        {
+            return false;
+        }
+        result = new NUMBER(~operand->getIValue());
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ConstantFolderVisitor::foldBinary(STNode *node, NUMBER *left,
+                                       NUMBER *right, NUMBER *&result)
+{
+    nodeType op = node->getNodeType();
+    bool is_float = left->getResolvedType() == T_FLOAT ||
+                    right->getResolvedType() == T_FLOAT;
+
+    if (is_float)
+    {
+        float a = asFloat(left);
+        float b = asFloat(right);
+
+        switch (op)
+        {
+        case ADDITION_NODE:
+            result = new NUMBER(a + b);
+            return true;
+        case SUBTRACTION_NODE:
+            result = new NUMBER(a - b);
+            return true;
+        case MULTIPLICATION_NODE:
+            result = new NUMBER(a * b);
+            return true;
+        case DIVISION_NODE:
+            result = new NUMBER(a / b);
+            return true;
+        case LESS_NODE:
+            result = new NUMBER(a < b ? 1 : 0);
+            return true;
+        case LESS_EQUALS_NODE:
+            result = new NUMBER(a <= b ? 1 : 0);
+            return true;
+        case GREATER_NODE:
+            result = new NUMBER(a > b ? 1 : 0);
+            return true;
+        case GREATER_EQUALS_NODE:
+            result = new NUMBER(a >= b ? 1 : 0);
+            return true;
+        case LOGIC_EQUALS_NODE:
+            result = new NUMBER(a == b ? 1 : 0);
+            return true;
+        case LOGIC_NOT_EQUALS_NODE:
+            result = new NUMBER(a != b ? 1 : 0);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    int a = left->getIValue();
+    int b = right->getIValue();
+    unsigned int ua = static_cast<unsigned int>(a);
+    unsigned int ub = static_cast<unsigned int>(b);
+
+    switch (op)
+    {
+    case ADDITION_NODE:
+        result = new NUMBER(wrap(ua + ub));
+        return true;
+    case SUBTRACTION_NODE:
+        result = new NUMBER(wrap(ua - ub));
+        return true;
+    case MULTIPLICATION_NODE:
+        result = new NUMBER(wrap(ua * ub));
+        return true;
+    case DIVISION_NODE:
+    case MOD_NODE:
+        if (b == 0 || (a == INT_MIN && b == -1))
+        {
+            return false;
+        }
+        result = new NUMBER(op == DIVISION_NODE ? a / b : a % b);
+        return true;
+    case LESS_NODE:
+        result = new NUMBER(a < b ? 1 : 0);
+        return true;
+    case LESS_EQUALS_NODE:
+        result = new NUMBER(a <= b ? 1 : 0);
+        return true;
+    case GREATER_NODE:
+        result = new NUMBER(a > b ? 1 : 0);
+        return true;
+    case GREATER_EQUALS_NODE:
+        result = new NUMBER(a >= b ? 1 : 0);
+        return true;
+    case LOGIC_EQUALS_NODE:
+        result = new NUMBER(a == b ? 1 : 0);
+        return true;
+    case LOGIC_NOT_EQUALS_NODE:
+        result = new NUMBER(a != b ? 1 : 0);
+        return true;
+    case BIT_WISE_AND_NODE:
+        result = new NUMBER(a & b);
+        return true;
+    case BIT_WISE_OR_NODE:
+        result = new NUMBER(a | b);
+        return true;
+    case BIT_WISE_XOR_NODE:
+        result = new NUMBER(a ^ b);
+        return true;
+    case SHIFT_LEFT_NODE:
+    case SHIFT_RIGHT_NODE:
+        if (b < 0 || b > 31)
+        {
+            return false;
+        }
+        result = new NUMBER(op == SHIFT_LEFT_NODE ? wrap(ua << b) : a >> b);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,182 @@
+#include "../lib/cse_pass.hh"
+#include "../lib/dominator_tree.hh"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+std::string CsePass::getName() { return "cse"; }
+
+static std::string valueKey(ir_value &value)
+{
+    std::string key = std::to_string(value.kind) + ":" +
+                      std::to_string(value.type) + ":";
+    switch (value.kind)
+    {
+    case VAL_REG:
+        return key + std::to_string(value.reg);
+    case VAL_INT:
+        return key + std::to_string(value.ivalue);
+    case VAL_FLOAT:
+    {
+        // The bits, so -0.0 and 0.0 stay apart
+        unsigned long long bits;
+        std::memcpy(&bits, &value.fvalue, sizeof(bits));
+        return key + std::to_string(bits);
+    }
+    case VAL_GLOBAL:
+        return key + value.global;
+    default:
+        return key;
+    }
+}
+
+// The operation and its operands, empty for instructions that can't be
+// reused: phis, memory, calls and terminators
+std::string CsePass::key(ir_instruction &instr)
+{
+    switch (instr.op)
+    {
+    case OP_LOAD:
+    case OP_STORE:
+    case OP_CALL:
+    case OP_PHI:
+    case OP_BR:
+    case OP_COND_BR:
+    case OP_RET:
+    case OP_UNREACHABLE:
+        return "";
+    default:
+        break;
+    }
+
+    std::vector<std::string> operands;
+    for (auto &operand : instr.operands)
+    {
+        operands.push_back(valueKey(operand));
+    }
+
+    // a + b and b + a are the same value
+    if (instr.op == OP_ADD || instr.op == OP_MUL || instr.op == OP_AND ||
+        instr.op == OP_OR || instr.op == OP_XOR || instr.op == OP_FADD ||
+        instr.op == OP_FMUL)
+    {
+        std::sort(operands.begin(), operands.end());
+    }
+
+    std::string key = std::to_string(instr.op) + " " +
+                      std::to_string(instr.result.type) + " " +
+                      instr.predicate + (instr.nsw ? " nsw" : "") +
+                      (instr.fast ? " fast" : "");
+    for (auto &operand : operands)
+    {
+        key += " " + operand;
+    }
+
+    return key;
+}
+
+bool CsePass::runOnFunction(ir_function &function)
+{
+    if (function.blocks.empty())
+    {
+        return false;
+    }
+
+    DominatorTree tree(function);
+
+    // Every computation seen so far, with the block it is in
+    std::unordered_map<std::string, std::vector<std::pair<ir_block *, ir_value>>>
+        available;
+    std::unordered_map<int, ir_value> replaced;
+
+    auto rewrite = [&](ir_instruction &instr) {
+        for (auto &operand : instr.operands)
+        {
+            if (operand.kind != VAL_REG)
+            {
+                continue;
+            }
+
+            auto found = replaced.find(operand.reg);
+            if (found != replaced.end())
+            {
+                operand = found->second;
+            }
+        }
+    };
+
+    // In reverse postorder a block comes after the blocks dominating it, and
+    // only phis can use a register before its definition was looked at
+    for (ir_block *block : tree.getOrder())
+    {
+        // What every global holds as far as this block knows
+        std::unordered_map<std::string, ir_value> memory;
+
+        std::vector<ir_instruction> kept;
+        kept.reserve(block->instructions.size());
+        for (auto &instr : block->instructions)
+        {
+            rewrite(instr);
+
+            if (instr.op == OP_STORE)
+            {
+                memory[instr.operands[1].global] = instr.operands[0];
+            }
+            else if (instr.op == OP_CALL)
+            {
+                // The callee may write any global
+                memory.clear();
+            }
+            else if (instr.op == OP_LOAD)
+            {
+                auto found = memory.find(instr.operands[0].global);
+                if (found != memory.end() &&
+                    found->second.type == instr.result.type)
+                {
+                    replaced[instr.result.reg] = found->second;
+                    continue;
+                }
+                memory[instr.operands[0].global] = instr.result;
+            }
+            else
+            {
+                std::string name = key(instr);
+                if (!name.empty())
+                {
+                    auto &candidates = available[name];
+                    auto dominating = std::find_if(
+                        candidates.begin(), candidates.end(),
+                        [&](std::pair<ir_block *, ir_value> &candidate) {
+                            return tree.dominates(candidate.first, block);
+                        });
+                    if (dominating != candidates.end())
+                    {
+                        replaced[instr.result.reg] = dominating->second;
+                        continue;
+                    }
+                    candidates.push_back({block, instr.result});
+                }
+            }
+
+            kept.push_back(instr);
+        }
+
+        block->instructions.swap(kept);
+    }
+
+    if (replaced.empty())
+    {
+        return false;
+    }
+
+    // Phis fed over a back edge
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            rewrite(instr);
+        }
+    }
+
+    return true;
+}
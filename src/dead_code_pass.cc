@@ -0,0 +1,51 @@
+#include "../lib/dead_code_pass.hh"
+
+std::string DeadCodePass::getName() { return "dce"; }
+
+bool DeadCodePass::runOnFunction(ir_function &function)
+{
+    bool changed = false;
+    bool removed = true;
+
+    while (removed)
+    {
+        removed = false;
+
+        std::vector<unsigned int> uses(function.reg_names.size(), 0);
+        for (auto &block : function.blocks)
+        {
+            for (auto &instr : block->instructions)
+            {
+                for (auto &operand : instr.operands)
+                {
+                    if (operand.kind == VAL_REG)
+                    {
+                        uses[operand.reg]++;
+                    }
+                }
+            }
+        }
+
+        for (auto &block : function.blocks)
+        {
+            auto &instrs = block->instructions;
+            for (auto it = instrs.begin(); it != instrs.end();)
+            {
+                if (!it->hasSideEffects() && it->result.kind == VAL_REG &&
+                    uses[it->result.reg] == 0)
+                {
+                    it = instrs.erase(it);
+                    removed = true;
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+
+        changed = changed || removed;
+    }
+
+    return changed;
+}
@@ -42,17 +42,17 @@ void DeclaratorVisitor::visitFunctionDeclaration(function_declaration *node)
 
     FuncSymbol *sym = new FuncSymbol(return_type, nullptr, m_params, id);
 
-    SymbolTable::getInstance()->insert(sym);
+    // The type checker may have registered the prototype already
+    if (!SymbolTable::getInstance()->insert(sym))
+    {
+        delete sym;
+    }
     m_params.clear();
 }
 
 void DeclaratorVisitor::visitVariableDeclaration(variable_declaration *node)
 {
-    if (node->getParent()->getNodeType() != EXTERNAL_DECLARATION_NODE)
-    {
-        return;
-    }
-
+    // Function bodies are never visited, so every declaration here is global
     auto &temp = node->getChildrenList();
     auto it = temp.begin();
 
@@ -94,15 +94,27 @@ void DeclaratorVisitor::visitVariableDeclarationStatement(
     (*it)->accept(*this);
     for (auto &var : m_vars)
     {
+        m_result = 0;
         var->accept(*this);
 
-        VarSymbol *sym = new VarSymbol(
-            m_result,
+        std::string name =
             static_cast<IDENTIFIER *>(var->getChildrenList().front())
-                ->getLabel(),
-            currentType);
-
-        SymbolTable::getInstance()->insertGlobal(sym);
+                ->getLabel();
+
+        // After type checking the global already exists, only its value is
+        // missing
+        VarSymbol *existing = dynamic_cast<VarSymbol *>(
+            SymbolTable::getInstance()->lookupGlobal(name));
+
+        if (existing)
+        {
+            existing->setValue(m_result);
+        }
+        else
+        {
+            VarSymbol *sym = new VarSymbol(m_result, name, currentType);
+            SymbolTable::getInstance()->insertGlobal(sym);
+        }
     }
 
     m_vars.clear();
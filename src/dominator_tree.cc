@@ -0,0 +1,117 @@
+#include "../lib/dominator_tree.hh"
+#include <algorithm>
+#include <unordered_set>
+
+std::vector<ir_block *> DominatorTree::successors(ir_block *block)
+{
+    if (block->instructions.empty())
+    {
+        return {};
+    }
+
+    ir_instruction &last = block->instructions.back();
+    if (last.op == OP_BR || last.op == OP_COND_BR)
+    {
+        return last.targets;
+    }
+
+    return {};
+}
+
+DominatorTree::DominatorTree(ir_function &function)
+{
+    m_entry = function.blocks.front().get();
+
+    std::unordered_set<ir_block *> visited = {m_entry};
+    std::vector<std::pair<ir_block *, size_t>> stack = {{m_entry, 0}};
+    while (!stack.empty())
+    {
+        ir_block *block = stack.back().first;
+        std::vector<ir_block *> succs = successors(block);
+        if (stack.back().second < succs.size())
+        {
+            ir_block *succ = succs[stack.back().second++];
+            if (visited.insert(succ).second)
+            {
+                stack.push_back({succ, 0});
+            }
+            continue;
+        }
+
+        m_order.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(m_order.begin(), m_order.end());
+
+    for (size_t i = 0; i < m_order.size(); i++)
+    {
+        m_index[m_order[i]] = i;
+        for (ir_block *succ : successors(m_order[i]))
+        {
+            m_preds[succ].push_back(m_order[i]);
+        }
+    }
+
+    // Immediate dominators, iterated over the reverse postorder until they
+    // settle
+    m_idom[m_entry] = m_entry;
+    bool settled = false;
+    while (!settled)
+    {
+        settled = true;
+        for (size_t i = 1; i < m_order.size(); i++)
+        {
+            ir_block *dom = nullptr;
+            for (ir_block *pred : m_preds[m_order[i]])
+            {
+                if (!m_idom.count(pred))
+                {
+                    continue;
+                }
+                if (!dom)
+                {
+                    dom = pred;
+                    continue;
+                }
+
+                ir_block *other = pred;
+                while (dom != other)
+                {
+                    while (m_index[dom] > m_index[other])
+                    {
+                        dom = m_idom[dom];
+                    }
+                    while (m_index[other] > m_index[dom])
+                    {
+                        other = m_idom[other];
+                    }
+                }
+            }
+
+            if (m_idom[m_order[i]] != dom)
+            {
+                m_idom[m_order[i]] = dom;
+                settled = false;
+            }
+        }
+    }
+}
+
+std::vector<ir_block *> &DominatorTree::getOrder() { return m_order; }
+
+DominatorTree::pred_map &DominatorTree::getPredecessors() { return m_preds; }
+
+bool DominatorTree::dominates(ir_block *dom, ir_block *block)
+{
+    if (!m_idom.count(block))
+    {
+        return false;
+    }
+
+    while (block != dom && block != m_entry)
+    {
+        block = m_idom[block];
+    }
+
+    return block == dom;
+}
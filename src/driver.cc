@@ -0,0 +1,125 @@
+#include "../lib/driver.hh"
+#include "../lib/bitcode_writer.hh"
+#include "../lib/ir_printer.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+PipeBuffer::PipeBuffer() { m_file = nullptr; }
+
+void PipeBuffer::setFile(FILE *file) { m_file = file; }
+
+int PipeBuffer::overflow(int c)
+{
+    if (c == traits_type::eof())
+    {
+        return traits_type::not_eof(c);
+    }
+
+    return std::fputc(c, m_file) == EOF ? traits_type::eof() : c;
+}
+
+std::streamsize PipeBuffer::xsputn(const char *s, std::streamsize n)
+{
+    return std::fwrite(s, 1, n, m_file);
+}
+
+Driver::Driver() : m_pipe_stream(&m_pipe_buffer)
+{
+    m_clang = "clang";
+    m_opt_level = 0;
+    m_save_temps = false;
+    m_bitcode = false;
+    m_pipe = nullptr;
+}
+
+void Driver::setClang(std::string clang) { m_clang = clang; }
+
+void Driver::setOptLevel(unsigned int opt_level) { m_opt_level = opt_level; }
+
+void Driver::setSaveTemps(bool save_temps) { m_save_temps = save_temps; }
+
+void Driver::setBitcode(bool bitcode) { m_bitcode = bitcode; }
+
+void Driver::writeModule(IRModule &module, std::ostream &out)
+{
+    if (m_bitcode)
+    {
+        BitcodeWriter writer(out);
+        writer.write(module);
+    }
+    else
+    {
+        IRPrinter printer(out);
+        printer.print(module);
+    }
+}
+
+// Single quotes keep paths with spaces as one shell word
+std::string Driver::quote(std::string arg)
+{
+    std::string quoted = "'";
+    for (char c : arg)
+    {
+        quoted += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+    }
+
+    return quoted + "'";
+}
+
+std::ostream &Driver::open(std::string output)
+{
+    m_output = output;
+    m_command = quote(m_clang) + " -x ir -O" + std::to_string(m_opt_level) +
+                " -o " + quote(output);
+
+    if (m_save_temps)
+    {
+        // output.ll or output.bc next to clang's .s and .o
+        std::string ir = output + (m_bitcode ? ".bc" : ".ll");
+        m_file.open(ir, std::ios::binary);
+        m_command += " -save-temps=obj " + quote(ir);
+        return m_file;
+    }
+
+    m_pipe = popen((m_command + " -").c_str(), "w");
+    if (m_pipe == nullptr)
+    {
+        std::cerr << "Driver Error: Could not run " << m_clang << std::endl;
+        exit(1);
+    }
+
+    m_pipe_buffer.setFile(m_pipe);
+    return m_pipe_stream;
+}
+
+void Driver::close()
+{
+    int status;
+
+    if (m_save_temps)
+    {
+        m_file.close();
+        status = std::system(m_command.c_str());
+    }
+    else
+    {
+        m_pipe_stream.flush();
+        status = pclose(m_pipe);
+        m_pipe = nullptr;
+    }
+
+    if (status != 0)
+    {
+        std::cerr << "Driver Error: " << m_clang << " failed to build "
+                  << m_output << std::endl;
+        exit(1);
+    }
+}
+
+void Driver::build(IRModule &module, std::string output)
+{
+    writeModule(module, open(output));
+    close();
+}
@@ -1,12 +1,306 @@
 #include "../lib/evaluator_visitor.hh"
 #include <iostream>
 
+// Native stack of one interpreted call: visitFunctionCall, invoke and the
+// exception handling around the body, plus the accept, visit and
+// visitChildren frames of every syntax tree level inside the body
+static const size_t g_stack_per_call = 2 * 1024;
+static const size_t g_stack_per_level = 256;
+// callCompiled enters compiled code with up to 6 ints, functions that are
+// only called from other compiled code may take more
+static const size_t g_max_compiled_args = 6;
+
+// Largest return expression, in nodes, that is evaluated inline
+static const size_t g_inline_nodes = 24;
+
 EvaluatorVisitor::EvaluatorVisitor() {}
 
+EvaluatorVisitor::~EvaluatorVisitor()
+{
+#if defined(__x86_64__)
+    for (auto &tier : m_tiers)
+    {
+        delete tier;
+    }
+#endif
+    delete m_memo;
+}
+
 Value EvaluatorVisitor::getResult() { return m_result; }
 
+void EvaluatorVisitor::setTierThreshold(unsigned long threshold)
+{
+    m_tier_threshold = threshold;
+}
+
+void EvaluatorVisitor::setMemoization(std::unordered_set<std::string> &pure,
+                                      size_t entries)
+{
+    delete m_memo;
+    m_memo = nullptr;
+    m_memoizable.clear();
+
+    if (!entries)
+    {
+        return;
+    }
+
+    // The key is the argument values, so only int signatures qualify
+    for (auto &name : pure)
+    {
+        FuncSymbol *func = dynamic_cast<FuncSymbol *>(
+            SymbolTable::getInstance()->lookupGlobal(name));
+        if (func == nullptr)
+        {
+            continue;
+        }
+
+        bool ints = func->getReturnType() == T_INT;
+
+        for (auto &param : func->getParameters())
+        {
+            ints = ints && param.type == T_INT;
+        }
+
+        if (ints)
+        {
+            m_memoizable.insert(func);
+        }
+    }
+
+    m_memo = new MemoCache(entries);
+}
+
+MemoCache *EvaluatorVisitor::getMemoCache() { return m_memo; }
+
+void EvaluatorVisitor::setMaxCallDepth(size_t depth)
+{
+    m_max_call_depth = depth;
+#if defined(__x86_64__)
+    JitCompilerVisitor::setMaxCallDepth(depth);
+#endif
+}
+
+void EvaluatorVisitor::run(STNode *root)
+{
+    std::pair<EvaluatorVisitor *, STNode *> job = {this, root};
+
+    size_t nesting = NativeStack::nesting(root);
+    m_stack_reserve = g_stack_per_call + nesting * g_stack_per_level;
+    size_t size = NativeStack::sizeFor(m_max_call_depth, g_stack_per_call,
+                                       nesting, g_stack_per_level);
+
+    bool started = NativeStack::run(
+        size,
+        [](void *arg) -> void * {
+            auto job = static_cast<std::pair<EvaluatorVisitor *, STNode *> *>(arg);
+            job->second->accept(*job->first);
+            return nullptr;
+        },
+        &job);
+
+    if (!started)
+    {
+        std::cerr << "Runtime Error: Cannot allocate a stack for "
+                  << m_max_call_depth << " calls" << std::endl;
+        exit(1);
+    }
+}
+
+void EvaluatorVisitor::countBackEdge()
+{
+    if (m_tier_threshold && !m_call_stack.empty())
+    {
+        m_hotness[m_call_stack.back().func]++;
+    }
+}
+
+void EvaluatorVisitor::setProfiler(Profiler *profiler)
+{
+    m_profiler = profiler;
+}
+
+void EvaluatorVisitor::countIteration(STNode *loop)
+{
+    if (m_profiler != nullptr && !m_call_stack.empty())
+    {
+        m_profiler->countIteration(loop, m_call_stack.back().func->getName());
+        if (m_profiler->due())
+        {
+            sampleStack();
+        }
+    }
+}
+
+void EvaluatorVisitor::sampleStack()
+{
+    std::string stack;
+    for (auto &frame : m_call_stack)
+    {
+        if (!stack.empty())
+        {
+            stack += ';';
+        }
+        stack += frame.func->getName();
+    }
+
+    m_profiler->sample(stack);
+}
+
+// The evaluator only knows ints, so only functions that never see a float
+// can move to the JIT without changing what the program computes
+bool EvaluatorVisitor::isCompilable(FuncSymbol *func)
+{
+    auto cached = m_compilable.find(func);
+    if (cached != m_compilable.end())
+    {
+        return cached->second;
+    }
+
+    bool compilable = func->getFunctionBody() != nullptr &&
+                      func->getReturnType() != T_FLOAT;
+
+    for (auto &param : func->getParameters())
+    {
+        compilable = compilable && param.type == T_INT;
+    }
+
+    compilable = compilable && isCompilableTree(func->getFunctionBody());
+    m_compilable[func] = compilable;
+
+    return compilable;
+}
+
+bool EvaluatorVisitor::isCompilableTree(STNode *node)
+{
+    if (node->getResolvedType() == T_FLOAT)
+    {
+        return false;
+    }
+
+    if (node->getNodeType() == TYPE_SPECIFIER_NODE &&
+        static_cast<type_specifier *>(node)->getType() == T_FLOAT)
+    {
+        return false;
+    }
+
+    for (auto &child : node->getChildrenList())
+    {
+        if (!isCompilableTree(child))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void EvaluatorVisitor::collectCallees(STNode *node,
+                                      std::vector<FuncSymbol *> &callees)
+{
+    if (node->getNodeType() == FUNCTION_CALL_NODE)
+    {
+        std::string name =
+            static_cast<IDENTIFIER *>(node->getChildrenList().front())
+                ->getLabel();
+        callees.push_back(dynamic_cast<FuncSymbol *>(
+            SymbolTable::getInstance()->lookupGlobal(name)));
+    }
+
+    for (auto &child : node->getChildrenList())
+    {
+        collectCallees(child, callees);
+    }
+}
+
+#if defined(__x86_64__)
+// Compiled code calls its callees directly, so the whole call graph below
+// func has to be compilable and is compiled together
+void EvaluatorVisitor::promote(FuncSymbol *func)
+{
+    std::unordered_set<std::string> closure;
+    std::vector<FuncSymbol *> work = {func};
+
+    while (!work.empty())
+    {
+        FuncSymbol *current = work.back();
+        work.pop_back();
+
+        if (!closure.insert(current->getName()).second)
+        {
+            continue;
+        }
+
+        if (!isCompilable(current))
+        {
+            m_compilable[func] = false;
+            return;
+        }
+
+        collectCallees(current->getFunctionBody(), work);
+    }
+
+    JitCompilerVisitor *tier = new JitCompilerVisitor();
+    tier->shareGlobals();
+    tier->restrictTo(closure);
+    m_program->accept(*tier);
+    m_tiers.push_back(tier);
+
+    m_compiled[func] = tier->getFunctionAddress(func->getName());
+}
+
+Value EvaluatorVisitor::callCompiled(void *code, std::vector<Value> &values)
+{
+    Value *v = values.data();
+
+    switch (values.size())
+    {
+    case 0:
+        return reinterpret_cast<Value (*)()>(code)();
+    case 1:
+        return reinterpret_cast<Value (*)(Value)>(code)(v[0]);
+    case 2:
+        return reinterpret_cast<Value (*)(Value, Value)>(code)(v[0], v[1]);
+    case 3:
+        return reinterpret_cast<Value (*)(Value, Value, Value)>(code)(
+            v[0], v[1], v[2]);
+    case 4:
+        return reinterpret_cast<Value (*)(Value, Value, Value, Value)>(code)(
+            v[0], v[1], v[2], v[3]);
+    case 5:
+        return reinterpret_cast<Value (*)(Value, Value, Value, Value, Value)>(
+            code)(v[0], v[1], v[2], v[3], v[4]);
+    default:
+        return reinterpret_cast<Value (*)(Value, Value, Value, Value, Value,
+                                          Value)>(code)(v[0], v[1], v[2], v[3],
+                                                        v[4], v[5]);
+    }
+}
+#endif
+
 void EvaluatorVisitor::visitIDENTIFIER(IDENTIFIER *node)
 {
+    if (m_inline_func != nullptr)
+    {
+        std::vector<parameter> &params = m_inline_func->getParameters();
+        for (size_t i = 0; i < params.size(); i++)
+        {
+            if (params[i].name == node->getLabel())
+            {
+                m_result = (*m_inline_args)[i];
+                return;
+            }
+        }
+
+        // Anything else in an inlined body is a global, the caller's
+        // locals must not shadow it
+        m_result = static_cast<VarSymbol *>(
+                       SymbolTable::getInstance()->lookupGlobal(
+                           node->getLabel()))
+                       ->getValue();
+        return;
+    }
+
     VarSymbol *sym = dynamic_cast<VarSymbol *>(
         SymbolTable::getInstance()->lookup(node->getLabel()));
 
@@ -28,35 +322,80 @@ void EvaluatorVisitor::visitNUMBER(NUMBER *node)
 
 void EvaluatorVisitor::visitUnaryPlus(unary_plus *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
 
     m_result = +m_result;
 }
 
 void EvaluatorVisitor::visitUnaryMinus(unary_minus *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
 
     m_result = -m_result;
 }
 
 void EvaluatorVisitor::visitAddition(addition *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result + right_result;
 }
 
+// Reads an int literal operand without visiting it
+static bool intLiteral(STNode *node, Value &value)
+{
+    if (node->getNodeType() != NUMBER_NODE ||
+        node->getResolvedType() != T_INT)
+    {
+        return false;
+    }
+
+    value = static_cast<NUMBER *>(node)->getIValue();
+    return true;
+}
+
+// k when value is 2^k for k from 1 to 30, otherwise 0
+static int powerOfTwo(Value value)
+{
+    if (value < 2 || (value & (value - 1)) != 0)
+    {
+        return 0;
+    }
+
+    return __builtin_ctz(value);
+}
+
 void EvaluatorVisitor::visitMultiplication(multiplication *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    STNode *left = node->getChildrenList().front();
+    STNode *right = node->getChildrenList().back();
+
+    // A power of two literal on either side is a shift
+    Value literal;
+    int shift = 0;
+    if (intLiteral(right, literal) && (shift = powerOfTwo(literal)))
+    {
+        evaluate(left);
+        m_result = static_cast<Value>(static_cast<unsigned int>(m_result)
+                                      << shift);
+        return;
+    }
+    if (intLiteral(left, literal) && (shift = powerOfTwo(literal)))
+    {
+        evaluate(right);
+        m_result = static_cast<Value>(static_cast<unsigned int>(m_result)
+                                      << shift);
+        return;
+    }
+
+    evaluate(left);
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(right);
     Value right_result = m_result;
 
     m_result = left_result * right_result;
@@ -64,10 +403,10 @@ void EvaluatorVisitor::visitMultiplication(multiplication *node)
 
 void EvaluatorVisitor::visitSubtraction(subtraction *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result - right_result;
@@ -75,22 +414,48 @@ void EvaluatorVisitor::visitSubtraction(subtraction *node)
 
 void EvaluatorVisitor::visitMod(mod *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
-    Value right_result = m_result;
+    Value right_result;
+    bool literal = intLiteral(node->getChildrenList().back(), right_result);
+    if (!literal)
+    {
+        evaluate(node->getChildrenList().back());
+        right_result = m_result;
+    }
+
+    if (!right_result)
+    {
+        std::cerr << "Runtime Error: Cant divide with 0" << std::endl;
+        exit(1);
+    }
+
+    // The remainder keeps the dividend's sign: a negative dividend is moved
+    // up to round towards zero before the mask drops the low bits
+    int shift = literal ? powerOfTwo(right_result) : 0;
+    if (shift)
+    {
+        Value bias = (left_result >> 31) & (right_result - 1);
+        m_result = left_result - ((left_result + bias) & -right_result);
+        return;
+    }
 
     m_result = left_result % right_result;
 }
 
 void EvaluatorVisitor::visitDivision(division *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
-    Value right_result = m_result;
+    Value right_result;
+    bool literal = intLiteral(node->getChildrenList().back(), right_result);
+    if (!literal)
+    {
+        evaluate(node->getChildrenList().back());
+        right_result = m_result;
+    }
 
     if (!right_result)
     {
@@ -98,15 +463,24 @@ void EvaluatorVisitor::visitDivision(division *node)
         exit(1);
     }
 
+    // A shift rounds down, / rounds towards zero
+    int shift = literal ? powerOfTwo(right_result) : 0;
+    if (shift)
+    {
+        Value bias = (left_result >> 31) & (right_result - 1);
+        m_result = (left_result + bias) >> shift;
+        return;
+    }
+
     m_result = left_result / right_result;
 }
 
 void EvaluatorVisitor::visitLess(less *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result < right_result;
@@ -114,10 +488,10 @@ void EvaluatorVisitor::visitLess(less *node)
 
 void EvaluatorVisitor::visitLessEquals(less_equals *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result <= right_result;
@@ -125,10 +499,10 @@ void EvaluatorVisitor::visitLessEquals(less_equals *node)
 
 void EvaluatorVisitor::visitGreater(greater *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result > right_result;
@@ -136,10 +510,10 @@ void EvaluatorVisitor::visitGreater(greater *node)
 
 void EvaluatorVisitor::visitGreaterEquals(greater_equals *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result >= right_result;
@@ -147,10 +521,10 @@ void EvaluatorVisitor::visitGreaterEquals(greater_equals *node)
 
 void EvaluatorVisitor::visitLogicEquals(logic_equals *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result == right_result;
@@ -158,32 +532,42 @@ void EvaluatorVisitor::visitLogicEquals(logic_equals *node)
 
 void EvaluatorVisitor::visitLogicAnd(logic_and *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
-    Value right_result = m_result;
+    // Short circuit like C, the right side may have side effects
+    if (!left_result)
+    {
+        m_result = 0;
+        return;
+    }
 
-    m_result = left_result && right_result;
+    evaluate(node->getChildrenList().back());
+    m_result = m_result != 0;
 }
 
 void EvaluatorVisitor::visitLogicOr(logic_or *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
-    Value right_result = m_result;
+    // Short circuit like C, the right side may have side effects
+    if (left_result)
+    {
+        m_result = 1;
+        return;
+    }
 
-    m_result = left_result || right_result;
+    evaluate(node->getChildrenList().back());
+    m_result = m_result != 0;
 }
 
 void EvaluatorVisitor::visitLogicNotEquals(logic_not_equals *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result != right_result;
@@ -191,17 +575,17 @@ void EvaluatorVisitor::visitLogicNotEquals(logic_not_equals *node)
 
 void EvaluatorVisitor::visitLogicNot(logic_not *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
 
     m_result = !m_result;
 }
 
 void EvaluatorVisitor::visitBitWiseAnd(bit_wise_and *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result & right_result;
@@ -209,10 +593,10 @@ void EvaluatorVisitor::visitBitWiseAnd(bit_wise_and *node)
 
 void EvaluatorVisitor::visitBitWiseOr(bit_wise_or *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result | right_result;
@@ -220,10 +604,10 @@ void EvaluatorVisitor::visitBitWiseOr(bit_wise_or *node)
 
 void EvaluatorVisitor::visitBitWiseXor(bit_wise_xor *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result ^ right_result;
@@ -231,17 +615,17 @@ void EvaluatorVisitor::visitBitWiseXor(bit_wise_xor *node)
 
 void EvaluatorVisitor::visitBitWiseNot(bit_wise_not *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
 
     m_result = ~m_result;
 }
 
 void EvaluatorVisitor::visitShiftLeft(shift_left *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result << right_result;
@@ -249,10 +633,10 @@ void EvaluatorVisitor::visitShiftLeft(shift_left *node)
 
 void EvaluatorVisitor::visitShiftRight(shift_right *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
     Value left_result = m_result;
 
-    node->getChildrenList().back()->accept(*this);
+    evaluate(node->getChildrenList().back());
     Value right_result = m_result;
 
     m_result = left_result >> right_result;
@@ -270,6 +654,7 @@ void EvaluatorVisitor::visitPostfixIncrement(postfix_increment *node)
 
     Value old_value = sym->getValue();
     sym->setValue(old_value + 1);
+    m_stamp++;
     m_result = old_value;
 }
 
@@ -285,6 +670,7 @@ void EvaluatorVisitor::visitPostfixDecrement(postfix_decrement *node)
 
     Value old_value = sym->getValue();
     sym->setValue(old_value - 1);
+    m_stamp++;
     m_result = old_value;
 }
 
@@ -299,6 +685,7 @@ void EvaluatorVisitor::visitPrefixIncrement(prefix_increment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     sym->setValue(sym->getValue() + 1);
+    m_stamp++;
     m_result = sym->getValue();
 }
 
@@ -313,6 +700,7 @@ void EvaluatorVisitor::visitPrefixDecrement(prefix_decrement *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     sym->setValue(sym->getValue() - 1);
+    m_stamp++;
     m_result = sym->getValue();
 }
 
@@ -326,11 +714,9 @@ void EvaluatorVisitor::visitAssignment(assignment *node)
         dynamic_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
     sym->setValue(m_result);
-
-    // Debug print
-    std::cout << name << "=" << std::to_string(m_result) << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitPlusAssignment(plus_assignment *node)
@@ -343,11 +729,9 @@ void EvaluatorVisitor::visitPlusAssignment(plus_assignment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
     sym->setValue(sym->getValue() + m_result);
-
-    // Debug print
-    std::cout << name << "=" << sym->getValue() << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitMinusAssignment(minus_assignment *node)
@@ -360,11 +744,9 @@ void EvaluatorVisitor::visitMinusAssignment(minus_assignment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
     sym->setValue(sym->getValue() - m_result);
-
-    // Debug print
-    std::cout << name << "=" << sym->getValue() << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitMulAssignment(mul_assignment *node)
@@ -377,11 +759,9 @@ void EvaluatorVisitor::visitMulAssignment(mul_assignment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
     sym->setValue(sym->getValue() * m_result);
-
-    // Debug print
-    std::cout << name << "=" << sym->getValue() << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitDivAssignment(div_assignment *node)
@@ -394,16 +774,14 @@ void EvaluatorVisitor::visitDivAssignment(div_assignment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
     if (!m_result)
     {
         std::cerr << "Runtime Error: Cant divide with 0" << std::endl;
         exit(1);
     }
     sym->setValue(sym->getValue() / m_result);
-
-    // Debug print
-    std::cout << name << "=" << sym->getValue() << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitModAssignment(mod_assignment *node)
@@ -416,11 +794,14 @@ void EvaluatorVisitor::visitModAssignment(mod_assignment *node)
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
     it++;
-    (*it)->accept(*this);
+    evaluate(*it);
+    if (!m_result)
+    {
+        std::cerr << "Runtime Error: Cant divide with 0" << std::endl;
+        exit(1);
+    }
     sym->setValue(sym->getValue() % m_result);
-
-    // Debug print
-    std::cout << name << "=" << sym->getValue() << std::endl;
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitVariableDeclaration(variable_declaration *node)
@@ -431,7 +812,7 @@ void EvaluatorVisitor::visitVariableDeclaration(variable_declaration *node)
     if (temp.size() > 1)
     {
         it++;
-        (*it)->accept(*this);
+        evaluate(*it);
     }
 }
 
@@ -462,8 +843,13 @@ void EvaluatorVisitor::visitVariableDeclarationStatement(
 
     it++;
     (*it)->accept(*this);
-    for (auto &var : m_vars)
+
+    // Initializers may call functions that declare variables of their own
+    std::vector<STNode *> vars;
+    vars.swap(m_vars);
+    for (auto &var : vars)
     {
+        m_result = 0;
         var->accept(*this);
 
         // Need a way so i dont store the values into the AST.
@@ -474,24 +860,52 @@ void EvaluatorVisitor::visitVariableDeclarationStatement(
             currentType);
 
         SymbolTable::getInstance()->insert(sym);
+        m_stamp++;
     }
-
-    m_vars.clear();
 }
 
-void EvaluatorVisitor::visitStatement(statement *node)
+void EvaluatorVisitor::visitCompoundStatement(compound_statement *node)
 {
-    auto temp = node->getChildrenList().front();
+    // Function bodies use the scope the call opened
+    bool scoped = node->getParent()->getNodeType() != FUNCTION_DEFINITION_NODE;
 
-    if (temp)
+    if (scoped)
     {
-        temp->accept(*this);
+        SymbolTable::getInstance()->enterScope(
+            SymbolTable::getInstance()->getCurrentId());
+    }
+
+    // return, break and continue unwind through here as exceptions
+    try
+    {
+        visitChildren(node);
+    }
+    catch (...)
+    {
+        if (scoped)
+        {
+            SymbolTable::getInstance()->exitScope();
+            m_stamp++;
+        }
+        throw;
+    }
+
+    if (scoped)
+    {
+        SymbolTable::getInstance()->exitScope();
+        m_stamp++;
     }
 }
 
+void EvaluatorVisitor::visitStatement(statement *node)
+{
+    // Empty statement ";"
+    visitChildren(node);
+}
+
 void EvaluatorVisitor::visitCondition(condition *node)
 {
-    node->getChildrenList().front()->accept(*this);
+    evaluate(node->getChildrenList().front());
 }
 
 void EvaluatorVisitor::visitIfStatement(if_statement *node)
@@ -523,6 +937,7 @@ void EvaluatorVisitor::visitWhileStatement(while_statement *node)
     cond->accept(*this);
     while (m_result)
     {
+        countIteration(node);
         try
         {
             (*it)->accept(*this);
@@ -536,6 +951,7 @@ void EvaluatorVisitor::visitWhileStatement(while_statement *node)
             break;
         }
 
+        countBackEdge();
         cond->accept(*this);
     }
 }
@@ -549,18 +965,21 @@ void EvaluatorVisitor::visitDoWhileStatement(do_while_statement *node)
 
     do
     {
+        countIteration(node);
         try
         {
             body->accept(*this);
         }
         catch (continue_signal)
         {
-            continue;
+            // continue;
         }
         catch (break_signal)
         {
             break;
         }
+
+        countBackEdge();
         (*it)->accept(*this);
     } while (m_result);
 }
@@ -585,6 +1004,7 @@ void EvaluatorVisitor::visitForStatement(for_statement *node)
     cond->accept(*this);
     while (m_result)
     {
+        countIteration(node);
         try
         {
             (*it)->accept(*this); // the body
@@ -603,6 +1023,7 @@ void EvaluatorVisitor::visitForStatement(for_statement *node)
             inc->accept(*this);
         }
 
+        countBackEdge();
         cond->accept(*this);
     }
 }
@@ -622,7 +1043,19 @@ void EvaluatorVisitor::visitReturn(return_node *node)
     }
     else
     {
-        node->getChildrenList().front()->accept(*this);
+        STNode *expr = node->getChildrenList().front();
+
+        // Arguments are evaluated here, the call itself happens in invoke
+        // after this frame is gone
+        if (node->getTailCall() != NO_TAIL_CALL)
+        {
+            tail_call_signal signal;
+            signal.func =
+                evaluateCall(static_cast<function_call *>(expr), signal.args);
+            throw signal;
+        }
+
+        evaluate(expr);
         throw m_result;
     }
 }
@@ -647,23 +1080,219 @@ void EvaluatorVisitor::visitArgumentList(argument_list *node)
     }
 }
 
-void EvaluatorVisitor::visitFunctionCall(function_call *node)
+// Only reads and arithmetic, so evaluating it can't touch any state
+static bool isPureNode(STNode *node)
+{
+    switch (node->getNodeType())
+    {
+    case NUMBER_NODE:
+    case IDENTIFIER_NODE:
+    case EXPRESSION_NODE:
+    case UNARY_PLUS_NODE:
+    case UNARY_MINUS_NODE:
+    case MULTIPLICATION_NODE:
+    case DIVISION_NODE:
+    case ADDITION_NODE:
+    case SUBTRACTION_NODE:
+    case MOD_NODE:
+    case LESS_NODE:
+    case LESS_EQUALS_NODE:
+    case GREATER_NODE:
+    case GREATER_EQUALS_NODE:
+    case LOGIC_EQUALS_NODE:
+    case LOGIC_NOT_EQUALS_NODE:
+    case LOGIC_AND_NODE:
+    case LOGIC_OR_NODE:
+    case LOGIC_NOT_NODE:
+    case BIT_WISE_OR_NODE:
+    case BIT_WISE_AND_NODE:
+    case BIT_WISE_XOR_NODE:
+    case BIT_WISE_NOT_NODE:
+    case SHIFT_LEFT_NODE:
+    case SHIFT_RIGHT_NODE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isInlinableTree(STNode *node, size_t &nodes)
+{
+    if (!isPureNode(node) || ++nodes > g_inline_nodes)
+    {
+        return false;
+    }
+
+    for (auto &child : node->getChildrenList())
+    {
+        if (!isInlinableTree(child, nodes))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The body is compound_statement -> statement_list -> return_node when it
+// holds a single statement
+STNode *EvaluatorVisitor::inlineBody(FuncSymbol *func)
+{
+    auto found = m_inline_bodies.find(func);
+    if (found != m_inline_bodies.end())
+    {
+        return found->second;
+    }
+
+    STNode *expr = nullptr;
+    STNode *body = func->getFunctionBody();
+    if (body != nullptr && func->getReturnType() != T_VOID &&
+        body->getChildrenList().size() == 1)
+    {
+        STNode *list = body->getChildrenList().front();
+        STNode *ret = list->getChildrenList().size() == 1
+                          ? list->getChildrenList().front()
+                          : nullptr;
+
+        size_t nodes = 0;
+        if (ret != nullptr && ret->getNodeType() == RETURN_NODE &&
+            ret->getChildrenList().size() == 1 &&
+            isInlinableTree(ret->getChildrenList().front(), nodes))
+        {
+            expr = ret->getChildrenList().front();
+        }
+    }
+
+    m_inline_bodies[func] = expr;
+    return expr;
+}
+
+// Structural key of a subtree that only reads and computes, empty when it
+// writes or calls. Every operator subtree below node is added to subtrees,
+// children before their parents.
+static std::string valueKey(
+    STNode *node, std::vector<std::pair<STNode *, std::string>> &subtrees)
+{
+    switch (node->getNodeType())
+    {
+    case NUMBER_NODE:
+    {
+        // What the interpreter makes of it, floats are truncated
+        NUMBER *number = static_cast<NUMBER *>(node);
+        int value = number->getResolvedType() == T_FLOAT
+                        ? (int)number->getFValue()
+                        : number->getIValue();
+        return "n" + std::to_string(value);
+    }
+    case IDENTIFIER_NODE:
+        return "i" + static_cast<IDENTIFIER *>(node)->getLabel();
+    case EXPRESSION_NODE:
+        return valueKey(node->getChildrenList().front(), subtrees);
+    default:
+        break;
+    }
+
+    bool pure = isPureNode(node);
+    std::string key = "(" + std::to_string(node->getNodeType());
+    for (auto &child : node->getChildrenList())
+    {
+        std::string child_key = valueKey(child, subtrees);
+        pure = pure && !child_key.empty();
+        key += " " + child_key;
+    }
+
+    if (!pure)
+    {
+        return "";
+    }
+
+    key += ")";
+    subtrees.push_back({node, key});
+    return key;
+}
+
+void EvaluatorVisitor::numberValues(STNode *node)
+{
+    if (node->getNodeType() == FUNCTION_DEFINITION_NODE)
+    {
+        numberFunction(node);
+        return;
+    }
+
+    for (auto &child : node->getChildrenList())
+    {
+        numberValues(child);
+    }
+}
+
+// A subtree gets a number when it appears more than once, unless every
+// occurrence is inside a larger subtree that is reused as a whole
+void EvaluatorVisitor::numberFunction(STNode *function)
+{
+    std::vector<std::pair<STNode *, std::string>> subtrees;
+    valueKey(function, subtrees);
+
+    std::unordered_map<std::string, unsigned int> count;
+    std::unordered_map<STNode *, std::string *> keys;
+    for (auto &subtree : subtrees)
+    {
+        count[subtree.second]++;
+        keys[subtree.first] = &subtree.second;
+    }
+
+    std::unordered_map<std::string, int> numbers;
+    for (auto &subtree : subtrees)
+    {
+        unsigned int occurrences = count[subtree.second];
+        auto parent = keys.find(subtree.first->getParent());
+        if (occurrences < 2 ||
+            (parent != keys.end() && count[*parent->second] == occurrences))
+        {
+            continue;
+        }
+
+        auto number = numbers.find(subtree.second);
+        if (number == numbers.end())
+        {
+            number = numbers.insert({subtree.second, m_values.size()}).first;
+            m_values.push_back({0, 0});
+        }
+        subtree.first->setValueNumber(number->second);
+    }
+}
+
+void EvaluatorVisitor::evaluate(STNode *node)
+{
+    int number = node->getValueNumber();
+    if (number < 0 || (size_t)number >= m_values.size())
+    {
+        node->accept(*this);
+        return;
+    }
+
+    numbered_value &value = m_values[number];
+    if (value.stamp == m_stamp)
+    {
+        m_result = value.value;
+        return;
+    }
+
+    node->accept(*this);
+    value.value = m_result;
+    value.stamp = m_stamp;
+}
+
+FuncSymbol *EvaluatorVisitor::evaluateCall(function_call *node,
+                                           std::vector<Value> &values)
 {
-    std::vector<Value> finalValues;
     auto childs = node->getChildrenList();
 
     auto it = childs.begin();
     std::string func_name = (static_cast<IDENTIFIER *>(*it))->getLabel();
 
-    // Debugging print
-    // std::cout << func_name << std::endl;
-
     FuncSymbol *def = dynamic_cast<FuncSymbol *>(
         SymbolTable::getInstance()->lookupGlobal(func_name));
 
-    compound_statement *func_body =
-        static_cast<compound_statement *>(def->getFunctionBody());
-
     if (childs.size() == 1) // No arguments
     {
     }
@@ -672,45 +1301,158 @@ void EvaluatorVisitor::visitFunctionCall(function_call *node)
         it++;
         (*it)->accept(*this);
 
-        for (auto &expr : m_args)
+        // Arguments may contain calls of their own that reuse m_args
+        std::vector<STNode *> args;
+        args.swap(m_args);
+
+        for (auto &expr : args)
         {
-            expr->accept(*this);
-            finalValues.push_back(m_result);
+            evaluate(expr);
+            values.push_back(m_result);
         }
-
-        m_args.clear();
     }
 
-    // Calculating the arguments of the function call
-    std::vector<parameter> &func_params = def->getParameters();
+    return def;
+}
+
+void EvaluatorVisitor::invoke(FuncSymbol *def, std::vector<Value> &values)
+{
+    bool memoize = m_memo != nullptr && m_memoizable.count(def);
+    if (memoize && m_memo->lookup(def, values, m_result))
+    {
+        return;
+    }
 
-    SymbolTable::getInstance()->enterScope(
-        SymbolTable::getInstance()->getCurrentId() + 1);
+    FuncSymbol *func = def;
+    std::vector<Value> args = values;
 
-    for (size_t i = 0; i < func_params.size(); i++)
+    // A tail call comes back here with the callee and its arguments, so it
+    // reuses this C++ frame instead of nesting a new one
+    while (true)
     {
-        VarSymbol *param = new VarSymbol(finalValues[i], func_params[i].name,
-                                         func_params[i].type);
+#if defined(__x86_64__)
+        if (m_tier_threshold && !m_compiled.count(func) &&
+            ++m_hotness[func] >= m_tier_threshold &&
+            func->getParameters().size() <= g_max_compiled_args &&
+            isCompilable(func))
+        {
+            promote(func);
+        }
+
+        auto compiled = m_compiled.find(func);
+        if (compiled != m_compiled.end())
+        {
+            // Compiled calls count down what is left of the depth limit
+            JitCompilerVisitor::setCallBudget(m_max_call_depth -
+                                              m_call_stack.size());
+            m_result = callCompiled(compiled->second, args);
+            if (func->getReturnType() == T_VOID)
+            {
+                m_result = 0;
+            }
+            break;
+        }
+#endif
+
+        std::vector<parameter> &func_params = func->getParameters();
+        if (m_call_stack.size() >= m_max_call_depth)
+        {
+            std::cerr << "Runtime Error: Maximum call depth of "
+                      << m_max_call_depth << " exceeded calling \""
+                      << func->getName() << "\"" << std::endl;
+            exit(1);
+        }
+        if (NativeStack::exhausted(m_stack_reserve))
+        {
+            std::cerr << "Runtime Error: Out of stack space at call depth "
+                      << m_call_stack.size() << " calling \""
+                      << func->getName() << "\"" << std::endl;
+            exit(1);
+        }
+        m_call_stack.push_back({func});
+        if (m_profiler != nullptr && m_profiler->due())
+        {
+            sampleStack();
+        }
+
+        SymbolTable::getInstance()->enterScope(
+            SymbolTable::getInstance()->getCurrentId() + 1);
+
+        for (size_t i = 0; i < func_params.size(); i++)
+        {
+            VarSymbol *param =
+                new VarSymbol(args[i], func_params[i].name, func_params[i].type);
 
-        SymbolTable::getInstance()->insert(param);
+            SymbolTable::getInstance()->insert(param);
+        }
+
+        bool tail = false;
+        try
+        {
+            func->getFunctionBody()->accept(*this);
+            m_result = 0;
+        }
+        catch (Value return_value)
+        {
+            m_result = return_value;
+        }
+        catch (void_return_signal)
+        {
+            m_result = 0;
+        }
+        catch (tail_call_signal &signal)
+        {
+            func = signal.func;
+            args.swap(signal.args);
+            tail = true;
+        }
+
+        SymbolTable::getInstance()->exitScope();
+        m_call_stack.pop_back();
+
+        if (!tail)
+        {
+            break;
+        }
+        m_stamp++;
+
+        if (m_memo != nullptr && m_memoizable.count(func) &&
+            m_memo->lookup(func, args, m_result))
+        {
+            break;
+        }
     }
 
-    try
+    if (memoize)
     {
-        func_body->accept(*this);
+        m_memo->store(def, values, m_result);
     }
-    catch (Value return_value)
+}
+
+void EvaluatorVisitor::visitFunctionCall(function_call *node)
+{
+    std::vector<Value> values;
+    FuncSymbol *def = evaluateCall(node, values);
+
+    // The callee's numbered values are its own, and it may write globals
+    m_stamp++;
+
+    // Profiles keep every call on the shadow stack
+    STNode *inlined = m_profiler == nullptr ? inlineBody(def) : nullptr;
+    if (inlined != nullptr)
     {
-        SymbolTable::getInstance()->exitScope();
+        m_inline_func = def;
+        m_inline_args = &values;
+        evaluate(inlined);
+        m_inline_func = nullptr;
+        m_inline_args = nullptr;
     }
-    catch (void_return_signal)
+    else
     {
-        SymbolTable::getInstance()->exitScope();
-
-        m_result = 0;
+        invoke(def, values);
     }
 
-    SymbolTable::getInstance()->exitScope();
+    m_stamp++;
 }
 
 void EvaluatorVisitor::visitProgram(program *node)
@@ -723,8 +1465,6 @@ void EvaluatorVisitor::visitProgram(program *node)
                   << std::endl;
         exit(1);
     }
-    // When i will make scopes for every compound statement this will leave
-    // Because function_body is always a compound statement
 
     // if (!entry->getParameters().empty())
     // {
@@ -733,24 +1473,18 @@ void EvaluatorVisitor::visitProgram(program *node)
     //     exit(1);
     // }
 
-    SymbolTable::getInstance()->enterScope(
-        SymbolTable::getInstance()->getCurrentId() + 1);
-    try
+    m_program = node;
+    numberValues(node);
+
+    std::vector<Value> no_args;
+    invoke(entry, no_args);
+
+    if (!m_result)
     {
-        entry->getFunctionBody()->accept(*this);
+        std::cout << "Super!" << std::endl;
     }
-    catch (Value main_return)
+    else
     {
-        SymbolTable::getInstance()->exitScope();
-        if (!main_return)
-        {
-            std::cout << "Super!" << std::endl;
-        }
-        else
-        {
-            std::cout << "Not Super" << std::endl;
-        }
+        std::cout << "Not Super" << std::endl;
     }
-
-    SymbolTable::getInstance()->exitScope();
 }
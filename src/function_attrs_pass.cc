@@ -0,0 +1,120 @@
+#include "../lib/function_attrs_pass.hh"
+#include <algorithm>
+#include <unordered_set>
+
+std::string FunctionAttrsPass::getName() { return "function-attrs"; }
+
+// Whether a chain of calls leads from one function to another
+bool FunctionAttrsPass::reaches(std::string from, std::string to)
+{
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> work = {from};
+
+    while (!work.empty())
+    {
+        std::string name = work.back();
+        work.pop_back();
+
+        for (auto &callee : m_summaries[name].callees)
+        {
+            // A function not summarized yet may call anything
+            if (callee == to || !m_summaries.count(callee))
+            {
+                return true;
+            }
+            if (seen.insert(callee).second)
+            {
+                work.push_back(callee);
+            }
+        }
+    }
+
+    return false;
+}
+
+bool FunctionAttrsPass::run(IRModule &module)
+{
+    // Globals are the only memory, loads and stores touch nothing else
+    for (auto &function : module.getFunctions())
+    {
+        summary &sum = m_summaries[function->name];
+        sum = summary();
+        for (auto &block : function->blocks)
+        {
+            for (auto &instr : block->instructions)
+            {
+                if (instr.op == OP_LOAD)
+                {
+                    sum.reads = true;
+                }
+                else if (instr.op == OP_STORE)
+                {
+                    sum.writes = true;
+                }
+                else if (instr.op == OP_CALL)
+                {
+                    sum.callees.push_back(instr.callee);
+                }
+            }
+        }
+    }
+
+    // A call does whatever its callee does, and a callee without a summary
+    // may do anything. Functions summarized in earlier runs are final.
+    bool grew = true;
+    while (grew)
+    {
+        grew = false;
+        for (auto &function : module.getFunctions())
+        {
+            summary &sum = m_summaries[function->name];
+            for (auto &callee : sum.callees)
+            {
+                auto called = m_summaries.find(callee);
+                bool reads = called == m_summaries.end() || called->second.reads;
+                bool writes =
+                    called == m_summaries.end() || called->second.writes;
+                if ((reads && !sum.reads) || (writes && !sum.writes))
+                {
+                    sum.reads = sum.reads || reads;
+                    sum.writes = sum.writes || writes;
+                    grew = true;
+                }
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto &function : module.getFunctions())
+    {
+        summary &sum = m_summaries[function->name];
+
+        // MINIC has no exceptions
+        std::vector<std::string> attributes = {"nounwind"};
+        if (!sum.reads && !sum.writes)
+        {
+            attributes.push_back("readnone");
+        }
+        else if (!sum.writes)
+        {
+            attributes.push_back("readonly");
+        }
+        if (!reaches(function->name, function->name))
+        {
+            attributes.push_back("norecurse");
+        }
+
+        for (auto &attribute : attributes)
+        {
+            auto &present = function->attributes;
+            if (std::find(present.begin(), present.end(), attribute) ==
+                present.end())
+            {
+                present.push_back(attribute);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
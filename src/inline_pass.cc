@@ -0,0 +1,309 @@
+#include "../lib/inline_pass.hh"
+#include <algorithm>
+#include <vector>
+
+// Callees up to this many instructions are inlined, into callers up to the
+// other limit
+static const size_t g_inline_threshold = 40;
+static const size_t g_max_caller_size = 4000;
+
+InlinePass::InlinePass() { m_inline_count = 0; }
+
+std::string InlinePass::getName() { return "inline"; }
+
+size_t InlinePass::size(ir_function &function)
+{
+    size_t count = 0;
+    for (auto &block : function.blocks)
+    {
+        count += block->instructions.size();
+    }
+
+    return count;
+}
+
+static std::vector<std::string> callees(ir_function &function)
+{
+    std::vector<std::string> names;
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            if (instr.op == OP_CALL)
+            {
+                names.push_back(instr.callee);
+            }
+        }
+    }
+
+    return names;
+}
+
+// Every function from which a chain of calls leads back to itself
+void InlinePass::findRecursive(IRModule &module)
+{
+    std::unordered_map<std::string, std::vector<std::string>> calls;
+    for (auto &function : module.getFunctions())
+    {
+        calls[function->name] = callees(*function);
+    }
+
+    for (auto &function : module.getFunctions())
+    {
+        std::unordered_set<std::string> seen;
+        std::vector<std::string> work = calls[function->name];
+
+        while (!work.empty())
+        {
+            std::string name = work.back();
+            work.pop_back();
+
+            if (name == function->name)
+            {
+                m_recursive.insert(name);
+                break;
+            }
+            if (seen.insert(name).second)
+            {
+                work.insert(work.end(), calls[name].begin(), calls[name].end());
+            }
+        }
+    }
+}
+
+// Splits the caller's block after the call, copies the callee's blocks in
+// between with fresh registers and turns every ret into a br to the rest of
+// the block. Several returns meet in a phi.
+void InlinePass::inlineCall(ir_function &caller, size_t block, size_t index,
+                            ir_function &callee)
+{
+    std::string prefix = "inline_" + std::to_string(m_inline_count++) + "_";
+
+    ir_block *head = caller.blocks[block].get();
+    ir_instruction call = head->instructions[index];
+
+    std::unique_ptr<ir_block> rest(new ir_block());
+    rest->label = prefix + "end";
+    rest->instructions.assign(head->instructions.begin() + index + 1,
+                              head->instructions.end());
+    head->instructions.resize(index);
+
+    // The successors now come from rest
+    ir_instruction &last = rest->instructions.back();
+    if (last.op == OP_BR || last.op == OP_COND_BR)
+    {
+        for (ir_block *succ : last.targets)
+        {
+            for (auto &instr : succ->instructions)
+            {
+                if (instr.op == OP_PHI)
+                {
+                    std::replace(instr.targets.begin(), instr.targets.end(),
+                                 head, rest.get());
+                }
+            }
+        }
+    }
+
+    std::unordered_map<int, ir_value> values;
+    for (size_t i = 0; i < callee.params.size(); i++)
+    {
+        values[callee.params[i].reg] = call.operands[i];
+    }
+
+    std::unordered_map<ir_block *, ir_block *> copies;
+    std::vector<std::unique_ptr<ir_block>> body;
+    for (auto &original : callee.blocks)
+    {
+        body.emplace_back(new ir_block(*original));
+        body.back()->label = prefix + original->label;
+        copies[original.get()] = body.back().get();
+
+        for (auto &instr : original->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                values[instr.result.reg] = caller.newReg(
+                    instr.result.type, callee.reg_names[instr.result.reg]);
+            }
+        }
+    }
+
+    ir_instruction phi;
+    phi.op = OP_PHI;
+
+    for (auto &copy : body)
+    {
+        for (auto &instr : copy->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                instr.result = values[instr.result.reg];
+            }
+            for (auto &operand : instr.operands)
+            {
+                if (operand.kind == VAL_REG)
+                {
+                    operand = values[operand.reg];
+                }
+            }
+            for (auto &target : instr.targets)
+            {
+                target = copies[target];
+            }
+
+            // The callee's frame is gone, a musttail call no longer sits
+            // right before the caller's ret
+            if (instr.tail == MUST_TAIL_CALL)
+            {
+                instr.tail = TAIL_CALL;
+            }
+
+            if (instr.op == OP_RET)
+            {
+                if (!instr.operands.empty())
+                {
+                    phi.operands.push_back(instr.operands[0]);
+                    phi.targets.push_back(copy.get());
+                }
+                instr.op = OP_BR;
+                instr.operands.clear();
+                instr.targets = {rest.get()};
+            }
+        }
+    }
+
+    ir_instruction branch;
+    branch.op = OP_BR;
+    branch.targets = {body.front().get()};
+    head->instructions.push_back(branch);
+
+    ir_block *tail = rest.get();
+    body.push_back(std::move(rest));
+    caller.blocks.insert(caller.blocks.begin() + block + 1,
+                         std::make_move_iterator(body.begin()),
+                         std::make_move_iterator(body.end()));
+
+    // rest is part of the caller now, so replacing the call's uses
+    // reaches it too
+    if (call.result.kind == VAL_REG)
+    {
+        if (phi.operands.size() == 1)
+        {
+            caller.replaceUses(call.result.reg, phi.operands[0]);
+        }
+        else if (phi.operands.empty())
+        {
+            // Never returns, the value can't be used
+            caller.replaceUses(call.result.reg,
+                               call.result.type == IR_FLOAT
+                                   ? irFloat(0.0)
+                                   : irInt(0, call.result.type));
+        }
+        else
+        {
+            phi.result = call.result;
+            tail->instructions.insert(tail->instructions.begin(), phi);
+        }
+    }
+}
+
+bool InlinePass::inlineCalls(ir_function &function)
+{
+    bool changed = false;
+    size_t caller_size = size(function);
+
+    for (size_t b = 0; b < function.blocks.size(); b++)
+    {
+        auto &instrs = function.blocks[b]->instructions;
+        for (size_t i = 0; i < instrs.size(); i++)
+        {
+            if (instrs[i].op != OP_CALL)
+            {
+                continue;
+            }
+
+            auto found = m_functions.find(instrs[i].callee);
+            if (found == m_functions.end() || found->second == &function ||
+                m_recursive.count(instrs[i].callee))
+            {
+                continue;
+            }
+
+            ir_function &callee = *found->second;
+            size_t callee_size = size(callee);
+            if (callee_size > g_inline_threshold ||
+                caller_size + callee_size > g_max_caller_size)
+            {
+                continue;
+            }
+
+            // The rest of this block moved behind the copied body, the scan
+            // goes on there
+            inlineCall(function, b, i, callee);
+            caller_size += callee_size;
+            changed = true;
+            break;
+        }
+    }
+
+    return changed;
+}
+
+bool InlinePass::run(IRModule &module)
+{
+    m_functions.clear();
+    m_recursive.clear();
+
+    for (auto &function : module.getFunctions())
+    {
+        m_functions[function->name] = function.get();
+    }
+    findRecursive(module);
+
+    // Callees first, a postorder of the call graph
+    struct frame
+    {
+        ir_function *function;
+        std::vector<std::string> callees;
+        size_t next;
+    };
+
+    std::vector<ir_function *> order;
+    std::unordered_set<std::string> visited;
+    for (auto &root : module.getFunctions())
+    {
+        std::vector<frame> stack;
+        if (visited.insert(root->name).second)
+        {
+            stack.push_back({root.get(), callees(*root), 0});
+        }
+
+        while (!stack.empty())
+        {
+            frame &top = stack.back();
+            if (top.next < top.callees.size())
+            {
+                auto found = m_functions.find(top.callees[top.next++]);
+                if (found != m_functions.end() &&
+                    visited.insert(found->first).second)
+                {
+                    stack.push_back(
+                        {found->second, callees(*found->second), 0});
+                }
+                continue;
+            }
+
+            order.push_back(top.function);
+            stack.pop_back();
+        }
+    }
+
+    bool changed = false;
+    for (ir_function *function : order)
+    {
+        changed = inlineCalls(*function) || changed;
+    }
+
+    return changed;
+}
@@ -1,775 +1,1000 @@
 #include "../lib/ir_emitter_visitor.hh"
-#include <fstream>
+#include "../lib/task_pool.hh"
+#include <memory>
 #include <string>
+#include <unordered_set>
+
+// Deeply nested bodies recurse deeply in the visitor
+static const size_t g_emit_stack_size = 64 * 1024 * 1024;
 
 IREmitterVisitor::IREmitterVisitor()
 {
-    m_reg_count = 0;
     m_label_count = 0;
-    m_var_count = 0;
-    m_file_ll.open("out/ir.ll");
-    m_ll = &m_file_ll;
+    m_function = nullptr;
+    m_return_type = T_VOID;
+    m_precomputed = false;
+    m_precomputed_result = 0;
+    m_fast_math = false;
+    m_threads = 1;
+    m_init_calls = false;
+    m_current_block = 0;
     SymbolTable::getInstance()->enterScope(
         SymbolTable::getInstance()->getCurrentId());
 }
 
 IREmitterVisitor::~IREmitterVisitor()
 {
-    m_file_ll.close();
-
     SymbolTable::getInstance()->exitScope();
 }
 
-std::string IREmitterVisitor::getNextReg()
+IRModule &IREmitterVisitor::getModule() { return m_module; }
+
+void IREmitterVisitor::setPrecomputedResult(int result)
+{
+    m_precomputed = true;
+    m_precomputed_result = result;
+}
+
+void IREmitterVisitor::setFastMath(bool fast_math) { m_fast_math = fast_math; }
+
+void IREmitterVisitor::setThreads(size_t threads) { m_threads = threads; }
+
+void IREmitterVisitor::setPrecomputedGlobal(std::string name, int value)
+{
+    m_module.addGlobal(name, IR_I32, irInt(value));
+}
+
+void IREmitterVisitor::setPrecomputedGlobal(std::string name, float value)
 {
-    return "%" + std::to_string(m_reg_count++);
+    m_module.addGlobal(name, IR_FLOAT, irFloat(value));
+}
+
+// Appends an instruction to the current block, returns its result register
+ir_value IREmitterVisitor::emit(irOpcode op, irType type,
+                                std::vector<ir_value> operands,
+                                std::string predicate)
+{
+    ir_instruction instr;
+    instr.op = op;
+    instr.operands = operands;
+    instr.predicate = predicate;
+
+    // Signed overflow is undefined in C
+    instr.nsw = (op == OP_ADD || op == OP_SUB || op == OP_MUL);
+    instr.fast = m_fast_math && (op == OP_FADD || op == OP_FSUB ||
+                                 op == OP_FMUL || op == OP_FDIV ||
+                                 op == OP_FCMP);
+
+    if (type != IR_VOID)
+    {
+        instr.result = m_function->newReg(type);
+    }
+
+    m_blocks[m_current_block].block->instructions.push_back(instr);
+    return instr.result;
+}
+
+// Int <-> float conversion, constants are converted right away
+ir_value IREmitterVisitor::convert(irOpcode op, irType type, ir_value value)
+{
+    if (op == OP_SITOFP && value.kind == VAL_INT)
+    {
+        return irFloat(static_cast<float>(value.ivalue));
+    }
+    if (op == OP_FPTOSI && value.kind == VAL_FLOAT && value.fvalue > -2147483649.0 &&
+        value.fvalue < 2147483648.0)
+    {
+        return irInt(static_cast<int>(value.fvalue));
+    }
+
+    return emit(op, type, {value});
 }
 
 // Helper: Handles Binary Operation Promotions (Int <-> Float)
 void IREmitterVisitor::binaryTypeTransition(dataType &type1, dataType &type2,
-                                            std::string &reg1,
-                                            std::string &reg2)
+                                            ir_value &value1, ir_value &value2)
 {
     if (type1 == T_FLOAT && type2 == T_INT)
     {
-        std::string cast_reg = getNextReg();
-        *m_ll << "\t" << cast_reg << " = sitofp i32 " << reg2 << " to float\n";
-        reg2 = cast_reg;
+        value2 = convert(OP_SITOFP, IR_FLOAT, value2);
         type2 = T_FLOAT;
     }
     else if (type1 == T_INT && type2 == T_FLOAT)
     {
-        std::string cast_reg = getNextReg();
-        *m_ll << "\t" << cast_reg << " = sitofp i32 " << reg1 << " to float\n";
-        reg1 = cast_reg;
+        value1 = convert(OP_SITOFP, IR_FLOAT, value1);
         type1 = T_FLOAT;
     }
 }
 
 // Helper: Handles Assignment Coercion (LHS type != RHS type)
-// Note: This modifies m_last_reg directly to point to the new casted value
+// Note: This modifies m_last_value directly to point to the new casted value
 void IREmitterVisitor::assignmentTypeTransition(dataType lhsType,
                                                 dataType &rhsType)
 {
     if (lhsType == T_FLOAT && rhsType == T_INT)
     {
-        std::string cast_reg = getNextReg();
-        *m_ll << "\t" << cast_reg << " = sitofp i32 " << m_last_reg
-              << " to float\n";
-        m_last_reg = cast_reg;
+        m_last_value = convert(OP_SITOFP, IR_FLOAT, m_last_value);
         rhsType = T_FLOAT;
     }
     else if (lhsType == T_INT && rhsType == T_FLOAT)
     {
-        std::string cast_reg = getNextReg();
-        *m_ll << "\t" << cast_reg << " = fptosi float " << m_last_reg
-              << " to i32\n";
-        m_last_reg = cast_reg;
+        m_last_value = convert(OP_FPTOSI, IR_I32, m_last_value);
         rhsType = T_INT;
     }
 }
 
-void IREmitterVisitor::toInteger(dataType &type, std::string &reg)
+void IREmitterVisitor::toInteger(dataType &type, ir_value &value)
 {
     if (type == T_FLOAT)
     {
-        std::string cur_reg = getNextReg();
-        *m_ll << "\t" << cur_reg << " = fptosi float " << reg << " to i32\n";
-        reg = cur_reg;
+        value = convert(OP_FPTOSI, IR_I32, value);
         type = T_INT;
     }
 }
 
-std::string IREmitterVisitor::operandType(dataType type)
+ir_value IREmitterVisitor::boolConvertor(dataType type, ir_value value)
 {
-    if (type == T_INT)
-    {
-        return ""; // "add"
-    }
-    else // if (type == T_FLOAT)
+    if (type == T_FLOAT)
     {
-        return "f"; // "fadd"
+        // NaN is true in C, so unordered counts as not equal
+        return emit(OP_FCMP, IR_I1, {value, getZero(T_FLOAT)}, "une");
     }
+
+    return emit(OP_ICMP, IR_I1, {value, getZero(T_INT)}, "ne");
+}
+
+ir_value IREmitterVisitor::getOne(dataType type)
+{
+    return (type == T_FLOAT) ? irFloat(1.0) : irInt(1);
 }
 
-std::string IREmitterVisitor::compareType(dataType type)
+ir_value IREmitterVisitor::getZero(dataType type)
 {
-    if (type == T_INT)
+    return (type == T_FLOAT) ? irFloat(0.0) : irInt(0);
+}
+
+static bool containsCall(STNode *node)
+{
+    if (node->getNodeType() == FUNCTION_CALL_NODE)
     {
-        return "icmp"; // "icmp"
+        return true;
     }
-    else // if (type == T_FLOAT)
+
+    for (STNode *child : node->getChildrenList())
     {
-        return "fcmp"; // "fcmp"
+        if (containsCall(child))
+        {
+            return true;
+        }
     }
+
+    return false;
 }
 
-std::string IREmitterVisitor::comparatorType(dataType type)
+// Once folded a constant initializer is a single literal, it becomes the
+// global's initial value. A float out of the int range is left to run time.
+bool IREmitterVisitor::constantInitializer(STNode *var, dataType type,
+                                           ir_value &value)
 {
-    if (type == T_INT)
+    if (var->getChildrenList().size() < 2)
     {
-        return ""; // "eq"
+        value = getZero(type);
+        return true;
     }
-    else // if (type == T_FLOAT)
+
+    STNode *init = var->getChildrenList().back();
+    while (init->getNodeType() == EXPRESSION_NODE)
     {
-        return "o"; // "oeq"
+        init = init->getChildrenList().front();
     }
+    if (init->getNodeType() != NUMBER_NODE)
+    {
+        return false;
+    }
+
+    init->accept(*this);
+    dataType init_type = init->getResolvedType();
+    if (type == T_INT && init_type == T_FLOAT &&
+        !(m_last_value.fvalue > -2147483649.0 &&
+          m_last_value.fvalue < 2147483648.0))
+    {
+        return false;
+    }
+
+    assignmentTypeTransition(type, init_type);
+    value = m_last_value;
+    return true;
 }
 
-std::string IREmitterVisitor::typeToString(dataType type)
+// --- SSA construction ---
+
+size_t IREmitterVisitor::blockNamed(std::string label)
 {
-    switch (type)
+    auto found = m_block_ids.find(label);
+    if (found != m_block_ids.end())
     {
-    case T_VOID:
-        return "void";
-    case T_INT:
-        return "i32";
-    case T_FLOAT:
-        return "float";
-    default:
-        return "void";
+        return found->second;
     }
+
+    m_blocks.emplace_back();
+    m_blocks.back().block.reset(new ir_block());
+    m_blocks.back().block->label = label;
+    m_block_ids[label] = m_blocks.size() - 1;
+    return m_blocks.size() - 1;
 }
 
-std::string IREmitterVisitor::boolConvertor(dataType type, std::string reg)
+// Makes label the block new instructions go to. Falling into it from an
+// unterminated block adds the branch C leaves implicit.
+void IREmitterVisitor::startBlock(std::string label)
 {
-    std::string cur_reg = getNextReg();
-    if (type == T_INT)
+    ssa_block &current = m_blocks[m_current_block];
+    if (current.dead && current.block->instructions.empty())
     {
-        *m_ll << "\t" << cur_reg << " = icmp ne i32 " << reg << ", 0\n";
+        m_block_order.pop_back();
     }
-    else if (type == T_FLOAT)
+    else if (!current.terminated)
     {
-        *m_ll << "\t" << cur_reg << " = fcmp one float " << reg
-              << ", 0.0e+00\n";
+        branch(label);
+        m_block_order.pop_back();
     }
 
-    return cur_reg;
+    m_current_block = blockNamed(label);
+    m_block_order.push_back(m_current_block);
 }
 
-std::string IREmitterVisitor::getOne(dataType type)
+// No more predecessors will be added, phis waiting on them can be finished
+void IREmitterVisitor::sealBlock(std::string label)
 {
-    if (type == T_INT)
+    size_t id = blockNamed(label);
+
+    for (auto phi : m_blocks[id].incomplete_phis)
     {
-        return "1";
+        addPhiOperands(phi);
     }
-    else if (type == T_FLOAT)
+    m_blocks[id].incomplete_phis.clear();
+    m_blocks[id].sealed = true;
+}
+
+void IREmitterVisitor::branch(std::string label)
+{
+    if (leaveDeadBlock())
     {
-        return "1.0e+00";
+        return;
     }
 
-    return "";
+    size_t target = blockNamed(label);
+    emit(OP_BR, IR_VOID, {});
+    m_blocks[m_current_block].block->instructions.back().targets = {
+        m_blocks[target].block.get()};
+    m_blocks[target].preds.push_back(m_current_block);
+    terminate();
 }
 
-// --- VISITORS ---
-
-void IREmitterVisitor::visitIDENTIFIER(IDENTIFIER *node)
+void IREmitterVisitor::condBranch(ir_value cond, std::string label_true,
+                                  std::string label_false)
 {
-    std::string name = node->getLabel();
-    VarSymbol *sym =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-
-    std::string cur_reg = getNextReg();
-    std::string type_str = typeToString(sym->getValueType());
-
-    *m_ll << "\t" << cur_reg << " = load " << type_str << ", " << type_str
-          << "* " << sym->getAddress() << "\n";
+    if (leaveDeadBlock())
+    {
+        return;
+    }
 
-    m_last_reg = cur_reg;
+    size_t target_true = blockNamed(label_true);
+    size_t target_false = blockNamed(label_false);
+    emit(OP_COND_BR, IR_VOID, {cond});
+    m_blocks[m_current_block].block->instructions.back().targets = {
+        m_blocks[target_true].block.get(), m_blocks[target_false].block.get()};
+    m_blocks[target_true].preds.push_back(m_current_block);
+    m_blocks[target_false].preds.push_back(m_current_block);
+    terminate();
 }
 
-void IREmitterVisitor::visitNUMBER(NUMBER *node)
+// Nothing reaches a dead block, so its edges must not feed any phi
+bool IREmitterVisitor::leaveDeadBlock()
 {
-    if (node->getResolvedType() == T_INT)
+    ssa_block &current = m_blocks[m_current_block];
+    if (!current.dead)
     {
-        m_last_reg = std::to_string(node->getIValue());
+        return false;
     }
-    else if (node->getResolvedType() == T_FLOAT)
+
+    if (!current.block->instructions.empty())
     {
-        std::string temp = getNextReg();
-        *m_ll << "\t" << temp + " = fptrunc double "
-              << std::to_string(node->getFValue()) << " to float\n";
-        m_last_reg = temp;
+        emit(OP_UNREACHABLE, IR_VOID, {});
+        terminate();
     }
+    return true;
 }
 
-void IREmitterVisitor::visitAddition(addition *node)
+// Code after a terminator (after return, break, ...) still needs a block
+void IREmitterVisitor::terminate()
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    m_blocks[m_current_block].terminated = true;
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    m_current_block = blockNamed("dead_" + std::to_string(m_label_count++));
+    m_block_order.push_back(m_current_block);
+    m_blocks[m_current_block].sealed = true;
+    m_blocks[m_current_block].dead = true;
+}
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+int IREmitterVisitor::newVariable(std::string name, dataType type)
+{
+    m_var_names.push_back(name);
+    m_var_types.push_back(type);
+    return m_var_names.size() - 1;
+}
 
-    dataType cur_type = node->getResolvedType();
-    std::string op = operandType(cur_type) + "add";
+void IREmitterVisitor::writeVariable(int var, size_t block, ir_value value)
+{
+    m_blocks[block].defs[var] = value;
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << op << " " << typeToString(cur_type)
-          << " " << left_reg << ", " << right_reg << "\n";
+ir_value IREmitterVisitor::readVariable(int var, size_t block)
+{
+    auto found = m_blocks[block].defs.find(var);
+    if (found != m_blocks[block].defs.end())
+    {
+        return found->second;
+    }
 
-    m_last_reg = cur_reg;
+    return readVariableRecursive(var, block);
 }
 
-void IREmitterVisitor::visitSubtraction(subtraction *node)
+ir_value IREmitterVisitor::readVariableRecursive(int var, size_t block)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    ir_value value;
+    irType type = toIRType(m_var_types[var]);
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    if (!m_blocks[block].sealed)
+    {
+        // Not all predecessors are known yet, the operands come at sealing
+        m_phis.push_back(
+            {m_function->newReg(type, m_var_names[var]), block, var, {}});
+        m_blocks[block].incomplete_phis.push_back(m_phis.size() - 1);
+        value = m_phis.back().result;
+    }
+    else if (m_blocks[block].preds.empty())
+    {
+        // Entry or unreachable code, locals read before any store are 0
+        value = getZero(m_var_types[var]);
+    }
+    else if (m_blocks[block].preds.size() == 1)
+    {
+        // Every block on a chain of single predecessors sees the same value.
+        // A loop in dead code can make the chain a cycle that nothing
+        // enters, its locals are 0 like other unreachable code.
+        std::vector<size_t> chain = {block};
+        std::unordered_set<size_t> seen = {block};
+        size_t pred = m_blocks[block].preds.front();
+        bool cycle = false;
+
+        while (!m_blocks[pred].defs.count(var) && m_blocks[pred].sealed &&
+               m_blocks[pred].preds.size() == 1)
+        {
+            if (!seen.insert(pred).second)
+            {
+                cycle = true;
+                break;
+            }
+            chain.push_back(pred);
+            pred = m_blocks[pred].preds.front();
+        }
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+        value = cycle ? getZero(m_var_types[var]) : readVariable(var, pred);
+        for (size_t link : chain)
+        {
+            writeVariable(var, link, value);
+        }
+    }
+    else
+    {
+        // The phi is defined first so loops reading through it terminate
+        m_phis.push_back(
+            {m_function->newReg(type, m_var_names[var]), block, var, {}});
+        size_t phi = m_phis.size() - 1;
+        value = m_phis[phi].result;
+        writeVariable(var, block, value);
+        addPhiOperands(phi);
+    }
 
-    dataType cur_type = node->getResolvedType();
-    std::string op = operandType(cur_type) + "sub";
+    writeVariable(var, block, value);
+    return value;
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << op << " " << typeToString(cur_type)
-          << " " << left_reg << ", " << right_reg << "\n";
+void IREmitterVisitor::addPhiOperands(size_t phi)
+{
+    size_t block = m_phis[phi].block;
+    int var = m_phis[phi].var;
 
-    m_last_reg = cur_reg;
+    // m_phis can grow while the operands are read
+    std::vector<ir_value> operands;
+    for (auto pred : m_blocks[block].preds)
+    {
+        operands.push_back(readVariable(var, pred));
+    }
+    m_phis[phi].operands = operands;
 }
 
-void IREmitterVisitor::visitMultiplication(multiplication *node)
+ir_value IREmitterVisitor::replacement(ir_value value)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    while (value.kind == VAL_REG && m_replaced.count(value.reg))
+    {
+        value = m_replaced[value.reg];
+    }
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    return value;
+}
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+// A phi whose operands are all one value (or itself) is that value
+void IREmitterVisitor::removeTrivialPhis()
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
 
-    dataType cur_type = node->getResolvedType();
-    std::string op = operandType(cur_type) + "mul";
+        for (auto &phi : m_phis)
+        {
+            if (m_replaced.count(phi.result.reg))
+            {
+                continue;
+            }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << op << " " << typeToString(cur_type)
-          << " " << left_reg << ", " << right_reg << "\n";
+            ir_value same;
+            bool trivial = true;
+            for (auto &operand : phi.operands)
+            {
+                ir_value value = replacement(operand);
+                if (value == phi.result || value == same)
+                {
+                    continue;
+                }
+                if (same.kind != VAL_NONE)
+                {
+                    trivial = false;
+                    break;
+                }
+                same = value;
+            }
 
-    m_last_reg = cur_reg;
+            if (trivial)
+            {
+                m_replaced[phi.result.reg] =
+                    (same.kind == VAL_NONE) ? getZero(m_var_types[phi.var])
+                                            : same;
+                changed = true;
+            }
+        }
+    }
 }
 
-void IREmitterVisitor::visitDivision(division *node)
+// Labels are numbered per function, so a body comes out the same whichever
+// thread emits it
+void IREmitterVisitor::beginFunction(ir_function *function,
+                                     dataType return_type)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    m_function = function;
+    m_return_type = return_type;
+    m_label_count = 0;
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    m_current_block = blockNamed("entry");
+    m_block_order.push_back(m_current_block);
+    sealBlock("entry");
+}
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+// Adds the implicit return, then moves the blocks into the function with the
+// surviving phis at their heads and uses of removed phis rewritten
+void IREmitterVisitor::endFunction()
+{
+    // Falling off the end returns void, or 0 like C's main
+    ssa_block &last = m_blocks[m_current_block];
+    if (last.dead && last.block->instructions.empty())
+    {
+        m_block_order.pop_back();
+    }
+    else if (!last.terminated)
+    {
+        if (m_return_type == T_VOID)
+        {
+            emit(OP_RET, IR_VOID, {});
+        }
+        else
+        {
+            emit(OP_RET, IR_VOID, {getZero(m_return_type)});
+        }
+    }
 
-    dataType cur_type = node->getResolvedType();
-    std::string op = operandType(cur_type) + "div";
+    removeTrivialPhis();
 
-    if (cur_type == T_INT)
+    for (auto &phi : m_phis)
     {
-        op = "s" + op;
+        if (m_replaced.count(phi.result.reg))
+        {
+            continue;
+        }
+
+        ir_instruction instr;
+        instr.op = OP_PHI;
+        instr.result = phi.result;
+        ssa_block &block = m_blocks[phi.block];
+        for (size_t i = 0; i < phi.operands.size(); i++)
+        {
+            instr.operands.push_back(replacement(phi.operands[i]));
+            instr.targets.push_back(m_blocks[block.preds[i]].block.get());
+        }
+
+        // Phis keep the order they were created in
+        auto &instrs = block.block->instructions;
+        auto pos = instrs.begin();
+        while (pos != instrs.end() && pos->op == OP_PHI)
+        {
+            pos++;
+        }
+        instrs.insert(pos, instr);
     }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << op << " " << typeToString(cur_type)
-          << " " << left_reg << ", " << right_reg << "\n";
+    for (auto id : m_block_order)
+    {
+        for (auto &instr : m_blocks[id].block->instructions)
+        {
+            for (auto &operand : instr.operands)
+            {
+                operand = replacement(operand);
+            }
+        }
+
+        m_function->blocks.push_back(std::move(m_blocks[id].block));
+    }
 
-    m_last_reg = cur_reg;
+    m_blocks.clear();
+    m_block_ids.clear();
+    m_block_order.clear();
+    m_phis.clear();
+    m_replaced.clear();
+    m_var_names.clear();
+    m_var_types.clear();
+    m_function = nullptr;
 }
 
-void IREmitterVisitor::visitMod(mod *node)
+// Globals live in memory, locals and parameters are SSA values
+ir_value IREmitterVisitor::loadVar(VarSymbol *sym)
 {
-    // Modulo usually only works for integers (srem)
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
+    if (sym->getAddress().empty())
+    {
+        return readVariable(sym->getSlot(), m_current_block);
+    }
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
+    irType type = toIRType(sym->getValueType());
+    return emit(OP_LOAD, type, {irGlobal(type, sym->getAddress())});
+}
 
-    std::string cur_reg = getNextReg();
-    // LLVM instruction for signed remainder is 'srem'
-    *m_ll << "\t" << cur_reg << " = srem i32 " << left_reg << ", " << right_reg
-          << "\n";
+void IREmitterVisitor::storeVar(VarSymbol *sym, ir_value value)
+{
+    if (sym->getAddress().empty())
+    {
+        writeVariable(sym->getSlot(), m_current_block, value);
+        return;
+    }
 
-    m_last_reg = cur_reg;
+    irType type = toIRType(sym->getValueType());
+    emit(OP_STORE, IR_VOID, {value, irGlobal(type, sym->getAddress())});
 }
 
-void IREmitterVisitor::visitLess(less *node)
+// x op= e computes in the promoted type of x and e, then converts back to x
+void IREmitterVisitor::compoundAssignment(STNode *node, irOpcode int_op,
+                                          irOpcode float_op)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    auto it = node->getChildrenList().begin();
+    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
+    VarSymbol *var =
+        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
+    dataType lhs_type = var->getValueType();
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    it++;
+    (*it)->accept(*this);
+    ir_value rhs_value = m_last_value;
+    dataType rhs_type = (*it)->getResolvedType();
 
-    // Matching their type
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+    ir_value lhs_value = loadVar(var);
+    dataType op_type = lhs_type;
+    binaryTypeTransition(op_type, rhs_type, lhs_value, rhs_value);
+
+    irOpcode op = (op_type == T_FLOAT) ? float_op : int_op;
+    m_last_value = emit(op, toIRType(op_type), {lhs_value, rhs_value});
+    assignmentTypeTransition(lhs_type, op_type);
+
+    storeVar(var, m_last_value);
+}
+
+void IREmitterVisitor::increment(STNode *node, bool up, bool prefix)
+{
+    IDENTIFIER *id = static_cast<IDENTIFIER *>(node->getChildrenList().front());
+    VarSymbol *sym = static_cast<VarSymbol *>(
+        SymbolTable::getInstance()->lookup(id->getLabel()));
+
+    dataType type = sym->getValueType();
+    ir_value old_value = loadVar(sym);
 
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "lt";
-    if (left_type == T_INT)
+    irOpcode op;
+    if (type == T_FLOAT)
+    {
+        op = up ? OP_FADD : OP_FSUB;
+    }
+    else
     {
-        op = "s" + op;
+        op = up ? OP_ADD : OP_SUB;
     }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
+    ir_value new_value = emit(op, toIRType(type), {old_value, getOne(type)});
+    storeVar(sym, new_value);
 
-    // Converting bool (i1) to int (i32) like C does!
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+    m_last_value = prefix ? new_value : old_value;
 }
 
-void IREmitterVisitor::visitLessEquals(less_equals *node)
+void IREmitterVisitor::arithmetic(STNode *node, irOpcode int_op,
+                                  irOpcode float_op)
 {
     node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
+    ir_value left_value = m_last_value;
     dataType left_type = node->getChildrenList().front()->getResolvedType();
 
     node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
+    ir_value right_value = m_last_value;
     dataType right_type = node->getChildrenList().back()->getResolvedType();
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+    binaryTypeTransition(left_type, right_type, left_value, right_value);
 
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "le";
-    if (left_type == T_INT)
-    {
-        op = "s" + op;
-    }
+    dataType cur_type = node->getResolvedType();
+    irOpcode op = (cur_type == T_FLOAT) ? float_op : int_op;
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
+    m_last_value = emit(op, toIRType(cur_type), {left_value, right_value});
+}
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+// icmp/fcmp condition codes of the relational operators, false for any
+// other node
+bool IREmitterVisitor::comparisonPredicates(nodeType type,
+                                            std::string &int_pred,
+                                            std::string &float_pred)
+{
+    switch (type)
+    {
+    case LESS_NODE:
+        int_pred = "slt";
+        float_pred = "olt";
+        return true;
+    case LESS_EQUALS_NODE:
+        int_pred = "sle";
+        float_pred = "ole";
+        return true;
+    case GREATER_NODE:
+        int_pred = "sgt";
+        float_pred = "ogt";
+        return true;
+    case GREATER_EQUALS_NODE:
+        int_pred = "sge";
+        float_pred = "oge";
+        return true;
+    case LOGIC_EQUALS_NODE:
+        int_pred = "eq";
+        float_pred = "oeq";
+        return true;
+    case LOGIC_NOT_EQUALS_NODE:
+        // NaN is unequal to everything
+        int_pred = "ne";
+        float_pred = "une";
+        return true;
+    default:
+        return false;
+    }
 }
 
-void IREmitterVisitor::visitGreater(greater *node)
+// Emits a relational operator as an i1
+ir_value IREmitterVisitor::compare(STNode *node)
 {
+    std::string int_pred, float_pred;
+    comparisonPredicates(node->getNodeType(), int_pred, float_pred);
+
     node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
+    ir_value left_value = m_last_value;
     dataType left_type = node->getChildrenList().front()->getResolvedType();
 
     node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
+    ir_value right_value = m_last_value;
     dataType right_type = node->getChildrenList().back()->getResolvedType();
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+    // Matching their type
+    binaryTypeTransition(left_type, right_type, left_value, right_value);
 
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "gt";
-    if (left_type == T_INT)
+    if (left_type == T_FLOAT)
     {
-        op = "s" + op;
+        return emit(OP_FCMP, IR_I1, {left_value, right_value}, float_pred);
     }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
-
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+    return emit(OP_ICMP, IR_I1, {left_value, right_value}, int_pred);
 }
 
-void IREmitterVisitor::visitGreaterEquals(greater_equals *node)
+// Relational operators give an i1, C wants it as an int
+void IREmitterVisitor::comparison(STNode *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    m_last_value = emit(OP_ZEXT, IR_I32, {compare(node)});
+}
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+// A scalar as an i1, comparisons are used as they are
+ir_value IREmitterVisitor::truthValue(STNode *node)
+{
+    std::string int_pred, float_pred;
+    if (comparisonPredicates(node->getNodeType(), int_pred, float_pred))
+    {
+        return compare(node);
+    }
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+    node->accept(*this);
+    return boolConvertor(node->getResolvedType(), m_last_value);
+}
 
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "ge";
-    if (left_type == T_INT)
+// Branches on a condition without turning it into an int first: comparisons
+// feed the br directly and && / || skip their right operand
+void IREmitterVisitor::branchOn(STNode *cond, std::string label_true,
+                                std::string label_false)
+{
+    while (cond->getNodeType() == CONDITION_NODE ||
+           cond->getNodeType() == EXPRESSION_NODE)
     {
-        op = "s" + op;
+        cond = cond->getChildrenList().front();
     }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
-
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+    STNode *left = cond->getChildrenList().empty()
+                       ? nullptr
+                       : cond->getChildrenList().front();
+    STNode *right = cond->getChildrenList().empty()
+                        ? nullptr
+                        : cond->getChildrenList().back();
+    if (cond->getNodeType() == LOGIC_AND_NODE)
+    {
+        std::string label_rhs = "and_rhs_" + std::to_string(m_label_count++);
+        branchOn(left, label_rhs, label_false);
+        sealBlock(label_rhs);
+        startBlock(label_rhs);
+        branchOn(right, label_true, label_false);
+    }
+    else if (cond->getNodeType() == LOGIC_OR_NODE)
+    {
+        std::string label_rhs = "or_rhs_" + std::to_string(m_label_count++);
+        branchOn(left, label_true, label_rhs);
+        sealBlock(label_rhs);
+        startBlock(label_rhs);
+        branchOn(right, label_true, label_false);
+    }
+    else if (cond->getNodeType() == LOGIC_NOT_NODE)
+    {
+        branchOn(left, label_false, label_true);
+    }
+    else if (cond->getNodeType() == NUMBER_NODE)
+    {
+        // Folded conditions like while (1) need no test at all
+        NUMBER *number = static_cast<NUMBER *>(cond);
+        bool truth = (cond->getResolvedType() == T_FLOAT)
+                         ? number->getFValue() != 0
+                         : number->getIValue() != 0;
+        branch(truth ? label_true : label_false);
+    }
+    else
+    {
+        condBranch(truthValue(cond), label_true, label_false);
+    }
 }
 
-void IREmitterVisitor::visitLogicEquals(logic_equals *node)
+// && and || as values: the left side branches like a condition and the
+// variable the result is kept in becomes a phi where both paths meet
+void IREmitterVisitor::logicValue(STNode *node, bool is_and)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    std::string label_rhs = "logic_rhs_" + std::to_string(m_label_count);
+    std::string label_end = "logic_end_" + std::to_string(m_label_count++);
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().back()->getResolvedType();
+    // Leaving early means false for && and true for ||
+    int result = newVariable("", T_INT);
+    writeVariable(result, m_current_block, irInt(is_and ? 0 : 1));
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
-
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "eq";
+    if (is_and)
+    {
+        branchOn(node->getChildrenList().front(), label_rhs, label_end);
+    }
+    else
+    {
+        branchOn(node->getChildrenList().front(), label_end, label_rhs);
+    }
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
+    sealBlock(label_rhs);
+    startBlock(label_rhs);
+    ir_value truth = truthValue(node->getChildrenList().back());
+    writeVariable(result, m_current_block, emit(OP_ZEXT, IR_I32, {truth}));
+    branch(label_end);
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+    sealBlock(label_end);
+    startBlock(label_end);
+    m_last_value = readVariable(result, m_current_block);
 }
 
-void IREmitterVisitor::visitLogicNotEquals(logic_not_equals *node)
+void IREmitterVisitor::bitwise(STNode *node, irOpcode op)
 {
     node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
+    ir_value left_value = m_last_value;
     dataType left_type = node->getChildrenList().front()->getResolvedType();
 
     node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
+    ir_value right_value = m_last_value;
     dataType right_type = node->getChildrenList().back()->getResolvedType();
 
-    binaryTypeTransition(left_type, right_type, left_reg, right_reg);
+    toInteger(left_type, left_value);
+    toInteger(right_type, right_value);
 
-    std::string comp = compareType(left_type);
-    std::string op = comparatorType(left_type) + "ne";
+    m_last_value = emit(op, IR_I32, {left_value, right_value});
+}
+
+// --- VISITORS ---
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = " << comp << " " << op << " "
-          << typeToString(left_type) << " " << left_reg << ", " << right_reg
-          << "\n";
+void IREmitterVisitor::visitIDENTIFIER(IDENTIFIER *node)
+{
+    std::string name = node->getLabel();
+    VarSymbol *sym =
+        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+    m_last_value = loadVar(sym);
 }
 
-void IREmitterVisitor::visitLogicAnd(logic_and *node)
+void IREmitterVisitor::visitNUMBER(NUMBER *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    if (node->getResolvedType() == T_INT)
+    {
+        m_last_value = irInt(node->getIValue());
+    }
+    else if (node->getResolvedType() == T_FLOAT)
+    {
+        // Printed as the exact hex bits, no instruction needed
+        m_last_value = irFloat(node->getFValue());
+    }
+}
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
+void IREmitterVisitor::visitAddition(addition *node)
+{
+    arithmetic(node, OP_ADD, OP_FADD);
+}
 
-    left_reg = boolConvertor(left_type, left_reg);
-    right_reg = boolConvertor(right_type, right_reg);
+void IREmitterVisitor::visitSubtraction(subtraction *node)
+{
+    arithmetic(node, OP_SUB, OP_FSUB);
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = and i1 " << left_reg << ", " << right_reg
-          << "\n";
+void IREmitterVisitor::visitMultiplication(multiplication *node)
+{
+    arithmetic(node, OP_MUL, OP_FMUL);
+}
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+void IREmitterVisitor::visitDivision(division *node)
+{
+    arithmetic(node, OP_SDIV, OP_FDIV);
 }
 
-void IREmitterVisitor::visitLogicOr(logic_or *node)
+void IREmitterVisitor::visitMod(mod *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    // Modulo usually only works for integers (srem)
+    arithmetic(node, OP_SREM, OP_SREM);
+}
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
+void IREmitterVisitor::visitLess(less *node) { comparison(node); }
 
-    left_reg = boolConvertor(left_type, left_reg);
-    right_reg = boolConvertor(right_type, right_reg);
+void IREmitterVisitor::visitLessEquals(less_equals *node)
+{
+    comparison(node);
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = or i1 " << left_reg << ", " << right_reg
-          << "\n";
+void IREmitterVisitor::visitGreater(greater *node)
+{
+    comparison(node);
+}
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+void IREmitterVisitor::visitGreaterEquals(greater_equals *node)
+{
+    comparison(node);
 }
 
-void IREmitterVisitor::visitLogicNot(logic_not *node)
+void IREmitterVisitor::visitLogicEquals(logic_equals *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
+    comparison(node);
+}
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
+void IREmitterVisitor::visitLogicNotEquals(logic_not_equals *node)
+{
+    comparison(node);
+}
 
-    left_reg = boolConvertor(left_type, left_reg);
-    right_reg = boolConvertor(right_type, right_reg);
+void IREmitterVisitor::visitLogicAnd(logic_and *node)
+{
+    logicValue(node, true);
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = xor i1 " << left_reg << ", " << right_reg
-          << "\n";
+void IREmitterVisitor::visitLogicOr(logic_or *node)
+{
+    logicValue(node, false);
+}
 
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = zext i1 " << m_last_reg << " to i32\n";
-    m_last_reg = cur_reg;
+void IREmitterVisitor::visitLogicNot(logic_not *node)
+{
+    ir_value truth = truthValue(node->getChildrenList().front());
+    m_last_value = emit(OP_XOR, IR_I1, {truth, irInt(1, IR_I1)});
+    m_last_value = emit(OP_ZEXT, IR_I32, {m_last_value});
 }
 
-void IREmitterVisitor::visitBitWiseAnd(bit_wise_and *node)
+void IREmitterVisitor::visitUnaryPlus(unary_plus *node)
 {
     node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
-
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
-
-    toInteger(left_type, left_reg);
-    toInteger(right_type, right_reg);
-
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = and i32" << left_reg << ", " << right_reg
-          << "\n";
-    m_last_reg = cur_reg;
 }
 
-void IREmitterVisitor::visitBitWiseOr(bit_wise_or *node)
+void IREmitterVisitor::visitUnaryMinus(unary_minus *node)
 {
     node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
 
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
+    if (node->getResolvedType() == T_FLOAT)
+    {
+        // -0.0 - x flips the sign of zeros too
+        m_last_value = emit(OP_FSUB, IR_FLOAT, {irFloat(-0.0), m_last_value});
+    }
+    else
+    {
+        m_last_value = emit(OP_SUB, IR_I32, {irInt(0), m_last_value});
+    }
+}
 
-    toInteger(left_type, left_reg);
-    toInteger(right_type, right_reg);
+void IREmitterVisitor::visitBitWiseAnd(bit_wise_and *node)
+{
+    bitwise(node, OP_AND);
+}
 
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = or i32" << left_reg << ", " << right_reg
-          << "\n";
-    m_last_reg = cur_reg;
+void IREmitterVisitor::visitBitWiseOr(bit_wise_or *node)
+{
+    bitwise(node, OP_OR);
 }
 
 void IREmitterVisitor::visitBitWiseXor(bit_wise_xor *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
-
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
-
-    toInteger(left_type, left_reg);
-    toInteger(right_type, right_reg);
-
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = xor i32" << left_reg << ", " << right_reg
-          << "\n";
-    m_last_reg = cur_reg;
+    bitwise(node, OP_XOR);
 }
 
 void IREmitterVisitor::visitBitWiseNot(bit_wise_not *node)
 {
     node->getChildrenList().front()->accept(*this);
     dataType type = node->getChildrenList().front()->getResolvedType();
-    toInteger(type, m_last_reg);
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = xor i32 " << m_last_reg << ", -1\n";
+    toInteger(type, m_last_value);
+    m_last_value = emit(OP_XOR, IR_I32, {m_last_value, irInt(-1)});
 }
 
 void IREmitterVisitor::visitShiftLeft(shift_left *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
-
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
-
-    toInteger(left_type, left_reg);
-    toInteger(right_type, right_reg);
-
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = shl i32 " << left_reg << ", " << right_reg
-          << "\n";
-    m_last_reg = cur_reg;
+    bitwise(node, OP_SHL);
 }
 
 void IREmitterVisitor::visitShiftRight(shift_right *node)
 {
-    node->getChildrenList().front()->accept(*this);
-    std::string left_reg = m_last_reg;
-    dataType left_type = node->getChildrenList().front()->getResolvedType();
-
-    node->getChildrenList().back()->accept(*this);
-    std::string right_reg = m_last_reg;
-    dataType right_type = node->getChildrenList().front()->getResolvedType();
-
-    toInteger(left_type, left_reg);
-    toInteger(right_type, right_reg);
-
-    std::string cur_reg = getNextReg();
-    *m_ll << "\t" << cur_reg << " = arhl i32 " << left_reg << ", " << right_reg
-          << "\n";
-    m_last_reg = cur_reg;
+    bitwise(node, OP_ASHR);
 }
 
 void IREmitterVisitor::visitPostfixIncrement(postfix_increment *node)
 {
-    auto it = node->getChildrenList().begin();
-
-    IDENTIFIER *id = static_cast<IDENTIFIER *>(*it);
-    std::string name = id->getLabel();
-    VarSymbol *sym =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-
-    std::string cur_reg = getNextReg();
-    std::string type_str = typeToString(sym->getValueType());
-    std::string mem_loc = sym->getAddress();
-
-    *m_ll << "\t" << cur_reg << " = load " << type_str << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    std::string old_reg = cur_reg;
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    std::string op = operandType(sym->getValueType()) + "add";
-    std::string num_one = getOne(sym->getValueType());
-
-    *m_ll << "\t" << cur_reg << " = " << op << " " << type_str << " "
-          << m_last_reg << ", " << num_one << "\n";
-
-    *m_ll << "\t" << "store " << type_str << " " << cur_reg << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = old_reg;
+    increment(node, true, false);
 }
 
 void IREmitterVisitor::visitPostfixDecrement(postfix_decrement *node)
 {
-    auto it = node->getChildrenList().begin();
-
-    IDENTIFIER *id = static_cast<IDENTIFIER *>(*it);
-    std::string name = id->getLabel();
-    VarSymbol *sym =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-
-    std::string cur_reg = getNextReg();
-    std::string type_str = typeToString(sym->getValueType());
-    std::string mem_loc = sym->getAddress();
-
-    *m_ll << "\t" << cur_reg << " = load " << type_str << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    std::string old_reg = cur_reg;
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    std::string op = operandType(sym->getValueType()) + "sub";
-    std::string num_one = getOne(sym->getValueType());
-
-    *m_ll << "\t" << cur_reg << " = " << op << " " << type_str << " "
-          << m_last_reg << ", " << num_one << "\n";
-
-    *m_ll << "\t" << "store " << type_str << " " << cur_reg << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = old_reg;
+    increment(node, false, false);
 }
 
 void IREmitterVisitor::visitPrefixIncrement(prefix_increment *node)
 {
-    auto it = node->getChildrenList().begin();
-
-    IDENTIFIER *id = static_cast<IDENTIFIER *>(*it);
-    std::string name = id->getLabel();
-    VarSymbol *sym =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-
-    std::string cur_reg = getNextReg();
-    std::string type_str = typeToString(sym->getValueType());
-    std::string num_one = getOne(sym->getValueType());
-    std::string mem_loc = sym->getAddress();
-
-    *m_ll << "\t" << cur_reg << " = load " << type_str << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    std::string op = operandType(sym->getValueType()) + "add";
-
-    *m_ll << "\t" << cur_reg << " = " << op << " " << type_str << " "
-          << m_last_reg << ", " << num_one << "\n";
-
-    *m_ll << "\t" << "store " << type_str << " " << cur_reg << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = cur_reg;
+    increment(node, true, true);
 }
 
 void IREmitterVisitor::visitPrefixDecrement(prefix_decrement *node)
 {
-    auto it = node->getChildrenList().begin();
-
-    IDENTIFIER *id = static_cast<IDENTIFIER *>(*it);
-    std::string name = id->getLabel();
-    VarSymbol *sym =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-
-    std::string cur_reg = getNextReg();
-    std::string type_str = typeToString(sym->getValueType());
-    std::string mem_loc = sym->getAddress();
-
-    *m_ll << "\t" << cur_reg << " = load " << type_str << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = cur_reg;
-    cur_reg = getNextReg();
-    std::string op = operandType(sym->getValueType()) + "sub";
-    std::string num_one = getOne(sym->getValueType());
-
-    *m_ll << "\t" << cur_reg << " = " << op << " " << type_str << " "
-          << m_last_reg << ", " << num_one << "\n";
-
-    *m_ll << "\t" << "store " << type_str << " " << cur_reg << ", " << type_str
-          << "* " << mem_loc << "\n";
-
-    m_last_reg = cur_reg;
+    increment(node, false, true);
 }
 
 void IREmitterVisitor::visitAssignment(assignment *node)
@@ -778,184 +1003,40 @@ void IREmitterVisitor::visitAssignment(assignment *node)
     std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
     VarSymbol *var =
         static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
 
     it++;
     (*it)->accept(*this);
 
-    dataType lhs_type = node->getResolvedType();
+    dataType lhs_type = var->getValueType();
     dataType rhs_type = (*it)->getResolvedType();
     assignmentTypeTransition(lhs_type, rhs_type);
 
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << m_last_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = cur_reg;
+    storeVar(var, m_last_value);
 }
 
 void IREmitterVisitor::visitPlusAssignment(plus_assignment *node)
 {
-    auto it = node->getChildrenList().begin();
-    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
-    VarSymbol *var =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
-    dataType lhs_type = var->getValueType();
-
-    it++;
-    (*it)->accept(*this);
-    dataType rhs_type = (*it)->getResolvedType();
-
-    assignmentTypeTransition(lhs_type, rhs_type);
-    std::string val_to_add = m_last_reg;
-
-    std::string loaded_reg = getNextReg();
-    *m_ll << "\t" << loaded_reg << " = load " << typeToString(lhs_type) << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    std::string temp_reg = getNextReg();
-    std::string op = operandType(lhs_type) + "add";
-
-    *m_ll << "\t" << temp_reg << " = " << op << " " << typeToString(lhs_type)
-          << " " << loaded_reg << ", " << val_to_add << "\n";
-
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << temp_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = temp_reg;
+    compoundAssignment(node, OP_ADD, OP_FADD);
 }
 
 void IREmitterVisitor::visitMulAssignment(mul_assignment *node)
 {
-    auto it = node->getChildrenList().begin();
-    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
-    VarSymbol *var =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
-    dataType lhs_type = var->getValueType();
-
-    it++;
-    (*it)->accept(*this);
-    dataType rhs_type = (*it)->getResolvedType();
-
-    assignmentTypeTransition(lhs_type, rhs_type);
-    std::string val_to_add = m_last_reg;
-
-    std::string loaded_reg = getNextReg();
-    *m_ll << "\t" << loaded_reg << " = load " << typeToString(lhs_type) << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    std::string temp_reg = getNextReg();
-    std::string op = operandType(lhs_type) + "mul";
-
-    *m_ll << "\t" << temp_reg << " = " << op << " " << typeToString(lhs_type)
-          << " " << loaded_reg << ", " << val_to_add << "\n";
-
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << temp_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = temp_reg;
+    compoundAssignment(node, OP_MUL, OP_FMUL);
 }
 
 void IREmitterVisitor::visitMinusAssignment(minus_assignment *node)
 {
-    auto it = node->getChildrenList().begin();
-    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
-    VarSymbol *var =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
-    dataType lhs_type = var->getValueType();
-
-    it++;
-    (*it)->accept(*this);
-    dataType rhs_type = (*it)->getResolvedType();
-
-    assignmentTypeTransition(lhs_type, rhs_type);
-    std::string val_to_add = m_last_reg;
-
-    std::string loaded_reg = getNextReg();
-    *m_ll << "\t" << loaded_reg << " = load " << typeToString(lhs_type) << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    std::string temp_reg = getNextReg();
-    std::string op = operandType(lhs_type) + "sub";
-
-    *m_ll << "\t" << temp_reg << " = " << op << " " << typeToString(lhs_type)
-          << " " << loaded_reg << ", " << val_to_add << "\n";
-
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << temp_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = temp_reg;
+    compoundAssignment(node, OP_SUB, OP_FSUB);
 }
 
 void IREmitterVisitor::visitDivAssignment(div_assignment *node)
 {
-    auto it = node->getChildrenList().begin();
-    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
-    VarSymbol *var =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
-    dataType lhs_type = var->getValueType();
-
-    it++;
-    (*it)->accept(*this);
-    dataType rhs_type = (*it)->getResolvedType();
-
-    assignmentTypeTransition(lhs_type, rhs_type);
-    std::string val_to_add = m_last_reg;
-
-    std::string loaded_reg = getNextReg();
-    *m_ll << "\t" << loaded_reg << " = load " << typeToString(lhs_type) << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    std::string temp_reg = getNextReg();
-    std::string op = operandType(lhs_type) + "div";
-
-    if (lhs_type == T_INT)
-    {
-        op = "s" + op;
-    }
-
-    *m_ll << "\t" << temp_reg << " = " << op << " " << typeToString(lhs_type)
-          << " " << loaded_reg << ", " << val_to_add << "\n";
-
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << temp_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = temp_reg;
+    compoundAssignment(node, OP_SDIV, OP_FDIV);
 }
 
 void IREmitterVisitor::visitModAssignment(mod_assignment *node)
 {
-    auto it = node->getChildrenList().begin();
-    std::string name = static_cast<IDENTIFIER *>((*it))->getLabel();
-    VarSymbol *var =
-        static_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
-    std::string cur_reg = var->getAddress();
-    dataType lhs_type = var->getValueType();
-
-    it++;
-    (*it)->accept(*this);
-    dataType rhs_type = (*it)->getResolvedType();
-
-    assignmentTypeTransition(lhs_type, rhs_type);
-    std::string val_to_add = m_last_reg;
-
-    std::string loaded_reg = getNextReg();
-    *m_ll << "\t" << loaded_reg << " = load " << typeToString(lhs_type) << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    std::string temp_reg = getNextReg();
-    std::string op = "srem";
-
-    *m_ll << "\t" << temp_reg << " = " << op << " " << typeToString(lhs_type)
-          << " " << loaded_reg << ", " << val_to_add << "\n";
-
-    *m_ll << "\tstore " << typeToString(lhs_type) << " " << temp_reg << ", "
-          << typeToString(lhs_type) << "* " << cur_reg << "\n";
-
-    m_last_reg = temp_reg;
+    compoundAssignment(node, OP_SREM, OP_SREM);
 }
 
 void IREmitterVisitor::visitVariableDeclaration(variable_declaration *node)
@@ -971,7 +1052,7 @@ void IREmitterVisitor::visitVariableDeclaration(variable_declaration *node)
     }
     else // var decl with no expression
     {
-        m_last_reg.clear();
+        m_last_value = ir_value();
     }
 }
 
@@ -1005,7 +1086,8 @@ void IREmitterVisitor::visitVariableDeclarationStatement(
 
     if (node->getParent()->getNodeType() == EXTERNAL_DECLARATION_NODE)
     {
-        // Global Variables
+        // Global Variables, initializers that are not constant run at the
+        // start of main
 
         for (auto &var : m_vars)
         {
@@ -1013,37 +1095,28 @@ void IREmitterVisitor::visitVariableDeclarationStatement(
                 static_cast<IDENTIFIER *>(var->getChildrenList().front())
                     ->getLabel();
 
-            std::string mem_loc = "@" + name;
-            std::string zero = (current_type == T_INT) ? "0" : "0.0e+00";
+            ir_value value = getZero(current_type);
+            bool constant =
+                !m_init_calls && constantInitializer(var, current_type, value);
 
-            *m_ll << mem_loc << " = global " << typeToString(current_type)
-                  << " " << zero << "\n";
-
-            VarSymbol *sym = new VarSymbol(0, name, current_type);
-            sym->setAddress(mem_loc);
-            SymbolTable::getInstance()->insert(sym);
+            m_module.addGlobal(name, toIRType(current_type), value);
 
-            m_ll = &m_global_init_buff;
-            // Number will not initiate
-            var->accept(*this);
+            // Functions only see the global frame, so the address goes on
+            // the type checker's symbol
+            VarSymbol *sym = static_cast<VarSymbol *>(
+                SymbolTable::getInstance()->lookupGlobal(name));
+            sym->setAddress(name);
 
-            if (!m_last_reg.empty())
+            if (!constant)
             {
-                dataType lhs_type = current_type;
-                dataType rhs_type = var->getResolvedType();
-
-                assignmentTypeTransition(lhs_type, rhs_type);
-
-                *m_ll << "\tstore " << typeToString(lhs_type) << " "
-                      << m_last_reg << ", " << typeToString(lhs_type) << "* "
-                      << mem_loc << "\n";
+                m_global_inits.push_back({name, var});
+                m_init_calls = m_init_calls || containsCall(var);
             }
-            m_ll = &m_file_ll;
         }
     }
     else
     {
-        // Local Variables
+        // Local Variables are SSA values, a declaration is their first def
 
         for (auto &var : m_vars)
         {
@@ -1052,27 +1125,22 @@ void IREmitterVisitor::visitVariableDeclarationStatement(
                 static_cast<IDENTIFIER *>(var->getChildrenList().front())
                     ->getLabel();
 
-            std::string mem_loc =
-                "%" + name + ".addr." + std::to_string(m_var_count++);
-
             VarSymbol *sym = new VarSymbol(0, name, current_type);
-            sym->setAddress(mem_loc);
-            SymbolTable::getInstance()->insert(sym);
-
-            *m_ll << "\t" << mem_loc << " = alloca "
-                  << typeToString(current_type) << ", align 4\n";
+            sym->setSlot(newVariable(name, current_type));
 
-            if (!m_last_reg.empty())
+            ir_value value = getZero(current_type);
+            if (m_last_value.kind != VAL_NONE)
             {
                 dataType lhs_type = current_type;
                 dataType rhs_type = var->getResolvedType();
 
                 assignmentTypeTransition(lhs_type, rhs_type);
-
-                *m_ll << "\tstore " << typeToString(lhs_type) << " "
-                      << m_last_reg << ", " << typeToString(lhs_type) << "* "
-                      << mem_loc << "\n";
+                value = m_last_value;
             }
+
+            // The initializer may read a shadowed variable of the same name
+            SymbolTable::getInstance()->insert(sym);
+            storeVar(sym, value);
         }
     }
 
@@ -1134,10 +1202,32 @@ void IREmitterVisitor::visitArgumentList(argument_list *node)
     }
 }
 
+// The function gets its place in the module now, in source order. With
+// several threads its body is emitted after the walk, see emitDeferred.
 void IREmitterVisitor::visitFunctionDefinition(function_definition *node)
 {
     auto it = node->getChildrenList().begin();
-    m_reg_count = 0;
+
+    dataType return_type = static_cast<type_specifier *>(*it)->getType();
+    it++;
+    std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+    ir_function *function = m_module.addFunction(id, toIRType(return_type));
+
+    if (m_threads > 1)
+    {
+        m_deferred.push_back({node, function});
+    }
+    else
+    {
+        emitFunction(node, function);
+    }
+}
+
+void IREmitterVisitor::emitFunction(function_definition *node,
+                                    ir_function *function)
+{
+    auto it = node->getChildrenList().begin();
 
     dataType return_type = static_cast<type_specifier *>(*it)->getType();
     it++;
@@ -1147,24 +1237,14 @@ void IREmitterVisitor::visitFunctionDefinition(function_definition *node)
     it++;
     compound_statement *body = static_cast<compound_statement *>(*it);
 
-    std::string str_params = "";
-    for (auto &param : m_params)
-    {
-        if (!str_params.empty())
-        {
-            str_params += ", ";
-        }
-
-        str_params += typeToString(param.type) + " %" + param.name;
-    }
-
-    *m_ll << "define " << typeToString(return_type) << " @" << id << "("
-          << str_params << ") {\n";
-    *m_ll << "entry:\n";
+    beginFunction(function, return_type);
 
     if (id == "main")
     {
-        *m_ll << "\tcall void @_init_globals()\n";
+        ir_instruction init;
+        init.op = OP_CALL;
+        init.callee = "_init_globals";
+        m_blocks[m_current_block].block->instructions.push_back(init);
     }
 
     SymbolTable::getInstance()->enterScope(
@@ -1172,34 +1252,23 @@ void IREmitterVisitor::visitFunctionDefinition(function_definition *node)
 
     for (auto &param : m_params)
     {
-        std::string raw_arg = "%" + param.name;
-        std::string mem_loc = raw_arg + ".addr";
-
-        *m_ll << "\t" << mem_loc << " = alloca " << typeToString(param.type)
-              << ", align 4" << "\n";
-        *m_ll << "\t" << "store " << typeToString(param.type) << " " << raw_arg
-              << ", " << typeToString(param.type) << "* " << mem_loc << "\n";
+        ir_value arg = m_function->newReg(toIRType(param.type), param.name);
+        m_function->params.push_back(arg);
 
         VarSymbol *sym = new VarSymbol(0, param.name, param.type);
-        sym->setAddress(mem_loc);
+        sym->setSlot(newVariable(param.name, param.type));
         SymbolTable::getInstance()->insert(sym);
+
+        storeVar(sym, arg);
     }
 
     m_params.clear();
-    
-    body->accept(*this);
 
-    if (return_type == T_VOID)
-    {
-        *m_ll << "\tret void\n";
-    }
+    body->accept(*this);
 
     SymbolTable::getInstance()->exitScope();
 
-    *m_ll << "}\n\n";
-
-    // I make reg count 0 because i need to handle global variable init
-    m_reg_count = 0;
+    endFunction();
 }
 
 void IREmitterVisitor::visitReturn(return_node *node)
@@ -1210,18 +1279,29 @@ void IREmitterVisitor::visitReturn(return_node *node)
     {
         childs.front()->accept(*this);
 
-        dataType expect_ret = node->getResolvedType();
+        dataType expect_ret = m_return_type;
         dataType expr_type = childs.front()->getResolvedType();
 
         // Using assignmentTypeTransition because return expression must match
         // function return type
         assignmentTypeTransition(expect_ret, expr_type);
 
-        *m_ll << "\tret " << typeToString(expect_ret) << " " << m_last_reg
-              << "\n";
+        if (expect_ret == T_VOID)
+        {
+            // return of a void call
+            emit(OP_RET, IR_VOID, {});
+        }
+        else
+        {
+            emit(OP_RET, IR_VOID, {m_last_value});
+        }
+    }
+    else
+    {
+        emit(OP_RET, IR_VOID, {});
     }
-    // I prefer that void functions should eb handled on function definition,
-    // because its acceptable to not have a return statement.
+
+    terminate();
 }
 
 void IREmitterVisitor::visitIfStatement(if_statement *node)
@@ -1232,34 +1312,31 @@ void IREmitterVisitor::visitIfStatement(if_statement *node)
     std::string label_end = "if_end_" + std::to_string(id);
 
     auto it = node->getChildrenList().begin();
-    (*it)->accept(*this);
-
-    std::string cond_reg = m_last_reg;
-    dataType cond_type = (*it)->getResolvedType();
+    STNode *cond_node = *it;
     it++;
 
-    boolConvertor(cond_type, cond_reg);
-
     bool has_else = node->getChildrenList().size() == 3;
     std::string real_end = has_else ? label_false : label_end;
 
     // Initial check
-    *m_ll << "\tbr i1 " << cond_reg << ", label %" << label_true << ", label %"
-          << real_end << "\n";
+    branchOn(cond_node, label_true, real_end);
+    sealBlock(label_true);
 
-    *m_ll << label_true << ":\n";
+    startBlock(label_true);
     (*it)->accept(*this);
-    *m_ll << "\tbr label %" << label_end << "\n";
+    branch(label_end);
 
     if (has_else)
     {
-        *m_ll << label_false << ":\n";
+        sealBlock(label_false);
+        startBlock(label_false);
         it++;
         (*it)->accept(*this);
-        *m_ll << "\tbr label %" << label_end << "\n";
+        branch(label_end);
     }
 
-    *m_ll << label_end << ":\n";
+    sealBlock(label_end);
+    startBlock(label_end);
 }
 
 void IREmitterVisitor::visitWhileStatement(while_statement *node)
@@ -1274,19 +1351,12 @@ void IREmitterVisitor::visitWhileStatement(while_statement *node)
     it++;
     STNode *body_node = *it;
 
-    *m_ll << "\tbr label %" << label_cond << "\n";
-
-    *m_ll << "\n" << label_cond << ":\n";
-    cond_node->accept(*this);
-
-    std::string cond_reg = m_last_reg;
-    dataType cond_type = cond_node->getResolvedType();
-    cond_reg = boolConvertor(cond_type, cond_reg);
+    // The condition is sealed once the back edge is known
+    startBlock(label_cond);
+    branchOn(cond_node, label_body, label_exit);
+    sealBlock(label_body);
 
-    *m_ll << "\tbr i1 " << cond_reg << ", label %" << label_body << ", label %"
-          << label_exit << "\n";
-
-    *m_ll << "\n" << label_body << ":\n";
+    startBlock(label_body);
 
     m_continue_stack.push(label_cond);
     m_break_stack.push(label_exit);
@@ -1296,9 +1366,11 @@ void IREmitterVisitor::visitWhileStatement(while_statement *node)
     m_continue_stack.pop();
     m_break_stack.pop();
 
-    *m_ll << "\tbr label %" << label_cond << "\n";
+    branch(label_cond);
+    sealBlock(label_cond);
 
-    *m_ll << "\n" << label_exit << ":\n";
+    sealBlock(label_exit);
+    startBlock(label_exit);
 }
 
 void IREmitterVisitor::visitDoWhileStatement(do_while_statement *node)
@@ -1313,8 +1385,7 @@ void IREmitterVisitor::visitDoWhileStatement(do_while_statement *node)
     it++;
     condition *cond = static_cast<condition *>(*it);
 
-    *m_ll << "\tbr label %" << label_true << "\n";
-    *m_ll << label_true << ":\n";
+    startBlock(label_true);
 
     m_continue_stack.push(label_cond);
     m_break_stack.push(label_exit);
@@ -1324,18 +1395,13 @@ void IREmitterVisitor::visitDoWhileStatement(do_while_statement *node)
     m_continue_stack.pop();
     m_break_stack.pop();
 
-    *m_ll << "\tbr label %" << label_cond << "\n";
-    *m_ll << label_cond << ":\n";
-    cond->accept(*this);
-
-    std::string cond_reg = m_last_reg;
-    dataType cond_type = cond->getResolvedType();
-    cond_reg = boolConvertor(cond_type, cond_reg);
+    sealBlock(label_cond);
+    startBlock(label_cond);
+    branchOn(cond, label_true, label_exit);
+    sealBlock(label_true);
 
-    *m_ll << "\tbr i1 " << cond_reg << ", label %" << label_true << ", label %"
-          << label_exit << "\n";
-
-    *m_ll << label_exit << ":\n";
+    sealBlock(label_exit);
+    startBlock(label_exit);
 }
 
 void IREmitterVisitor::visitForStatement(for_statement *node)
@@ -1361,7 +1427,6 @@ void IREmitterVisitor::visitForStatement(for_statement *node)
         // Full loop: for(init; cond; step) body
         step_node = (*it++);
         body_node = (*it);
-        ;
     }
     else
     {
@@ -1375,46 +1440,40 @@ void IREmitterVisitor::visitForStatement(for_statement *node)
     // A. INITIALIZATION
     init_node->accept(*this);
 
-    *m_ll << "\tbr label %" << label_cond << "\n";
-    *m_ll << "\n" << label_cond << ":\n";
+    startBlock(label_cond);
 
     if (cond_node->getNodeType() != STATEMENT_NODE)
     {
-        cond_node->accept(*this);
-
-        std::string cond_reg = m_last_reg;
-        dataType cond_type = cond_node->getResolvedType();
-        cond_reg = boolConvertor(cond_type, cond_reg);
-
-        *m_ll << "\tbr i1 " << cond_reg << ", label %" << label_true
-              << ", label %" << label_exit << "\n";
+        branchOn(cond_node, label_true, label_exit);
     }
     else // If its not statement it will be expression based on the grammar
     {
         // Infinite loop for (;;)
-        *m_ll << "\tbr label %" << label_true << "\n";
+        branch(label_true);
     }
+    sealBlock(label_true);
 
-    *m_ll << "\n" << label_true << ":\n";
+    startBlock(label_true);
 
     // C. BODY
     body_node->accept(*this);
 
-    *m_ll << "\tbr label %" << label_inc << "\n";
-
     m_continue_stack.pop();
     m_break_stack.pop();
 
-    *m_ll << "\n" << label_inc << ":\n";
+    sealBlock(label_inc);
+    startBlock(label_inc);
 
     // D. STEP (Only accept if it exists)
     if (step_node != nullptr)
     {
         step_node->accept(*this);
     }
-    *m_ll << "\tbr label %" << label_cond << "\n";
+    branch(label_cond);
+    sealBlock(label_cond);
 
-    *m_ll << "\n" << label_exit << ":\n";
+    sealBlock(label_exit);
+    startBlock(label_exit);
 }
 
 void IREmitterVisitor::visitContinue(continue_node *node)
@@ -1424,8 +1483,7 @@ void IREmitterVisitor::visitContinue(continue_node *node)
         exit(1);
     }
 
-    std::string target = m_break_stack.top();
-    *m_ll << "\tbr label %" << target << "\n";
+    branch(m_continue_stack.top());
 }
 
 void IREmitterVisitor::visitBreak(break_node *node)
@@ -1435,8 +1493,7 @@ void IREmitterVisitor::visitBreak(break_node *node)
         exit(1);
     }
 
-    std::string target = m_continue_stack.top();
-    *m_ll << "\tbr label %" << target << "\n";
+    branch(m_break_stack.top());
 }
 
 void IREmitterVisitor::visitFunctionCall(function_call *node)
@@ -1449,7 +1506,7 @@ void IREmitterVisitor::visitFunctionCall(function_call *node)
     FuncSymbol *def = static_cast<FuncSymbol *>(
         SymbolTable::getInstance()->lookupGlobal(func_name));
 
-    std::string str_args = "";
+    std::vector<ir_value> args;
     if (childs.size() == 1) // No arguments
     {
     }
@@ -1458,31 +1515,33 @@ void IREmitterVisitor::visitFunctionCall(function_call *node)
         it++;
         (*it)->accept(*this);
 
-        for (auto &arg : m_args)
+        // Arguments may contain calls of their own that reuse m_args
+        std::vector<STNode *> arg_nodes;
+        arg_nodes.swap(m_args);
+
+        // Arguments are converted to the parameter types like assignments
+        std::vector<parameter> &params = def->getParameters();
+        for (size_t i = 0; i < arg_nodes.size(); i++)
         {
-            arg->accept(*this);
-            if (!str_args.empty())
-            {
-                str_args += ", ";
-            }
-            str_args += typeToString(arg->getResolvedType()) + " " + m_last_reg;
+            arg_nodes[i]->accept(*this);
+
+            dataType arg_type = arg_nodes[i]->getResolvedType();
+            assignmentTypeTransition(params[i].type, arg_type);
+            args.push_back(m_last_value);
         }
     }
 
-    dataType return_type = def->getReturnType();
-    if (return_type == T_VOID)
-    {
-        *m_ll << "\tcall " << typeToString(return_type) << " @" << func_name
-              << "(" << str_args << ")\n";
-    }
-    else
+    // The type checker marks calls whose result is returned as is
+    tailCallKind tail = NO_TAIL_CALL;
+    if (node->getParent()->getNodeType() == RETURN_NODE)
     {
-        std::string cur_reg = getNextReg();
-        *m_ll << "\t" << cur_reg << " = " << "call "
-              << typeToString(return_type) << " @" << func_name << "("
-              << str_args << ")\n";
-        m_last_reg = cur_reg;
+        tail = static_cast<return_node *>(node->getParent())->getTailCall();
     }
+
+    m_last_value = emit(OP_CALL, toIRType(def->getReturnType()), args);
+    ir_instruction &call = m_blocks[m_current_block].block->instructions.back();
+    call.callee = func_name;
+    call.tail = tail;
 }
 
 void IREmitterVisitor::visitFunctionDeclaration(function_declaration *node)
@@ -1498,32 +1557,106 @@ void IREmitterVisitor::visitFunctionDeclaration(function_declaration *node)
     FuncSymbol *sym = new FuncSymbol(return_type, nullptr, m_params, id);
     SymbolTable::getInstance()->insert(sym);
 
-    std::string str_params = "";
-    for (auto &param : m_params)
+    // Prototypes of functions defined later in the file need no declare
+    m_params.clear();
+}
+
+// Function bodies only read the global symbols, so each one is emitted on
+// its own thread with its own emitter and scope stack
+void IREmitterVisitor::emitDeferred()
+{
+    if (m_deferred.empty())
     {
-        if (!str_params.empty())
-        {
-            str_params += ", ";
-        }
+        return;
+    }
+
+    TaskPool pool(m_threads, g_emit_stack_size);
+    std::vector<std::unique_ptr<TaskPool::task>> tasks;
+
+    for (auto &deferred : m_deferred)
+    {
+        tasks.emplace_back(new TaskPool::task());
+        tasks.back()->run = [this, deferred]() {
+            SymbolTable::attachThread();
+            {
+                IREmitterVisitor worker;
+                worker.setFastMath(m_fast_math);
+                worker.emitFunction(deferred.first, deferred.second);
+            }
+            SymbolTable::detachThread();
+        };
+        pool.spawn(tasks.back().get());
+    }
 
-        str_params += typeToString(param.type) + " %" + param.name;
+    for (auto &task : tasks)
+    {
+        pool.join(task.get());
     }
 
-    // For some reason declare for function dose not work like function
-    // declaration *m_ll << "declare " << typeToString(return_type) << " @" <<
-    // id << "("
-    //       << str_params << ")\n";
+    m_deferred.clear();
 }
 
 void IREmitterVisitor::visitProgram(program *node)
 {
+    if (m_precomputed)
+    {
+        beginFunction(m_module.addFunction("main", IR_I32), T_INT);
+        emit(OP_RET, IR_VOID, {irInt(m_precomputed_result)});
+        terminate();
+        endFunction();
+        return;
+    }
+
     (*node->getChildrenList().begin())->accept(*this);
+    finishProgram();
+}
+
+void IREmitterVisitor::finishProgram()
+{
+    emitDeferred();
+
+    // Nothing to run, main's call goes away with the function
+    if (m_global_inits.empty())
+    {
+        for (auto &function : m_module.getFunctions())
+        {
+            if (function->name != "main")
+            {
+                continue;
+            }
+
+            auto &instrs = function->blocks.front()->instructions;
+            for (auto it = instrs.begin(); it != instrs.end(); it++)
+            {
+                if (it->op == OP_CALL && it->callee == "_init_globals")
+                {
+                    instrs.erase(it);
+                    break;
+                }
+            }
+        }
+        return;
+    }
+
+    beginFunction(m_module.addFunction("_init_globals", IR_VOID), T_VOID);
+
+    for (auto &init : m_global_inits)
+    {
+        VarSymbol *sym = static_cast<VarSymbol *>(
+            SymbolTable::getInstance()->lookupGlobal(init.first));
 
-    *m_ll << "\ndefine void @_init_globals() {\n";
-    *m_ll << "entry:\n";
+        // Number will not initiate
+        init.second->accept(*this);
 
-    *m_ll << m_global_init_buff.str();
+        if (m_last_value.kind != VAL_NONE)
+        {
+            dataType lhs_type = sym->getValueType();
+            dataType rhs_type = init.second->getResolvedType();
+
+            assignmentTypeTransition(lhs_type, rhs_type);
+            storeVar(sym, m_last_value);
+        }
+    }
 
-    *m_ll << "\tret void\n";
-    *m_ll << "}\n";
+    endFunction();
 }
@@ -0,0 +1,231 @@
+#include "../lib/ir_module.hh"
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+bool ir_value::operator==(const ir_value &other) const
+{
+    if (kind != other.kind || type != other.type)
+    {
+        return false;
+    }
+
+    switch (kind)
+    {
+    case VAL_REG:
+        return reg == other.reg;
+    case VAL_INT:
+        return ivalue == other.ivalue;
+    case VAL_FLOAT:
+        // Bitwise, so -0.0 and 0.0 stay apart
+        return std::memcmp(&fvalue, &other.fvalue, sizeof(fvalue)) == 0;
+    case VAL_GLOBAL:
+        return global == other.global;
+    default:
+        return true;
+    }
+}
+
+bool ir_value::operator!=(const ir_value &other) const
+{
+    return !(*this == other);
+}
+
+ir_value irReg(irType type, int reg)
+{
+    ir_value value;
+    value.kind = VAL_REG;
+    value.type = type;
+    value.reg = reg;
+    return value;
+}
+
+ir_value irInt(int value, irType type)
+{
+    ir_value constant;
+    constant.kind = VAL_INT;
+    constant.type = type;
+    constant.ivalue = value;
+    return constant;
+}
+
+ir_value irFloat(double value, irType type)
+{
+    ir_value constant;
+    constant.kind = VAL_FLOAT;
+    constant.type = type;
+    constant.fvalue = value;
+    return constant;
+}
+
+ir_value irGlobal(irType type, std::string name)
+{
+    ir_value address;
+    address.kind = VAL_GLOBAL;
+    address.type = type;
+    address.global = name;
+    return address;
+}
+
+bool ir_instruction::isTerminator() const
+{
+    return op == OP_BR || op == OP_COND_BR || op == OP_RET ||
+           op == OP_UNREACHABLE;
+}
+
+bool ir_instruction::hasSideEffects() const
+{
+    return op == OP_STORE || op == OP_CALL || isTerminator();
+}
+
+ir_value ir_function::newReg(irType type, std::string name)
+{
+    reg_names.push_back(name);
+    return irReg(type, reg_names.size() - 1);
+}
+
+std::vector<std::string> ir_function::uniqueNames()
+{
+    std::unordered_set<std::string> used;
+    std::unordered_map<std::string, unsigned int> suffix;
+    std::vector<std::string> names(reg_names.size());
+
+    for (auto &block : blocks)
+    {
+        used.insert(block->label);
+    }
+
+    auto name = [&](int reg) {
+        std::string hint = reg_names[reg];
+        if (hint.empty())
+        {
+            return;
+        }
+
+        std::string unique = hint;
+        while (used.count(unique))
+        {
+            unique = hint + "." + std::to_string(suffix[hint]++);
+        }
+        used.insert(unique);
+        names[reg] = unique;
+    };
+
+    for (auto &param : params)
+    {
+        name(param.reg);
+    }
+
+    for (auto &block : blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                name(instr.result.reg);
+            }
+        }
+    }
+
+    return names;
+}
+
+ir_block *ir_function::addBlock(std::string label)
+{
+    blocks.emplace_back(new ir_block());
+    blocks.back()->label = label;
+    return blocks.back().get();
+}
+
+void ir_function::replaceUses(int from, ir_value to)
+{
+    for (auto &block : blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            for (auto &operand : instr.operands)
+            {
+                if (operand.kind == VAL_REG && operand.reg == from)
+                {
+                    operand = to;
+                }
+            }
+        }
+    }
+}
+
+IRModule::IRModule()
+{
+#if defined(__x86_64__) && defined(__linux__)
+    m_triple = "x86_64-pc-linux-gnu";
+    m_datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-"
+                   "n8:16:32:64-S128";
+#elif defined(__aarch64__) && defined(__linux__)
+    m_triple = "aarch64-unknown-linux-gnu";
+    m_datalayout = "e-m:e-i8:8:32-i16:16:32-i64:64-i128:128-n32:64-S128";
+#endif
+}
+
+ir_global &IRModule::addGlobal(std::string name, irType type, ir_value init)
+{
+    m_globals.push_back({name, type, init});
+    return m_globals.back();
+}
+
+ir_function *IRModule::addFunction(std::string name, irType return_type)
+{
+    m_functions.emplace_back(new ir_function());
+    m_functions.back()->name = name;
+    m_functions.back()->return_type = return_type;
+    return m_functions.back().get();
+}
+
+std::vector<ir_global> &IRModule::getGlobals() { return m_globals; }
+
+ir_global *IRModule::getGlobal(std::string name)
+{
+    for (auto &global : m_globals)
+    {
+        if (global.name == name)
+        {
+            return &global;
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<std::unique_ptr<ir_function>> &IRModule::getFunctions()
+{
+    return m_functions;
+}
+
+ir_function *IRModule::getFunction(std::string name)
+{
+    for (auto &function : m_functions)
+    {
+        if (function->name == name)
+        {
+            return function.get();
+        }
+    }
+
+    return nullptr;
+}
+
+std::string IRModule::getTriple() { return m_triple; }
+
+std::string IRModule::getDataLayout() { return m_datalayout; }
+
+irType toIRType(dataType type)
+{
+    switch (type)
+    {
+    case T_INT:
+        return IR_I32;
+    case T_FLOAT:
+        return IR_FLOAT;
+    default:
+        return IR_VOID;
+    }
+}
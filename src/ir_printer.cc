@@ -0,0 +1,425 @@
+#include "../lib/ir_printer.hh"
+#include <cstring>
+
+static const size_t g_buffer_size = 1 << 16;
+
+// Indexed by irType and irOpcode
+static const char *const g_type_names[] = {"void",  "i1",     "i32",
+                                           "float", "double", "i64"};
+
+static const char *const g_opcode_names[] = {
+    "add",    "sub",     "mul",  "sdiv",  "srem", "fadd",
+    "fsub",   "fmul",    "fdiv", "and",   "or",   "xor",
+    "shl",    "ashr",    "icmp", "fcmp",  "zext", "sitofp",
+    "fptosi", "fptrunc", "sext", "trunc", "load", "store",
+    "call",   "phi",     "br",   "br",    "ret",  "unreachable"};
+
+IRPrinter::IRPrinter(std::ostream &out)
+    : m_out(out), m_buffer(g_buffer_size), m_used(0)
+{
+}
+
+IRPrinter::~IRPrinter() { flush(); }
+
+void IRPrinter::flush()
+{
+    if (m_used != 0)
+    {
+        m_out.write(m_buffer.data(), m_used);
+        m_used = 0;
+    }
+}
+
+// Makes room for size more bytes, only a name longer than the whole buffer
+// grows it
+void IRPrinter::reserve(size_t size)
+{
+    if (m_used + size > m_buffer.size())
+    {
+        flush();
+        if (size > m_buffer.size())
+        {
+            m_buffer.resize(size);
+        }
+    }
+}
+
+void IRPrinter::put(char c)
+{
+    reserve(1);
+    m_buffer[m_used++] = c;
+}
+
+void IRPrinter::put(const char *text, size_t length)
+{
+    reserve(length);
+    std::memcpy(m_buffer.data() + m_used, text, length);
+    m_used += length;
+}
+
+void IRPrinter::put(const char *text) { put(text, std::strlen(text)); }
+
+void IRPrinter::put(const std::string &text) { put(text.data(), text.size()); }
+
+void IRPrinter::putNumber(long long value)
+{
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+    unsigned long long magnitude =
+        value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                  : static_cast<unsigned long long>(value);
+
+    do
+    {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0)
+    {
+        *--start = '-';
+    }
+
+    put(start, end - start);
+}
+
+void IRPrinter::putHex(uint64_t value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char digits[18] = {'0', 'x'};
+
+    for (int i = 0; i < 16; i++)
+    {
+        digits[17 - i] = hex[(value >> (4 * i)) & 0xF];
+    }
+
+    put(digits, sizeof(digits));
+}
+
+// Unnamed registers are numbered in the order they are printed
+void IRPrinter::nameRegisters(ir_function &function)
+{
+    unsigned int number = 0;
+
+    m_names = function.uniqueNames();
+    m_numbers.assign(function.reg_names.size(), 0);
+
+    auto name = [&](int reg) {
+        if (m_names[reg].empty())
+        {
+            m_numbers[reg] = number++;
+        }
+    };
+
+    for (auto &param : function.params)
+    {
+        name(param.reg);
+    }
+
+    for (auto &block : function.blocks)
+    {
+        for (auto &instr : block->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                name(instr.result.reg);
+            }
+        }
+    }
+}
+
+void IRPrinter::putType(irType type) { put(g_type_names[type]); }
+
+// LLVM takes any float constant exactly as the hex bits of the equal double
+void IRPrinter::putValue(const ir_value &value)
+{
+    switch (value.kind)
+    {
+    case VAL_REG:
+        put('%');
+        if (m_names[value.reg].empty())
+        {
+            putNumber(m_numbers[value.reg]);
+        }
+        else
+        {
+            put(m_names[value.reg]);
+        }
+        break;
+    case VAL_INT:
+        putNumber(value.ivalue);
+        break;
+    case VAL_FLOAT:
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value.fvalue, sizeof(bits));
+        putHex(bits);
+        break;
+    }
+    case VAL_GLOBAL:
+        put('@');
+        put(value.global);
+        break;
+    default:
+        break;
+    }
+}
+
+void IRPrinter::putTypedValue(const ir_value &value)
+{
+    putType(value.type);
+    put(' ');
+    putValue(value);
+}
+
+void IRPrinter::putFlags(ir_instruction &instr)
+{
+    if (instr.nsw)
+    {
+        put(" nsw");
+    }
+    if (instr.fast)
+    {
+        put(" fast");
+    }
+}
+
+void IRPrinter::printInstruction(ir_instruction &instr)
+{
+    put('\t');
+    if (instr.result.kind == VAL_REG)
+    {
+        putValue(instr.result);
+        put(" = ");
+    }
+
+    switch (instr.op)
+    {
+    case OP_ICMP:
+    case OP_FCMP:
+        put(g_opcode_names[instr.op]);
+        putFlags(instr);
+        put(' ');
+        put(instr.predicate);
+        put(' ');
+        putTypedValue(instr.operands[0]);
+        put(", ");
+        putValue(instr.operands[1]);
+        break;
+    case OP_ZEXT:
+    case OP_SITOFP:
+    case OP_FPTOSI:
+    case OP_FPTRUNC:
+    case OP_SEXT:
+    case OP_TRUNC:
+        put(g_opcode_names[instr.op]);
+        put(' ');
+        putTypedValue(instr.operands[0]);
+        put(" to ");
+        putType(instr.result.type);
+        break;
+    case OP_LOAD:
+        put("load ");
+        putType(instr.result.type);
+        put(", ");
+        putType(instr.operands[0].type);
+        put("* ");
+        putValue(instr.operands[0]);
+        break;
+    case OP_STORE:
+        put("store ");
+        putTypedValue(instr.operands[0]);
+        put(", ");
+        putType(instr.operands[1].type);
+        put("* ");
+        putValue(instr.operands[1]);
+        break;
+    case OP_CALL:
+        if (instr.tail == MUST_TAIL_CALL)
+        {
+            put("musttail ");
+        }
+        else if (instr.tail == TAIL_CALL)
+        {
+            put("tail ");
+        }
+
+        put("call ");
+        putType(instr.result.type);
+        put(" @");
+        put(instr.callee);
+        put('(');
+        for (size_t i = 0; i < instr.operands.size(); i++)
+        {
+            if (i != 0)
+            {
+                put(", ");
+            }
+            putTypedValue(instr.operands[i]);
+        }
+        put(')');
+        break;
+    case OP_PHI:
+        put("phi ");
+        putType(instr.result.type);
+        put(' ');
+        for (size_t i = 0; i < instr.operands.size(); i++)
+        {
+            if (i != 0)
+            {
+                put(", ");
+            }
+            put("[ ");
+            putValue(instr.operands[i]);
+            put(", %");
+            put(instr.targets[i]->label);
+            put(" ]");
+        }
+        break;
+    case OP_BR:
+        put("br label %");
+        put(instr.targets[0]->label);
+        break;
+    case OP_COND_BR:
+        put("br ");
+        putTypedValue(instr.operands[0]);
+        put(", label %");
+        put(instr.targets[0]->label);
+        put(", label %");
+        put(instr.targets[1]->label);
+        break;
+    case OP_RET:
+        if (instr.operands.empty())
+        {
+            put("ret void");
+        }
+        else
+        {
+            put("ret ");
+            putTypedValue(instr.operands[0]);
+        }
+        break;
+    case OP_UNREACHABLE:
+        put("unreachable");
+        break;
+    default:
+        // Binary arithmetic
+        put(g_opcode_names[instr.op]);
+        putFlags(instr);
+        put(' ');
+        putTypedValue(instr.operands[0]);
+        put(", ");
+        putValue(instr.operands[1]);
+        break;
+    }
+
+    put('\n');
+}
+
+void IRPrinter::writeFunction(ir_function &function)
+{
+    nameRegisters(function);
+
+    put("define ");
+    putType(function.return_type);
+    put(" @");
+    put(function.name);
+    put('(');
+    for (size_t i = 0; i < function.params.size(); i++)
+    {
+        if (i != 0)
+        {
+            put(", ");
+        }
+        putTypedValue(function.params[i]);
+    }
+    put(')');
+    for (auto &attribute : function.attributes)
+    {
+        put(' ');
+        put(attribute);
+    }
+    put(" {\n");
+
+    for (size_t i = 0; i < function.blocks.size(); i++)
+    {
+        ir_block &block = *function.blocks[i];
+
+        if (i != 0)
+        {
+            put('\n');
+        }
+        put(block.label);
+        put(":\n");
+
+        for (auto &instr : block.instructions)
+        {
+            printInstruction(instr);
+        }
+    }
+
+    put("}\n");
+}
+
+void IRPrinter::printFunction(ir_function &function)
+{
+    put('\n');
+    writeFunction(function);
+    flush();
+}
+
+void IRPrinter::writeHeader(IRModule &module)
+{
+    if (!module.getDataLayout().empty())
+    {
+        put("target datalayout = \"");
+        put(module.getDataLayout());
+        put("\"\n");
+    }
+    if (!module.getTriple().empty())
+    {
+        put("target triple = \"");
+        put(module.getTriple());
+        put("\"\n\n");
+    }
+}
+
+void IRPrinter::writeGlobals(IRModule &module)
+{
+    for (auto &global : module.getGlobals())
+    {
+        put('@');
+        put(global.name);
+        put(" = global ");
+        putTypedValue(global.init);
+        put('\n');
+    }
+}
+
+void IRPrinter::print(IRModule &module)
+{
+    writeHeader(module);
+    writeGlobals(module);
+
+    for (auto &function : module.getFunctions())
+    {
+        put('\n');
+        writeFunction(*function);
+    }
+
+    flush();
+}
+
+void IRPrinter::printHeader(IRModule &module)
+{
+    writeHeader(module);
+    flush();
+}
+
+void IRPrinter::printGlobals(IRModule &module)
+{
+    put('\n');
+    writeGlobals(module);
+    flush();
+}
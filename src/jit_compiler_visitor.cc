@@ -0,0 +1,1491 @@
+#include "../lib/jit_compiler_visitor.hh"
+#include "../lib/native_stack.hh"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+
+// System V argument registers: edi, esi, edx, ecx, r8d, r9d
+static const uint8_t g_int_arg_regs[] = {7, 6, 2, 1, 8, 9};
+static const size_t g_max_int_args = 6;
+static const size_t g_max_float_args = 8;
+
+// Native stack of one generated call next to its frame: the return address,
+// rbp and alignment. Every level of nesting may hold a pending operand and
+// the padding that keeps a call aligned.
+static const size_t g_stack_per_call = 32;
+static const size_t g_stack_per_level = 16;
+
+long JitCompilerVisitor::s_call_budget = 10000;
+size_t JitCompilerVisitor::s_max_call_depth = 10000;
+char *JitCompilerVisitor::s_stack_limit = nullptr;
+
+JitCompilerVisitor::JitCompilerVisitor()
+{
+    m_last_type = T_VOID;
+    m_return_type = T_VOID;
+    m_frame_size = 0;
+    m_push_depth = 0;
+    m_return_label = -1;
+    m_frame_patch = 0;
+    m_largest_frame = 0;
+    m_nesting = 0;
+    m_memory = nullptr;
+    m_memory_size = 0;
+    m_share_globals = false;
+
+    // _init_globals gets a frame so its pushes stay aligned for calls
+    m_code = &m_init;
+    emit({0x55});             // push rbp
+    emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+    m_code = &m_text;
+}
+
+JitCompilerVisitor::~JitCompilerVisitor()
+{
+    if (m_memory != nullptr)
+    {
+        munmap(m_memory, m_memory_size);
+    }
+}
+
+void JitCompilerVisitor::jitError(std::string s)
+{
+    std::cerr << "JIT Error: " << s << std::endl;
+    exit(1);
+}
+
+void JitCompilerVisitor::callLimitReached(const char *name)
+{
+    if (s_call_budget < 0)
+    {
+        std::cerr << "Runtime Error: Maximum call depth of " << s_max_call_depth
+                  << " exceeded calling \"" << name << "\"" << std::endl;
+    }
+    else
+    {
+        std::cerr << "Runtime Error: Out of stack space at call depth "
+                  << s_max_call_depth - s_call_budget - 1 << " calling \""
+                  << name << "\"" << std::endl;
+    }
+    exit(1);
+}
+
+void JitCompilerVisitor::divisionByZero()
+{
+    std::cerr << "Runtime Error: Cant divide with 0" << std::endl;
+    exit(1);
+}
+
+// --- Encoding helpers ---
+
+void JitCompilerVisitor::emit(std::initializer_list<uint8_t> bytes)
+{
+    m_code->bytes.insert(m_code->bytes.end(), bytes);
+}
+
+void JitCompilerVisitor::emitInt32(int32_t value)
+{
+    uint32_t bits = static_cast<uint32_t>(value);
+    for (int i = 0; i < 4; i++)
+    {
+        m_code->bytes.push_back((bits >> (8 * i)) & 0xFF);
+    }
+}
+
+void JitCompilerVisitor::emitInt64(uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        m_code->bytes.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+int JitCompilerVisitor::newLabel()
+{
+    m_code->labels.push_back(-1);
+    return m_code->labels.size() - 1;
+}
+
+void JitCompilerVisitor::bindLabel(int label)
+{
+    m_code->labels[label] = m_code->bytes.size();
+}
+
+void JitCompilerVisitor::emitJump(std::initializer_list<uint8_t> opcode,
+                                  int label)
+{
+    emit(opcode);
+    m_code->label_fixups.push_back({m_code->bytes.size(), label});
+    emitInt32(0);
+}
+
+void JitCompilerVisitor::resolveLabels(code_buffer &code)
+{
+    for (auto &fixup : code.label_fixups)
+    {
+        int32_t rel = code.labels[fixup.label] - (fixup.offset + 4);
+        std::memcpy(&code.bytes[fixup.offset], &rel, 4);
+    }
+
+    code.label_fixups.clear();
+}
+
+// --- Value movement ---
+
+void JitCompilerVisitor::push()
+{
+    if (m_last_type == T_FLOAT)
+    {
+        emit({0x66, 0x0F, 0x7E, 0xC0}); // movd eax, xmm0
+    }
+    emit({0x50}); // push rax
+    m_push_depth++;
+}
+
+void JitCompilerVisitor::popInto(dataType type)
+{
+    emit({0x58}); // pop rax
+    if (type == T_FLOAT)
+    {
+        emit({0x66, 0x0F, 0x6E, 0xC0}); // movd xmm0, eax
+    }
+    m_push_depth--;
+    m_last_type = type;
+}
+
+bool JitCompilerVisitor::isGlobal(VarSymbol *sym)
+{
+    return SymbolTable::getInstance()->lookupGlobal(sym->getName()) == sym;
+}
+
+VarSymbol *JitCompilerVisitor::lookupVariable(std::string name)
+{
+    VarSymbol *sym =
+        dynamic_cast<VarSymbol *>(SymbolTable::getInstance()->lookup(name));
+
+    if (!sym)
+    {
+        jitError("Variable \"" + name + "\" is not declared");
+    }
+
+    return sym;
+}
+
+void JitCompilerVisitor::globalAddress(VarSymbol *sym)
+{
+    emit({0x49, 0xBB}); // movabs r11, imm64
+    m_code->global_fixups.push_back({m_code->bytes.size(), sym->getSlot()});
+    emitInt64(0);
+}
+
+void JitCompilerVisitor::loadVariable(VarSymbol *sym)
+{
+    m_last_type = sym->getValueType();
+
+    if (isGlobal(sym))
+    {
+        globalAddress(sym);
+        if (m_last_type == T_FLOAT)
+        {
+            emit({0xF3, 0x41, 0x0F, 0x10, 0x03}); // movss xmm0, [r11]
+        }
+        else
+        {
+            emit({0x41, 0x8B, 0x03}); // mov eax, [r11]
+        }
+        return;
+    }
+
+    if (m_last_type == T_FLOAT)
+    {
+        emit({0xF3, 0x0F, 0x10, 0x85}); // movss xmm0, [rbp+disp32]
+    }
+    else
+    {
+        emit({0x8B, 0x85}); // mov eax, [rbp+disp32]
+    }
+    emitInt32(sym->getSlot());
+}
+
+void JitCompilerVisitor::storeVariable(VarSymbol *sym)
+{
+    if (isGlobal(sym))
+    {
+        globalAddress(sym);
+        if (sym->getValueType() == T_FLOAT)
+        {
+            emit({0xF3, 0x41, 0x0F, 0x11, 0x03}); // movss [r11], xmm0
+        }
+        else
+        {
+            emit({0x41, 0x89, 0x03}); // mov [r11], eax
+        }
+        return;
+    }
+
+    if (sym->getValueType() == T_FLOAT)
+    {
+        emit({0xF3, 0x0F, 0x11, 0x85}); // movss [rbp+disp32], xmm0
+    }
+    else
+    {
+        emit({0x89, 0x85}); // mov [rbp+disp32], eax
+    }
+    emitInt32(sym->getSlot());
+}
+
+// Same promotions as the IR emitter: sitofp / fptosi
+void JitCompilerVisitor::convert(dataType from, dataType to)
+{
+    if (from == T_INT && to == T_FLOAT)
+    {
+        emit({0xF3, 0x0F, 0x2A, 0xC0}); // cvtsi2ss xmm0, eax
+    }
+    else if (from == T_FLOAT && to == T_INT)
+    {
+        emit({0xF3, 0x0F, 0x2C, 0xC0}); // cvttss2si eax, xmm0
+    }
+
+    if (to != T_VOID)
+    {
+        m_last_type = to;
+    }
+}
+
+// Leaves a C truth value in eax (non zero means true)
+void JitCompilerVisitor::truthValue()
+{
+    if (m_last_type == T_FLOAT)
+    {
+        emit({0x0F, 0x57, 0xC9});       // xorps xmm1, xmm1
+        emit({0x0F, 0x2E, 0xC1});       // ucomiss xmm0, xmm1
+        emit({0x0F, 0x95, 0xC0});       // setne al
+        emit({0x0F, 0x9A, 0xC1});       // setp cl
+        emit({0x08, 0xC8});             // or al, cl
+        emit({0x0F, 0xB6, 0xC0});       // movzx eax, al
+    }
+    m_last_type = T_INT;
+}
+
+// --- Node shapes ---
+
+// Evaluates both operands, left ends in eax/xmm0 and right in ecx/xmm1
+dataType JitCompilerVisitor::binaryOperands(STNode *node, bool integer_only)
+{
+    node->getChildrenList().front()->accept(*this);
+    dataType left_type = m_last_type;
+    if (integer_only)
+    {
+        convert(left_type, T_INT);
+        left_type = T_INT;
+    }
+    push();
+
+    node->getChildrenList().back()->accept(*this);
+    dataType right_type = m_last_type;
+
+    dataType op_type = T_INT;
+    if (!integer_only && (left_type == T_FLOAT || right_type == T_FLOAT))
+    {
+        op_type = T_FLOAT;
+    }
+
+    convert(right_type, op_type);
+    if (op_type == T_FLOAT)
+    {
+        emit({0x0F, 0x28, 0xC8}); // movaps xmm1, xmm0
+    }
+    else
+    {
+        emit({0x89, 0xC1}); // mov ecx, eax
+    }
+
+    popInto(left_type);
+    convert(left_type, op_type);
+
+    return op_type;
+}
+
+// idiv by 0 would raise SIGFPE, report it like the interpreter does. The
+// handler never returns, so rsp is simply aligned down for it.
+void JitCompilerVisitor::checkDivisor()
+{
+    emit({0x85, 0xC9});             // test ecx, ecx
+    emit({0x75, 16});               // jnz past the error call
+    emit({0x48, 0x83, 0xE4, 0xF0}); // and rsp, -16
+    emit({0x48, 0xB8});             // mov rax, imm64
+    emitInt64(reinterpret_cast<uint64_t>(&divisionByZero));
+    emit({0xFF, 0xD0}); // call rax
+}
+
+// eax = eax op ecx, or xmm0 = xmm0 op xmm1
+void JitCompilerVisitor::applyOperator(nodeType op, dataType type)
+{
+    bool is_float = type == T_FLOAT;
+
+    switch (op)
+    {
+    case ADDITION_NODE:
+        is_float ? emit({0xF3, 0x0F, 0x58, 0xC1}) : emit({0x01, 0xC8});
+        break;
+    case SUBTRACTION_NODE:
+        is_float ? emit({0xF3, 0x0F, 0x5C, 0xC1}) : emit({0x29, 0xC8});
+        break;
+    case MULTIPLICATION_NODE:
+        is_float ? emit({0xF3, 0x0F, 0x59, 0xC1}) : emit({0x0F, 0xAF, 0xC1});
+        break;
+    case DIVISION_NODE:
+        if (is_float)
+        {
+            emit({0xF3, 0x0F, 0x5E, 0xC1});
+            break;
+        }
+        checkDivisor();
+        emit({0x99, 0xF7, 0xF9}); // cdq; idiv ecx
+        break;
+    case MOD_NODE:
+        checkDivisor();
+        emit({0x99, 0xF7, 0xF9, 0x89, 0xD0}); // cdq; idiv ecx; mov eax, edx
+        break;
+    case BIT_WISE_AND_NODE:
+        emit({0x21, 0xC8});
+        break;
+    case BIT_WISE_OR_NODE:
+        emit({0x09, 0xC8});
+        break;
+    case BIT_WISE_XOR_NODE:
+        emit({0x31, 0xC8});
+        break;
+    case SHIFT_LEFT_NODE:
+        emit({0xD3, 0xE0}); // shl eax, cl
+        break;
+    case SHIFT_RIGHT_NODE:
+        emit({0xD3, 0xF8}); // sar eax, cl
+        break;
+    case LESS_NODE:
+    case LESS_EQUALS_NODE:
+    case GREATER_NODE:
+    case GREATER_EQUALS_NODE:
+    case LOGIC_EQUALS_NODE:
+    case LOGIC_NOT_EQUALS_NODE:
+        comparison(op, type);
+        return;
+    default:
+        jitError("Unsupported operator");
+    }
+
+    m_last_type = type;
+}
+
+void JitCompilerVisitor::comparison(nodeType op, dataType type)
+{
+    if (type == T_FLOAT)
+    {
+        // ucomiss reports unordered as "below or equal", so less-than is
+        // written as a swapped above to keep NaN comparisons false
+        switch (op)
+        {
+        case LESS_NODE:
+            emit({0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0}); // ucomiss 1,0; seta
+            break;
+        case LESS_EQUALS_NODE:
+            emit({0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0}); // ucomiss 1,0; setae
+            break;
+        case GREATER_NODE:
+            emit({0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0}); // ucomiss 0,1; seta
+            break;
+        case GREATER_EQUALS_NODE:
+            emit({0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0}); // ucomiss 0,1; setae
+            break;
+        case LOGIC_EQUALS_NODE:
+            emit({0x0F, 0x2E, 0xC1, 0x0F, 0x94, 0xC0}); // sete al
+            emit({0x0F, 0x9B, 0xC1, 0x20, 0xC8}); // setnp cl; and al, cl
+            break;
+        default:
+            emit({0x0F, 0x2E, 0xC1, 0x0F, 0x95, 0xC0}); // setne al
+            emit({0x0F, 0x9A, 0xC1, 0x08, 0xC8});       // setp cl; or al, cl
+            break;
+        }
+    }
+    else
+    {
+        uint8_t cc = 0x95;
+        switch (op)
+        {
+        case LESS_NODE:
+            cc = 0x9C;
+            break;
+        case LESS_EQUALS_NODE:
+            cc = 0x9E;
+            break;
+        case GREATER_NODE:
+            cc = 0x9F;
+            break;
+        case GREATER_EQUALS_NODE:
+            cc = 0x9D;
+            break;
+        case LOGIC_EQUALS_NODE:
+            cc = 0x94;
+            break;
+        default:
+            break;
+        }
+        emit({0x39, 0xC8, 0x0F, cc, 0xC0}); // cmp eax, ecx; setcc al
+    }
+
+    emit({0x0F, 0xB6, 0xC0}); // movzx eax, al
+    m_last_type = T_INT;
+}
+
+void JitCompilerVisitor::binary(STNode *node, nodeType op, bool integer_only)
+{
+    dataType type = binaryOperands(node, integer_only);
+    applyOperator(op, type);
+}
+
+void JitCompilerVisitor::compoundAssignment(STNode *node, nodeType op)
+{
+    auto it = node->getChildrenList().begin();
+    VarSymbol *sym =
+        lookupVariable(static_cast<IDENTIFIER *>(*it)->getLabel());
+    dataType type = sym->getValueType();
+
+    it++;
+    (*it)->accept(*this);
+
+    // x op= e computes in the promoted type of x and e, then converts back
+    dataType op_type = T_INT;
+    if (op != MOD_NODE && (type == T_FLOAT || m_last_type == T_FLOAT))
+    {
+        op_type = T_FLOAT;
+    }
+    convert(m_last_type, op_type);
+
+    if (op_type == T_FLOAT)
+    {
+        emit({0x0F, 0x28, 0xC8}); // movaps xmm1, xmm0
+    }
+    else
+    {
+        emit({0x89, 0xC1}); // mov ecx, eax
+    }
+
+    loadVariable(sym);
+    convert(type, op_type);
+    applyOperator(op, op_type);
+    convert(op_type, type);
+    storeVariable(sym);
+}
+
+void JitCompilerVisitor::increment(STNode *node, bool add, bool prefix)
+{
+    VarSymbol *sym = lookupVariable(
+        static_cast<IDENTIFIER *>(node->getChildrenList().front())
+            ->getLabel());
+    dataType type = sym->getValueType();
+
+    loadVariable(sym);
+    if (!prefix)
+    {
+        push();
+    }
+
+    if (type == T_FLOAT)
+    {
+        emit({0xB9});
+        emitInt32(0x3F800000);          // mov ecx, 1.0f
+        emit({0x66, 0x0F, 0x6E, 0xC9}); // movd xmm1, ecx
+        applyOperator(add ? ADDITION_NODE : SUBTRACTION_NODE, T_FLOAT);
+    }
+    else
+    {
+        add ? emit({0x83, 0xC0, 0x01}) : emit({0x83, 0xE8, 0x01});
+    }
+    storeVariable(sym);
+
+    if (!prefix)
+    {
+        popInto(type);
+    }
+    m_last_type = type;
+}
+
+void JitCompilerVisitor::prologue(std::vector<parameter> &params,
+                                  const std::string &name)
+{
+    emit({0x55});                   // push rbp
+    emit({0x48, 0x89, 0xE5});       // mov rbp, rsp
+
+    // Take a call from the budget and check the stack, rsp is 16 byte
+    // aligned for the error call
+    emit({0x49, 0xBB}); // mov r11, imm64
+    emitInt64(reinterpret_cast<uint64_t>(&s_call_budget));
+    emit({0x49, 0x83, 0x2B, 0x01}); // sub qword [r11], 1
+    emit({0x78, 15});               // js to the error call
+    emit({0x49, 0xBB});             // mov r11, imm64
+    emitInt64(reinterpret_cast<uint64_t>(&s_stack_limit));
+    emit({0x49, 0x3B, 0x23}); // cmp rsp, [r11]
+    emit({0x73, 22});         // jae past the error call
+    emit({0x48, 0xBF});       // mov rdi, imm64
+    emitInt64(reinterpret_cast<uint64_t>(name.c_str()));
+    emit({0x48, 0xB8}); // mov rax, imm64
+    emitInt64(reinterpret_cast<uint64_t>(&callLimitReached));
+    emit({0xFF, 0xD0}); // call rax
+
+    emit({0x48, 0x81, 0xEC});       // sub rsp, imm32
+    m_frame_patch = m_code->bytes.size();
+    emitInt32(0);
+
+    size_t int_count = 0;
+    size_t float_count = 0;
+    // Parameters without a register follow the return address
+    int32_t stack_offset = 16;
+
+    for (auto &param : params)
+    {
+        m_frame_size += 8;
+        VarSymbol *sym = new VarSymbol(0, param.name, param.type);
+        sym->setSlot(-m_frame_size);
+        SymbolTable::getInstance()->insert(sym);
+
+        uint8_t modrm;
+        if (param.type == T_FLOAT && float_count < g_max_float_args)
+        {
+            modrm = 0x85 | (float_count++ << 3);
+            emit({0xF3, 0x0F, 0x11, modrm}); // movss [rbp+disp32], xmmN
+        }
+        else if (param.type != T_FLOAT && int_count < g_max_int_args)
+        {
+            uint8_t reg = g_int_arg_regs[int_count++];
+            modrm = 0x85 | ((reg & 7) << 3);
+            if (reg >= 8)
+            {
+                emit({0x44}); // REX.R for r8d/r9d
+            }
+            emit({0x89, modrm}); // mov [rbp+disp32], reg
+        }
+        else
+        {
+            emit({0x8B, 0x85}); // mov eax, [rbp+disp32]
+            emitInt32(stack_offset);
+            stack_offset += 8;
+            emit({0x89, 0x85}); // mov [rbp+disp32], eax
+        }
+        emitInt32(-m_frame_size);
+    }
+}
+
+// Gives the call back and drops the frame, the return address is on top
+void JitCompilerVisitor::epilogue()
+{
+    emit({0x49, 0xBB}); // mov r11, imm64
+    emitInt64(reinterpret_cast<uint64_t>(&s_call_budget));
+    emit({0x49, 0x83, 0x03, 0x01}); // add qword [r11], 1
+    emit({0x48, 0x89, 0xEC});       // mov rsp, rbp
+    emit({0x5D});                   // pop rbp
+}
+
+void JitCompilerVisitor::finalize()
+{
+    // Close _init_globals
+    m_code = &m_init;
+    emit({0x48, 0x89, 0xEC}); // mov rsp, rbp
+    emit({0x5D, 0xC3});       // pop rbp; ret
+    m_code = &m_text;
+
+    resolveLabels(m_text);
+    resolveLabels(m_init);
+
+    size_t init_base = m_text.bytes.size();
+    size_t code_size = init_base + m_init.bytes.size();
+    size_t page = sysconf(_SC_PAGESIZE);
+    m_memory_size = (code_size + page - 1) / page * page;
+
+    void *mem = mmap(nullptr, m_memory_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        jitError("Cannot map memory for generated code");
+    }
+    m_memory = static_cast<uint8_t *>(mem);
+
+    std::memcpy(m_memory, m_text.bytes.data(), m_text.bytes.size());
+    std::memcpy(m_memory + init_base, m_init.bytes.data(),
+                m_init.bytes.size());
+
+    m_global_data.assign(m_globals.size(), 0);
+
+    code_buffer *buffers[] = {&m_text, &m_init};
+    size_t bases[] = {0, init_base};
+    for (int b = 0; b < 2; b++)
+    {
+        for (auto &fixup : buffers[b]->call_fixups)
+        {
+            auto target = m_functions.find(fixup.name);
+            if (target == m_functions.end())
+            {
+                jitError("Undefined reference to \"" + fixup.name + "\"");
+            }
+
+            size_t at = bases[b] + fixup.offset;
+            int32_t rel = target->second - (at + 4);
+            std::memcpy(m_memory + at, &rel, 4);
+        }
+
+        for (auto &fixup : buffers[b]->global_fixups)
+        {
+            Value *storage = m_share_globals
+                                 ? m_globals[fixup.index]->getValueAddress()
+                                 : reinterpret_cast<Value *>(
+                                       &m_global_data[fixup.index]);
+            uint64_t addr = reinterpret_cast<uint64_t>(storage);
+            std::memcpy(m_memory + bases[b] + fixup.offset, &addr, 8);
+        }
+    }
+
+    if (mprotect(m_memory, m_memory_size, PROT_READ | PROT_EXEC) != 0)
+    {
+        jitError("Cannot make generated code executable");
+    }
+
+    reinterpret_cast<void (*)()>(m_memory + init_base)();
+}
+
+void *JitCompilerVisitor::getFunctionAddress(std::string name)
+{
+    auto it = m_functions.find(name);
+    if (m_memory == nullptr || it == m_functions.end())
+    {
+        return nullptr;
+    }
+
+    return m_memory + it->second;
+}
+
+int JitCompilerVisitor::runMain()
+{
+    int (*entry)() = getFunction<int (*)()>("main");
+    if (entry == nullptr)
+    {
+        std::cerr << "Linker Error: Undefined reference to \"main\""
+                  << std::endl;
+        exit(1);
+    }
+
+    // Runs on a thread whose stack fits the call depth limit, the prologues
+    // check against that thread's stack
+    size_t size = NativeStack::sizeFor(s_max_call_depth,
+                                       g_stack_per_call + m_largest_frame,
+                                       m_nesting, g_stack_per_level);
+    std::pair<int (*)(), int> job = {entry, 0};
+
+    bool started = NativeStack::run(
+        size,
+        [](void *arg) -> void * {
+            auto job = static_cast<std::pair<int (*)(), int> *>(arg);
+            setCallBudget(s_max_call_depth);
+            job->second = job->first();
+            return nullptr;
+        },
+        &job);
+
+    if (!started)
+    {
+        std::cerr << "Runtime Error: Cannot allocate a stack for "
+                  << s_max_call_depth << " calls" << std::endl;
+        exit(1);
+    }
+
+    return job.second;
+}
+
+void JitCompilerVisitor::setMaxCallDepth(size_t depth)
+{
+    s_max_call_depth = depth;
+    s_call_budget = depth;
+}
+
+void JitCompilerVisitor::setCallBudget(size_t calls)
+{
+    s_call_budget = calls;
+    s_stack_limit = NativeStack::limit();
+}
+
+void JitCompilerVisitor::shareGlobals() { m_share_globals = true; }
+
+void JitCompilerVisitor::restrictTo(std::unordered_set<std::string> names)
+{
+    m_only = names;
+}
+
+// --- VISITORS ---
+
+void JitCompilerVisitor::visitIDENTIFIER(IDENTIFIER *node)
+{
+    loadVariable(lookupVariable(node->getLabel()));
+}
+
+void JitCompilerVisitor::visitNUMBER(NUMBER *node)
+{
+    if (node->getResolvedType() == T_FLOAT)
+    {
+        float value = node->getFValue();
+        int32_t bits;
+        std::memcpy(&bits, &value, 4);
+
+        emit({0xB8});
+        emitInt32(bits);                // mov eax, imm32
+        emit({0x66, 0x0F, 0x6E, 0xC0}); // movd xmm0, eax
+        m_last_type = T_FLOAT;
+    }
+    else
+    {
+        emit({0xB8});
+        emitInt32(node->getIValue()); // mov eax, imm32
+        m_last_type = T_INT;
+    }
+}
+
+void JitCompilerVisitor::visitAddition(addition *node)
+{
+    binary(node, ADDITION_NODE, false);
+}
+
+void JitCompilerVisitor::visitSubtraction(subtraction *node)
+{
+    binary(node, SUBTRACTION_NODE, false);
+}
+
+void JitCompilerVisitor::visitMultiplication(multiplication *node)
+{
+    binary(node, MULTIPLICATION_NODE, false);
+}
+
+void JitCompilerVisitor::visitDivision(division *node)
+{
+    binary(node, DIVISION_NODE, false);
+}
+
+void JitCompilerVisitor::visitMod(mod *node) { binary(node, MOD_NODE, true); }
+
+void JitCompilerVisitor::visitLess(less *node)
+{
+    binary(node, LESS_NODE, false);
+}
+
+void JitCompilerVisitor::visitLessEquals(less_equals *node)
+{
+    binary(node, LESS_EQUALS_NODE, false);
+}
+
+void JitCompilerVisitor::visitGreater(greater *node)
+{
+    binary(node, GREATER_NODE, false);
+}
+
+void JitCompilerVisitor::visitGreaterEquals(greater_equals *node)
+{
+    binary(node, GREATER_EQUALS_NODE, false);
+}
+
+void JitCompilerVisitor::visitLogicEquals(logic_equals *node)
+{
+    binary(node, LOGIC_EQUALS_NODE, false);
+}
+
+void JitCompilerVisitor::visitLogicNotEquals(logic_not_equals *node)
+{
+    binary(node, LOGIC_NOT_EQUALS_NODE, false);
+}
+
+void JitCompilerVisitor::visitLogicAnd(logic_and *node)
+{
+    int label_false = newLabel();
+    int label_end = newLabel();
+
+    node->getChildrenList().front()->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});                   // test eax, eax
+    emitJump({0x0F, 0x84}, label_false);  // jz
+
+    node->getChildrenList().back()->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});
+    emitJump({0x0F, 0x84}, label_false);
+
+    emit({0xB8});
+    emitInt32(1);
+    emitJump({0xE9}, label_end);
+
+    bindLabel(label_false);
+    emit({0xB8});
+    emitInt32(0);
+
+    bindLabel(label_end);
+    m_last_type = T_INT;
+}
+
+void JitCompilerVisitor::visitLogicOr(logic_or *node)
+{
+    int label_true = newLabel();
+    int label_end = newLabel();
+
+    node->getChildrenList().front()->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});                  // test eax, eax
+    emitJump({0x0F, 0x85}, label_true);  // jnz
+
+    node->getChildrenList().back()->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});
+    emitJump({0x0F, 0x85}, label_true);
+
+    emit({0xB8});
+    emitInt32(0);
+    emitJump({0xE9}, label_end);
+
+    bindLabel(label_true);
+    emit({0xB8});
+    emitInt32(1);
+
+    bindLabel(label_end);
+    m_last_type = T_INT;
+}
+
+void JitCompilerVisitor::visitLogicNot(logic_not *node)
+{
+    node->getChildrenList().front()->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0, 0x0F, 0x94, 0xC0}); // test eax, eax; sete al
+    emit({0x0F, 0xB6, 0xC0});             // movzx eax, al
+}
+
+void JitCompilerVisitor::visitUnaryPlus(unary_plus *node)
+{
+    node->getChildrenList().front()->accept(*this);
+}
+
+void JitCompilerVisitor::visitUnaryMinus(unary_minus *node)
+{
+    node->getChildrenList().front()->accept(*this);
+
+    if (m_last_type == T_FLOAT)
+    {
+        emit({0x66, 0x0F, 0x7E, 0xC0}); // movd eax, xmm0
+        emit({0x35});
+        emitInt32(0x80000000);          // xor eax, sign bit
+        emit({0x66, 0x0F, 0x6E, 0xC0}); // movd xmm0, eax
+    }
+    else
+    {
+        emit({0xF7, 0xD8}); // neg eax
+    }
+}
+
+void JitCompilerVisitor::visitBitWiseAnd(bit_wise_and *node)
+{
+    binary(node, BIT_WISE_AND_NODE, true);
+}
+
+void JitCompilerVisitor::visitBitWiseOr(bit_wise_or *node)
+{
+    binary(node, BIT_WISE_OR_NODE, true);
+}
+
+void JitCompilerVisitor::visitBitWiseXor(bit_wise_xor *node)
+{
+    binary(node, BIT_WISE_XOR_NODE, true);
+}
+
+void JitCompilerVisitor::visitBitWiseNot(bit_wise_not *node)
+{
+    node->getChildrenList().front()->accept(*this);
+    convert(m_last_type, T_INT);
+    emit({0xF7, 0xD0}); // not eax
+}
+
+void JitCompilerVisitor::visitShiftLeft(shift_left *node)
+{
+    binary(node, SHIFT_LEFT_NODE, true);
+}
+
+void JitCompilerVisitor::visitShiftRight(shift_right *node)
+{
+    binary(node, SHIFT_RIGHT_NODE, true);
+}
+
+void JitCompilerVisitor::visitPostfixIncrement(postfix_increment *node)
+{
+    increment(node, true, false);
+}
+
+void JitCompilerVisitor::visitPostfixDecrement(postfix_decrement *node)
+{
+    increment(node, false, false);
+}
+
+void JitCompilerVisitor::visitPrefixIncrement(prefix_increment *node)
+{
+    increment(node, true, true);
+}
+
+void JitCompilerVisitor::visitPrefixDecrement(prefix_decrement *node)
+{
+    increment(node, false, true);
+}
+
+void JitCompilerVisitor::visitAssignment(assignment *node)
+{
+    auto it = node->getChildrenList().begin();
+    VarSymbol *sym =
+        lookupVariable(static_cast<IDENTIFIER *>(*it)->getLabel());
+
+    it++;
+    (*it)->accept(*this);
+    convert(m_last_type, sym->getValueType());
+    storeVariable(sym);
+}
+
+void JitCompilerVisitor::visitPlusAssignment(plus_assignment *node)
+{
+    compoundAssignment(node, ADDITION_NODE);
+}
+
+void JitCompilerVisitor::visitMinusAssignment(minus_assignment *node)
+{
+    compoundAssignment(node, SUBTRACTION_NODE);
+}
+
+void JitCompilerVisitor::visitMulAssignment(mul_assignment *node)
+{
+    compoundAssignment(node, MULTIPLICATION_NODE);
+}
+
+void JitCompilerVisitor::visitDivAssignment(div_assignment *node)
+{
+    compoundAssignment(node, DIVISION_NODE);
+}
+
+void JitCompilerVisitor::visitModAssignment(mod_assignment *node)
+{
+    compoundAssignment(node, MOD_NODE);
+}
+
+void JitCompilerVisitor::visitVariableDeclaration(variable_declaration *node)
+{
+    auto &temp = node->getChildrenList();
+
+    if (temp.size() > 1) // var decl with expression
+    {
+        temp.back()->accept(*this);
+    }
+    else
+    {
+        m_last_type = T_VOID;
+    }
+}
+
+void JitCompilerVisitor::visitVariableDeclarationList(
+    variable_declaration_list *node)
+{
+    auto &temp = node->getChildrenList();
+    auto it = temp.begin();
+
+    if (temp.size() == 2)
+    {
+        (*it)->accept(*this);
+        it++;
+        m_vars.push_back((*it));
+    }
+    else
+    {
+        m_vars.push_back((*it));
+    }
+}
+
+void JitCompilerVisitor::visitVariableDeclarationStatement(
+    variable_declaration_statement *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    dataType current_type = static_cast<type_specifier *>(*it)->getType();
+
+    it++;
+    (*it)->accept(*this);
+
+    std::vector<STNode *> vars = m_vars;
+    m_vars.clear();
+
+    bool global = node->getParent()->getNodeType() == EXTERNAL_DECLARATION_NODE;
+
+    for (auto &var : vars)
+    {
+        std::string name =
+            static_cast<IDENTIFIER *>(var->getChildrenList().front())
+                ->getLabel();
+        VarSymbol *sym;
+
+        if (global)
+        {
+            // The type checker already owns the global symbol, the JIT only
+            // assigns its storage index and queues the initializer
+            sym = dynamic_cast<VarSymbol *>(
+                SymbolTable::getInstance()->lookupGlobal(name));
+            sym->setSlot(m_globals.size());
+            m_globals.push_back(sym);
+
+            // Shared globals were already initialized by their owner
+            if (m_share_globals)
+            {
+                continue;
+            }
+            m_code = &m_init;
+            m_push_depth = 0;
+        }
+
+        var->accept(*this);
+        bool has_value = m_last_type != T_VOID;
+
+        if (!global)
+        {
+            m_frame_size += 8;
+            sym = new VarSymbol(0, name, current_type);
+            sym->setSlot(-m_frame_size);
+            SymbolTable::getInstance()->insert(sym);
+        }
+
+        if (has_value)
+        {
+            convert(m_last_type, current_type);
+            storeVariable(sym);
+        }
+
+        m_code = &m_text;
+    }
+}
+
+void JitCompilerVisitor::visitStatement(statement *node)
+{
+    // Empty statement ";"
+    visitChildren(node);
+}
+
+void JitCompilerVisitor::visitCondition(condition *node)
+{
+    node->getChildrenList().front()->accept(*this);
+}
+
+void JitCompilerVisitor::visitIfStatement(if_statement *node)
+{
+    int label_else = newLabel();
+    int label_end = newLabel();
+
+    auto it = node->getChildrenList().begin();
+    (*it)->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});                  // test eax, eax
+    emitJump({0x0F, 0x84}, label_else);  // jz
+
+    it++;
+    (*it)->accept(*this);
+
+    if (node->getChildrenList().size() == 3)
+    {
+        emitJump({0xE9}, label_end);
+        bindLabel(label_else);
+        it++;
+        (*it)->accept(*this);
+    }
+    else
+    {
+        bindLabel(label_else);
+    }
+
+    bindLabel(label_end);
+}
+
+void JitCompilerVisitor::visitWhileStatement(while_statement *node)
+{
+    int label_cond = newLabel();
+    int label_end = newLabel();
+
+    auto it = node->getChildrenList().begin();
+    STNode *cond_node = *it;
+    it++;
+    STNode *body_node = *it;
+
+    bindLabel(label_cond);
+    cond_node->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});
+    emitJump({0x0F, 0x84}, label_end);
+
+    m_continue_stack.push(label_cond);
+    m_break_stack.push(label_end);
+
+    body_node->accept(*this);
+
+    m_continue_stack.pop();
+    m_break_stack.pop();
+
+    emitJump({0xE9}, label_cond);
+    bindLabel(label_end);
+}
+
+void JitCompilerVisitor::visitDoWhileStatement(do_while_statement *node)
+{
+    int label_body = newLabel();
+    int label_cond = newLabel();
+    int label_end = newLabel();
+
+    auto it = node->getChildrenList().begin();
+    STNode *body_node = *it;
+    it++;
+    STNode *cond_node = *it;
+
+    bindLabel(label_body);
+
+    m_continue_stack.push(label_cond);
+    m_break_stack.push(label_end);
+
+    body_node->accept(*this);
+
+    m_continue_stack.pop();
+    m_break_stack.pop();
+
+    bindLabel(label_cond);
+    cond_node->accept(*this);
+    truthValue();
+    emit({0x85, 0xC0});
+    emitJump({0x0F, 0x85}, label_body); // jnz
+
+    bindLabel(label_end);
+}
+
+void JitCompilerVisitor::visitForStatement(for_statement *node)
+{
+    int label_cond = newLabel();
+    int label_inc = newLabel();
+    int label_end = newLabel();
+
+    auto &children = node->getChildrenList();
+    auto it = children.begin();
+
+    STNode *init_node = (*it++);
+    STNode *cond_node = (*it++);
+    STNode *step_node = nullptr;
+    if (children.size() == 4)
+    {
+        step_node = (*it++);
+    }
+    STNode *body_node = (*it);
+
+    init_node->accept(*this);
+
+    bindLabel(label_cond);
+    // for (;;) has an empty statement as its condition
+    if (cond_node->getNodeType() != STATEMENT_NODE)
+    {
+        cond_node->accept(*this);
+        truthValue();
+        emit({0x85, 0xC0});
+        emitJump({0x0F, 0x84}, label_end);
+    }
+
+    m_continue_stack.push(label_inc);
+    m_break_stack.push(label_end);
+
+    body_node->accept(*this);
+
+    m_continue_stack.pop();
+    m_break_stack.pop();
+
+    bindLabel(label_inc);
+    if (step_node != nullptr)
+    {
+        step_node->accept(*this);
+    }
+    emitJump({0xE9}, label_cond);
+
+    bindLabel(label_end);
+}
+
+void JitCompilerVisitor::visitContinue(continue_node *)
+{
+    emitJump({0xE9}, m_continue_stack.top());
+}
+
+void JitCompilerVisitor::visitBreak(break_node *)
+{
+    emitJump({0xE9}, m_break_stack.top());
+}
+
+void JitCompilerVisitor::visitReturn(return_node *node)
+{
+    if (node->getTailCall() != NO_TAIL_CALL)
+    {
+        call(static_cast<function_call *>(node->getChildrenList().front()),
+             true);
+        return;
+    }
+
+    if (!node->getChildrenList().empty())
+    {
+        node->getChildrenList().front()->accept(*this);
+        convert(m_last_type, m_return_type);
+    }
+
+    emitJump({0xE9}, m_return_label);
+}
+
+void JitCompilerVisitor::visitArgumentList(argument_list *node)
+{
+    auto childs = node->getChildrenList();
+
+    if (childs.size() == 2)
+    {
+        auto it = childs.begin();
+        (*it)->accept(*this);
+
+        // add expression to vector.
+        it++;
+        m_args.push_back(*it);
+    }
+    else
+    {
+        // add expression to vector.
+        m_args.push_back(node->getChildrenList().front());
+    }
+}
+
+void JitCompilerVisitor::visitParameterList(parameter_list *node)
+{
+    auto childs = node->getChildrenList();
+
+    if (childs.size() == 3)
+    {
+        auto it = childs.begin();
+        (*it)->accept(*this);
+
+        it++;
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        m_params.push_back({type, id});
+    }
+    else if (childs.size() == 2)
+    {
+        auto it = childs.begin();
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        m_params.push_back({type, id});
+    }
+}
+
+void JitCompilerVisitor::visitFunctionCall(function_call *node)
+{
+    call(node, false);
+}
+
+// A tail call leaves this frame first and jumps, the callee returns straight
+// to our caller and the call costs no stack
+void JitCompilerVisitor::call(function_call *node, bool tail)
+{
+    auto childs = node->getChildrenList();
+
+    auto it = childs.begin();
+    std::string func_name = (static_cast<IDENTIFIER *>(*it))->getLabel();
+
+    FuncSymbol *def = dynamic_cast<FuncSymbol *>(
+        SymbolTable::getInstance()->lookupGlobal(func_name));
+
+    if (!def)
+    {
+        jitError("Function \"" + func_name + "\" is not declared");
+    }
+
+    // Copy the arguments out because nested calls reuse m_args
+    std::vector<STNode *> args;
+    if (childs.size() == 2)
+    {
+        it++;
+        (*it)->accept(*this);
+        args = m_args;
+        m_args.clear();
+    }
+
+    std::vector<parameter> &params = def->getParameters();
+    // Register of every argument, -1 for the ones passed on the stack
+    std::vector<int> targets;
+    std::vector<size_t> on_stack;
+    size_t int_count = 0;
+    size_t float_count = 0;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        args[i]->accept(*this);
+        convert(m_last_type, params[i].type);
+        push();
+
+        if (params[i].type == T_FLOAT && float_count < g_max_float_args)
+        {
+            targets.push_back(float_count++);
+        }
+        else if (params[i].type != T_FLOAT && int_count < g_max_int_args)
+        {
+            targets.push_back(g_int_arg_regs[int_count++]);
+        }
+        else
+        {
+            targets.push_back(-1);
+            on_stack.push_back(i);
+        }
+    }
+
+    // Stack arguments are copies in this frame, a callee taking them is
+    // called and its result returned instead of jumping to it
+    bool jump = tail && on_stack.empty();
+
+    // Pending operands of the enclosing expression and the evaluated
+    // arguments are still pushed, rsp has to be 16 byte aligned at the call
+    size_t count = args.size();
+    size_t below = 0;
+    if (!jump && (m_push_depth + on_stack.size()) % 2 != 0)
+    {
+        emit({0x48, 0x83, 0xEC, 0x08}); // sub rsp, 8
+        below++;
+    }
+
+    // Argument i is at rsp + 8 * (count - 1 - i + below), the stack ones are
+    // copied last to first so the first ends up lowest
+    for (size_t j = on_stack.size(); j-- > 0;)
+    {
+        emit({0xFF, 0xB4, 0x24}); // push qword [rsp+disp32]
+        emitInt32(8 * (count - 1 - on_stack[j] + below));
+        below++;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (targets[i] < 0)
+        {
+            continue;
+        }
+
+        emit({0x8B, 0x84, 0x24}); // mov eax, [rsp+disp32]
+        emitInt32(8 * (count - 1 - i + below));
+
+        uint8_t reg = targets[i];
+        if (params[i].type == T_FLOAT)
+        {
+            emit({0x66, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | reg << 3)});
+        }
+        else if (reg >= 8)
+        {
+            emit({0x41, 0x89, static_cast<uint8_t>(0xC0 | (reg & 7))});
+        }
+        else
+        {
+            emit({0x89, static_cast<uint8_t>(0xC0 | reg)}); // mov reg, eax
+        }
+    }
+    m_push_depth -= count;
+
+    if (jump)
+    {
+        epilogue();
+        emit({0xE9}); // jmp rel32
+        m_code->call_fixups.push_back({m_code->bytes.size(), func_name});
+        emitInt32(0);
+        return;
+    }
+
+    emit({0xE8}); // call rel32
+    m_code->call_fixups.push_back({m_code->bytes.size(), func_name});
+    emitInt32(0);
+
+    if (below + count > 0)
+    {
+        emit({0x48, 0x81, 0xC4}); // add rsp, imm32
+        emitInt32(8 * (below + count));
+    }
+
+    m_last_type = def->getReturnType();
+
+    if (tail)
+    {
+        convert(m_last_type, m_return_type);
+        emitJump({0xE9}, m_return_label);
+    }
+}
+
+void JitCompilerVisitor::visitFunctionDeclaration(function_declaration *node)
+{
+    auto it = node->getChildrenList().begin();
+    it++;
+    it++;
+    (*it)->accept(*this);
+
+    // The type checker already registered the prototype
+    m_params.clear();
+}
+
+void JitCompilerVisitor::visitFunctionDefinition(function_definition *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    m_return_type = static_cast<type_specifier *>(*it)->getType();
+    it++;
+    std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+    it++;
+    (*it)->accept(*this);
+    it++;
+    compound_statement *body = static_cast<compound_statement *>(*it);
+
+    if (!m_only.empty() && !m_only.count(id))
+    {
+        m_params.clear();
+        return;
+    }
+
+    m_code = &m_text;
+    m_functions[id] = m_code->bytes.size();
+    m_frame_size = 0;
+    m_push_depth = 0;
+    m_return_label = newLabel();
+
+    SymbolTable::getInstance()->enterScope(
+        SymbolTable::getInstance()->getCurrentId() + 1);
+
+    prologue(m_params, m_functions.find(id)->first);
+    m_params.clear();
+
+    body->accept(*this);
+
+    bindLabel(m_return_label);
+    epilogue();
+    emit({0xC3}); // ret
+
+    SymbolTable::getInstance()->exitScope();
+
+    // Keep rsp 16 byte aligned after the prologue
+    int32_t frame = (m_frame_size + 15) / 16 * 16;
+    std::memcpy(&m_code->bytes[m_frame_patch], &frame, 4);
+    m_largest_frame = std::max(m_largest_frame, static_cast<size_t>(frame));
+}
+
+void JitCompilerVisitor::visitProgram(program *node)
+{
+    m_nesting = NativeStack::nesting(node);
+    visitChildren(node);
+    finalize();
+}
+
+#endif
@@ -0,0 +1,359 @@
+#include "../lib/licm_pass.hh"
+#include <algorithm>
+
+std::string LicmPass::getName() { return "licm"; }
+
+// Whether the instruction may run on an iteration that would not have
+// reached it, or before a loop that runs zero times. Overflow only gives
+// poison, dividing by zero or INT_MIN / -1 is undefined.
+static bool speculatable(ir_instruction &instr)
+{
+    switch (instr.op)
+    {
+    case OP_PHI:
+    case OP_STORE:
+    case OP_CALL:
+    case OP_BR:
+    case OP_COND_BR:
+    case OP_RET:
+    case OP_UNREACHABLE:
+        return false;
+    case OP_SDIV:
+    case OP_SREM:
+        return instr.operands[1].kind == VAL_INT &&
+               instr.operands[1].ivalue != 0 && instr.operands[1].ivalue != -1;
+    default:
+        return true;
+    }
+}
+
+// A function we don't have the body of may write anything
+bool LicmPass::mayWrite(std::string function)
+{
+    return m_writers.count(function) || !m_known.count(function);
+}
+
+void LicmPass::findWriters(IRModule &module)
+{
+    std::unordered_map<std::string, std::vector<std::string>> calls;
+    for (auto &function : module.getFunctions())
+    {
+        calls[function->name];
+        m_known.insert(function->name);
+        for (auto &block : function->blocks)
+        {
+            for (auto &instr : block->instructions)
+            {
+                if (instr.op == OP_STORE)
+                {
+                    m_writers.insert(function->name);
+                }
+                else if (instr.op == OP_CALL)
+                {
+                    calls[function->name].push_back(instr.callee);
+                }
+            }
+        }
+    }
+
+    // A call to a function that may write makes its caller one
+    bool grew = true;
+    while (grew)
+    {
+        grew = false;
+        for (auto &entry : calls)
+        {
+            if (m_writers.count(entry.first))
+            {
+                continue;
+            }
+
+            for (auto &callee : entry.second)
+            {
+                if (mayWrite(callee))
+                {
+                    m_writers.insert(entry.first);
+                    grew = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Natural loops, one per header, smallest first so inner loops come before
+// the loops around them
+std::vector<LicmPass::loop> LicmPass::findLoops(DominatorTree &tree)
+{
+    pred_map &preds = tree.getPredecessors();
+
+    // A branch back to a block that dominates it closes a loop, whose body
+    // is everything reaching the branch without passing the header
+    std::vector<loop> loops;
+    std::unordered_map<ir_block *, size_t> by_header;
+    for (ir_block *block : tree.getOrder())
+    {
+        for (ir_block *header : DominatorTree::successors(block))
+        {
+            // Nothing may branch to the entry block, it is never a header
+            if (header == tree.getOrder().front() ||
+                !tree.dominates(header, block))
+            {
+                continue;
+            }
+
+            if (!by_header.count(header))
+            {
+                by_header[header] = loops.size();
+                loops.push_back({header, {header}});
+            }
+            loop &current = loops[by_header[header]];
+
+            std::vector<ir_block *> work;
+            if (current.body.insert(block).second)
+            {
+                work.push_back(block);
+            }
+            while (!work.empty())
+            {
+                ir_block *member = work.back();
+                work.pop_back();
+                for (ir_block *pred : preds[member])
+                {
+                    if (current.body.insert(pred).second)
+                    {
+                        work.push_back(pred);
+                    }
+                }
+            }
+        }
+    }
+
+    std::stable_sort(loops.begin(), loops.end(),
+                     [](const loop &a, const loop &b) {
+                         return a.body.size() < b.body.size();
+                     });
+    return loops;
+}
+
+// The single block outside the loop that branches to the header and nowhere
+// else. When there is none, one is put in front of the header and the phi
+// entries of the edges from outside move there.
+ir_block *LicmPass::preheader(ir_function &function, loop &current,
+                              std::vector<loop> &loops, pred_map &preds,
+                              std::vector<ir_block *> &order)
+{
+    ir_block *header = current.header;
+
+    std::vector<ir_block *> outside;
+    std::vector<ir_block *> inside;
+    for (ir_block *pred : preds[header])
+    {
+        (current.body.count(pred) ? inside : outside).push_back(pred);
+    }
+
+    ir_block *first = outside.front();
+    if (std::count(outside.begin(), outside.end(), first) ==
+            (long)outside.size() &&
+        first->instructions.back().op == OP_BR)
+    {
+        return first;
+    }
+
+    std::unique_ptr<ir_block> owner(new ir_block());
+    ir_block *block = owner.get();
+    block->label = header->label + "_preheader";
+
+    for (auto &instr : header->instructions)
+    {
+        if (instr.op != OP_PHI)
+        {
+            break;
+        }
+
+        ir_instruction phi;
+        phi.op = OP_PHI;
+        for (size_t i = 0; i < instr.targets.size();)
+        {
+            if (current.body.count(instr.targets[i]))
+            {
+                i++;
+                continue;
+            }
+
+            phi.operands.push_back(instr.operands[i]);
+            phi.targets.push_back(instr.targets[i]);
+            instr.operands.erase(instr.operands.begin() + i);
+            instr.targets.erase(instr.targets.begin() + i);
+        }
+
+        if (phi.operands.size() == 1)
+        {
+            instr.operands.push_back(phi.operands[0]);
+        }
+        else
+        {
+            phi.result = function.newReg(instr.result.type,
+                                         function.reg_names[instr.result.reg]);
+            instr.operands.push_back(phi.result);
+            block->instructions.push_back(phi);
+        }
+        instr.targets.push_back(block);
+    }
+
+    ir_instruction branch;
+    branch.op = OP_BR;
+    branch.targets = {header};
+    block->instructions.push_back(branch);
+
+    for (ir_block *pred : outside)
+    {
+        auto &targets = pred->instructions.back().targets;
+        std::replace(targets.begin(), targets.end(), header, block);
+    }
+
+    preds[block] = outside;
+    inside.push_back(block);
+    preds[header] = inside;
+
+    // The loops around this one hold the header's predecessors, so they
+    // hold the new block too
+    for (auto &other : loops)
+    {
+        if (&other != &current && other.body.count(header))
+        {
+            other.body.insert(block);
+        }
+    }
+
+    order.insert(std::find(order.begin(), order.end(), header), block);
+    auto &blocks = function.blocks;
+    auto position = std::find_if(
+        blocks.begin(), blocks.end(),
+        [&](std::unique_ptr<ir_block> &b) { return b.get() == header; });
+    blocks.insert(position, std::move(owner));
+
+    return block;
+}
+
+bool LicmPass::hoist(ir_function &function, loop &current,
+                     std::vector<loop> &loops, pred_map &preds,
+                     std::vector<ir_block *> &order)
+{
+    std::unordered_set<int> defined;
+    std::unordered_set<std::string> stored;
+    bool writes = false;
+    for (ir_block *block : current.body)
+    {
+        for (auto &instr : block->instructions)
+        {
+            if (instr.result.kind == VAL_REG)
+            {
+                defined.insert(instr.result.reg);
+            }
+            if (instr.op == OP_STORE)
+            {
+                stored.insert(instr.operands[1].global);
+            }
+            else if (instr.op == OP_CALL && mayWrite(instr.callee))
+            {
+                writes = true;
+            }
+        }
+    }
+
+    // In reverse postorder an operand is looked at after the instruction
+    // that defines it
+    std::vector<std::pair<ir_block *, size_t>> hoisted;
+    for (ir_block *block : order)
+    {
+        if (!current.body.count(block))
+        {
+            continue;
+        }
+
+        auto &instrs = block->instructions;
+        for (size_t i = 0; i < instrs.size(); i++)
+        {
+            ir_instruction &instr = instrs[i];
+            if (!speculatable(instr))
+            {
+                continue;
+            }
+            if (instr.op == OP_LOAD &&
+                (writes || stored.count(instr.operands[0].global)))
+            {
+                continue;
+            }
+
+            bool invariant = true;
+            for (auto &operand : instr.operands)
+            {
+                invariant = invariant && !(operand.kind == VAL_REG &&
+                                           defined.count(operand.reg));
+            }
+            if (invariant)
+            {
+                defined.erase(instr.result.reg);
+                hoisted.push_back({block, i});
+            }
+        }
+    }
+
+    if (hoisted.empty())
+    {
+        return false;
+    }
+
+    ir_block *target = preheader(function, current, loops, preds, order);
+    auto &moved = target->instructions;
+    for (auto &entry : hoisted)
+    {
+        moved.insert(moved.end() - 1, entry.first->instructions[entry.second]);
+    }
+
+    // Back to front, so the indices of a block stay valid
+    for (auto it = hoisted.rbegin(); it != hoisted.rend(); it++)
+    {
+        auto &instrs = it->first->instructions;
+        instrs.erase(instrs.begin() + it->second);
+    }
+
+    return true;
+}
+
+bool LicmPass::runOnFunction(ir_function &function)
+{
+    if (function.blocks.empty())
+    {
+        return false;
+    }
+
+    DominatorTree tree(function);
+    std::vector<loop> loops = findLoops(tree);
+    pred_map preds = tree.getPredecessors();
+    std::vector<ir_block *> order = tree.getOrder();
+
+    // Moving instructions leaves the blocks and edges alone, a new
+    // preheader is added to the analysis as it is made
+    bool changed = false;
+    for (auto &current : loops)
+    {
+        changed = hoist(function, current, loops, preds, order) || changed;
+    }
+
+    return changed;
+}
+
+bool LicmPass::run(IRModule &module)
+{
+    findWriters(module);
+
+    bool changed = false;
+    for (auto &function : module.getFunctions())
+    {
+        changed = runOnFunction(*function) || changed;
+    }
+
+    return changed;
+}
@@ -2,16 +2,72 @@
 #include <fstream>
 #include <iostream>
 
+#include "../lib/bitcode_writer.hh"
+#include "../lib/closure_compiler_visitor.hh"
+#include "../lib/constant_folder_visitor.hh"
+#include "../lib/cse_pass.hh"
+#include "../lib/dead_code_pass.hh"
 #include "../lib/declarator_visitor.hh"
+#include "../lib/driver.hh"
 #include "../lib/evaluator_visitor.hh"
+#include "../lib/function_attrs_pass.hh"
+#include "../lib/inline_pass.hh"
 #include "../lib/ir_emitter_visitor.hh"
+#include "../lib/ir_printer.hh"
+#include "../lib/jit_compiler_visitor.hh"
+#include "../lib/licm_pass.hh"
 #include "../lib/parser.tab.hh"
+#include "../lib/pass_manager.hh"
+#include "../lib/profiler.hh"
+#include "../lib/purity_visitor.hh"
+#include "../lib/simplify_cfg_pass.hh"
+#include "../lib/stream_compiler.hh"
+#include "../lib/strength_reduce_pass.hh"
 #include "../lib/type_checker_visitor.hh"
 // #include "../lib/lexer.hh"
 
 extern STNode *g_root;
 extern FILE *yyin;
 
+static void addPasses(PassManager &passes, bool print_passes)
+{
+    passes.setVerbose(print_passes);
+    passes.add(new InlinePass());
+    passes.add(new SimplifyCfgPass());
+    passes.add(new LicmPass());
+    passes.add(new StrengthReducePass());
+    passes.add(new CsePass());
+    passes.add(new DeadCodePass());
+    passes.add(new FunctionAttrsPass());
+}
+
+// Runs the IR passes, then writes out/ir.ll (or out/ir.bc) or builds the
+// executable
+static void finishModule(IRModule &module, bool print_passes, bool emit_bc,
+                         Driver &driver, std::string output)
+{
+    PassManager passes;
+    addPasses(passes, print_passes);
+    passes.run(module);
+
+    if (output.empty() && emit_bc)
+    {
+        std::ofstream bc("out/ir.bc", std::ios::binary);
+        BitcodeWriter writer(bc);
+        writer.write(module);
+    }
+    else if (output.empty())
+    {
+        std::ofstream ll("out/ir.ll");
+        IRPrinter printer(ll);
+        printer.print(module);
+    }
+    else
+    {
+        driver.build(module, output);
+    }
+}
+
 /*
  *  Notes for me to try or to change:
  *  1) Do a big test on my compiler, like big input file and tricky things (mid prio)
@@ -25,15 +81,180 @@ int main(int argc, char *argv[])
 {
     yy::parser parser;
     std::ofstream *dot;
+    char *input = nullptr;
+    bool jit = false;
+    bool interpret = false;
+    bool closure = false;
+    unsigned long tier_threshold = 1000;
+    size_t memo_size = 65536;
+    size_t max_call_depth = 10000;
+    unsigned long precompute_steps = 0;
+    size_t threads = 1;
+    size_t grain = 12;
+    bool memo_stats = false;
+    bool profile = false;
+    bool print_passes = false;
+    bool fast_math = false;
+    bool emit_bc = false;
+    bool stream = false;
+    Driver driver;
+    std::string output;
 
-    // Maybe i could support multiple files
-    if (argc != 2)
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--jit")
+        {
+            jit = true;
+        }
+        else if (arg == "--interpret")
+        {
+            interpret = true;
+        }
+        else if (arg == "--closure")
+        {
+            closure = true;
+        }
+        else if (arg == "--parallel" && i + 1 < argc)
+        {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--grain" && i + 1 < argc)
+        {
+            grain = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--tier-threshold" && i + 1 < argc)
+        {
+            tier_threshold = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--memo-size" && i + 1 < argc)
+        {
+            memo_size = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-call-depth" && i + 1 < argc)
+        {
+            max_call_depth = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--precompute" && i + 1 < argc)
+        {
+            precompute_steps = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--profile")
+        {
+            profile = true;
+            interpret = true;
+        }
+        else if (arg == "--memo-stats")
+        {
+            memo_stats = true;
+        }
+        else if (arg == "--print-passes")
+        {
+            print_passes = true;
+        }
+        else if (arg == "-ffast-math")
+        {
+            fast_math = true;
+        }
+        else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3")
+        {
+            driver.setOptLevel(arg[2] - '0');
+        }
+        else if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (arg == "--emit-bc")
+        {
+            emit_bc = true;
+            driver.setBitcode(true);
+        }
+        else if (arg == "--stream")
+        {
+            stream = true;
+        }
+        else if (arg == "--save-temps")
+        {
+            driver.setSaveTemps(true);
+        }
+        else if (arg == "--clang" && i + 1 < argc)
+        {
+            driver.setClang(argv[++i]);
+        }
+        else if (input == nullptr) // Maybe i could support multiple files
+        {
+            input = argv[i];
+        }
+        else
+        {
+            std::cerr << "Wrong number of arguments" << std::endl;
+            exit(1);
+        }
+    }
+
+    if (input == nullptr)
     {
         std::cerr << "Wrong number of arguments" << std::endl;
         exit(1);
     }
 
-    yyin = fopen(argv[1], "r");
+#if !defined(__x86_64__)
+    // The JIT only emits x86-64 code, elsewhere everything is interpreted
+    if (jit)
+    {
+        std::cerr << "--jit needs an x86-64 host" << std::endl;
+        exit(1);
+    }
+    tier_threshold = 0;
+#endif
+
+    yyin = fopen(input, "r");
+
+    if (stream)
+    {
+        // Every declaration is compiled while the file is still parsed, the
+        // other modes need the whole tree
+        if (jit || closure || interpret || precompute_steps)
+        {
+            std::cerr << "--stream only works when compiling to IR"
+                      << std::endl;
+            exit(1);
+        }
+        // Bitcode numbers every function before the first body
+        if (emit_bc)
+        {
+            std::cerr << "--stream only writes textual IR" << std::endl;
+            exit(1);
+        }
+
+        TypeCheckerVisitor tc;
+        IREmitterVisitor ir;
+        ir.setFastMath(fast_math);
+        PassManager passes;
+        addPasses(passes, print_passes);
+
+        std::ofstream ll;
+        if (output.empty())
+        {
+            ll.open("out/ir.ll");
+        }
+        std::ostream &out = output.empty() ? ll : driver.open(output);
+
+        {
+            StreamCompiler streamer(tc, ir, passes, out);
+            g_stream = &streamer;
+            parser.parse();
+            g_stream = nullptr;
+            streamer.finish();
+        }
+
+        if (!output.empty())
+        {
+            driver.close();
+        }
+        return 0;
+    }
 
     parser.parse();
 
@@ -49,14 +270,133 @@ int main(int argc, char *argv[])
     TypeCheckerVisitor tc;
     g_root->accept(tc);
 
+#if defined(__x86_64__)
+    if (jit)
+    {
+        // Compile to native code in process and run main directly
+        JitCompilerVisitor jit_compiler;
+        JitCompilerVisitor::setMaxCallDepth(max_call_depth);
+        g_root->accept(jit_compiler);
+        int result = jit_compiler.runMain();
+
+        delete g_root;
+        return result;
+    }
+#endif
+
+    if (closure)
+    {
+        // Translate every function into closures once, then run main
+        ClosureCompilerVisitor closures;
+        closures.setMaxCallDepth(max_call_depth);
+        if (threads > 1)
+        {
+            PurityVisitor purity;
+            g_root->accept(purity);
+            closures.setParallel(purity.getPureFunctions(), threads, grain);
+        }
+        g_root->accept(closures);
+        int result = closures.run();
+
+        delete g_root;
+        return result;
+    }
+
+    if (interpret)
+    {
+        // Globals get their values first, then main starts interpreted and
+        // hot functions move to the JIT
+        DeclaratorVisitor decl;
+        g_root->accept(decl);
+
+        PurityVisitor purity;
+        g_root->accept(purity);
+
+        // Native code has no shadow stack and a memoized call skips the
+        // work, so profiling keeps every function interpreted and uncached
+        Profiler profiler(1000);
+        EvaluatorVisitor eval;
+        eval.setTierThreshold(profile ? 0 : tier_threshold);
+        if (!profile)
+        {
+            eval.setMemoization(purity.getPureFunctions(), memo_size);
+        }
+        eval.setMaxCallDepth(max_call_depth);
+        if (profile)
+        {
+            eval.setProfiler(&profiler);
+            profiler.start();
+        }
+        eval.run(g_root);
+        int result = eval.getResult();
+
+        if (profile)
+        {
+            profiler.stop();
+
+            std::ofstream folded("debug/profile.folded", std::ofstream::out);
+            profiler.writeCollapsed(folded);
+            folded.close();
+
+            std::cerr << "Profile: " << profiler.getSamples()
+                      << " samples written to debug/profile.folded"
+                      << std::endl;
+            profiler.writeLoops(std::cerr);
+        }
+
+        if (memo_stats && eval.getMemoCache() != nullptr)
+        {
+            std::cerr << "Memo: " << eval.getMemoCache()->getHits()
+                      << " hits, " << eval.getMemoCache()->getMisses()
+                      << " misses" << std::endl;
+        }
+
+        delete g_root;
+        return result;
+    }
+
     IREmitterVisitor ir;
-    g_root->accept(ir);
+    ir.setFastMath(fast_math);
+    ir.setThreads(threads);
 
-    // DeclaratorVisitor decl;
-    // g_root->accept(decl);
+    FuncSymbol *entry = dynamic_cast<FuncSymbol *>(
+        SymbolTable::getInstance()->lookupGlobal("main"));
+    if (precompute_steps && entry != nullptr &&
+        entry->getReturnType() == T_INT && entry->getParameters().empty())
+    {
+        // MINIC programs take no input, so a main that finishes within the
+        // budget is replaced by its result
+        ClosureCompilerVisitor trial;
+        trial.setStepBudget(precompute_steps);
+        trial.setMaxCallDepth(max_call_depth);
+        g_root->accept(trial);
+        int result = trial.run();
+
+        if (trial.isFinished())
+        {
+            for (auto &global : trial.getGlobals())
+            {
+                if (global.second == T_FLOAT)
+                {
+                    ir.setPrecomputedGlobal(global.first,
+                                            trial.getFloatGlobal(global.first));
+                }
+                else
+                {
+                    ir.setPrecomputedGlobal(global.first,
+                                            trial.getIntGlobal(global.first));
+                }
+            }
+            ir.setPrecomputedResult(result);
+        }
+    }
+
+    ConstantFolderVisitor folder;
+    g_root->accept(folder);
+
+    g_root->accept(ir);
 
-    // EvaluatorVisitor eval;
-    // g_root->accept(eval);
+    finishModule(ir.getModule(), print_passes, emit_bc, driver, output);
 
     delete g_root;
 
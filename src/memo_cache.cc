@@ -0,0 +1,57 @@
+#include "../lib/memo_cache.hh"
+#include <cstdint>
+
+MemoCache::MemoCache(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    m_entries.assign(size, {nullptr, {}, 0});
+    m_mask = size - 1;
+    m_hits = 0;
+    m_misses = 0;
+}
+
+MemoCache::entry &MemoCache::slotOf(FuncSymbol *func, std::vector<Value> &args)
+{
+    uint64_t hash = reinterpret_cast<uintptr_t>(func) >> 4;
+    for (auto &arg : args)
+    {
+        hash = (hash ^ static_cast<uint32_t>(arg)) * 0x100000001B3ULL;
+    }
+    hash ^= hash >> 29;
+
+    return m_entries[hash & m_mask];
+}
+
+bool MemoCache::lookup(FuncSymbol *func, std::vector<Value> &args,
+                       Value &result)
+{
+    entry &slot = slotOf(func, args);
+
+    if (slot.func == func && slot.args == args)
+    {
+        m_hits++;
+        result = slot.result;
+        return true;
+    }
+
+    m_misses++;
+    return false;
+}
+
+void MemoCache::store(FuncSymbol *func, std::vector<Value> &args, Value result)
+{
+    entry &slot = slotOf(func, args);
+
+    slot.func = func;
+    slot.args = args;
+    slot.result = result;
+}
+
+unsigned long MemoCache::getHits() { return m_hits; }
+
+unsigned long MemoCache::getMisses() { return m_misses; }
@@ -0,0 +1,98 @@
+#include "../lib/native_stack.hh"
+#include <algorithm>
+#include <cerrno>
+
+// Frames above the interpreter and whatever the program does outside calls
+static const size_t g_stack_base = 8 * 1024 * 1024;
+// Kept free below every call for exception unwinding and iostream
+static const size_t g_stack_slack = 1024 * 1024;
+// Address space is reserved up front but only touched pages are backed
+static const size_t g_stack_max = 4ul * 1024 * 1024 * 1024;
+
+thread_local char *NativeStack::t_limit = nullptr;
+
+void NativeStack::mark()
+{
+    pthread_attr_t attr;
+    void *low = nullptr;
+    size_t size = 0;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+        pthread_attr_getstack(&attr, &low, &size);
+        pthread_attr_destroy(&attr);
+    }
+
+    t_limit = static_cast<char *>(low);
+}
+
+size_t NativeStack::nesting(STNode *node)
+{
+    size_t deepest = 0;
+    for (auto &child : node->getChildrenList())
+    {
+        deepest = std::max(deepest, nesting(child));
+    }
+
+    return deepest + 1;
+}
+
+size_t NativeStack::sizeFor(size_t calls, size_t per_call, size_t nesting,
+                            size_t per_level)
+{
+    size_t frame = per_call + nesting * per_level;
+    if (calls > (g_stack_max - g_stack_base) / frame)
+    {
+        return g_stack_max;
+    }
+
+    return g_stack_base + calls * frame;
+}
+
+bool NativeStack::start(pthread_t &thread, size_t size,
+                        void *(*body)(void *), void *arg)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, size);
+
+    // Less than asked for is fine, exhausted() catches running out
+    int error = pthread_create(&thread, &attr, body, arg);
+    while (error == EAGAIN && size > g_stack_base)
+    {
+        size = std::max(size / 2, g_stack_base);
+        pthread_attr_setstacksize(&attr, size);
+        error = pthread_create(&thread, &attr, body, arg);
+    }
+    pthread_attr_destroy(&attr);
+
+    return error == 0;
+}
+
+bool NativeStack::run(size_t size, void *(*body)(void *), void *arg)
+{
+    pthread_t thread;
+    if (!start(thread, size, body, arg))
+    {
+        return false;
+    }
+
+    pthread_join(thread, nullptr);
+    return true;
+}
+
+char *NativeStack::limit()
+{
+    if (t_limit == nullptr)
+    {
+        mark();
+    }
+
+    return t_limit + g_stack_slack;
+}
+
+bool NativeStack::exhausted(size_t reserve)
+{
+    char here;
+    return &here < limit() + reserve;
+}
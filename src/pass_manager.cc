@@ -0,0 +1,33 @@
+#include "../lib/pass_manager.hh"
+#include <iostream>
+
+bool FunctionPass::run(IRModule &module)
+{
+    bool changed = false;
+    for (auto &function : module.getFunctions())
+    {
+        changed = runOnFunction(*function) || changed;
+    }
+
+    return changed;
+}
+
+PassManager::PassManager() { m_verbose = false; }
+
+void PassManager::add(IRPass *pass) { m_passes.emplace_back(pass); }
+
+void PassManager::setVerbose(bool verbose) { m_verbose = verbose; }
+
+void PassManager::run(IRModule &module)
+{
+    for (auto &pass : m_passes)
+    {
+        bool changed = pass->run(module);
+
+        if (m_verbose)
+        {
+            std::cerr << "Pass " << pass->getName() << ": "
+                      << (changed ? "changed" : "unchanged") << std::endl;
+        }
+    }
+}
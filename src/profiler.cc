@@ -0,0 +1,102 @@
+#include "../lib/profiler.hh"
+#include <algorithm>
+#include <iostream>
+#include <sys/time.h>
+
+volatile sig_atomic_t Profiler::s_pending = 0;
+
+Profiler::Profiler(unsigned int interval_us)
+{
+    m_interval_us = interval_us;
+    m_samples = 0;
+}
+
+void Profiler::onTick(int) { s_pending = 1; }
+
+void Profiler::start()
+{
+    struct sigaction action = {};
+    action.sa_handler = onTick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    // ITIMER_PROF counts CPU time of the whole process, the interpreter
+    // thread included
+    struct itimerval timer = {};
+    timer.it_interval.tv_usec = m_interval_us;
+    timer.it_value.tv_usec = m_interval_us;
+    if (setitimer(ITIMER_PROF, &timer, nullptr))
+    {
+        std::cerr << "Profiler Error: Cannot start the sampling timer"
+                  << std::endl;
+        exit(1);
+    }
+}
+
+void Profiler::stop()
+{
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    signal(SIGPROF, SIG_IGN);
+}
+
+void Profiler::sample(const std::string &stack)
+{
+    s_pending = 0;
+    m_stacks[stack]++;
+    m_samples++;
+}
+
+void Profiler::countIteration(STNode *loop, const std::string &function)
+{
+    loop_count &count = m_loops[loop];
+    if (!count.iterations)
+    {
+        count.function = function;
+    }
+    count.iterations++;
+}
+
+unsigned long Profiler::getSamples() { return m_samples; }
+
+void Profiler::writeCollapsed(std::ostream &out)
+{
+    for (auto &stack : m_stacks)
+    {
+        out << stack.first << " " << stack.second << "\n";
+    }
+}
+
+void Profiler::writeLoops(std::ostream &out)
+{
+    // Source order, the AST doesn't know about files so only line:column
+    std::vector<std::pair<STNode *, loop_count>> loops(m_loops.begin(),
+                                                      m_loops.end());
+    std::sort(loops.begin(), loops.end(),
+              [](const std::pair<STNode *, loop_count> &a,
+                 const std::pair<STNode *, loop_count> &b) {
+                  if (a.first->getLine() != b.first->getLine())
+                  {
+                      return a.first->getLine() < b.first->getLine();
+                  }
+                  return a.first->getColumn() < b.first->getColumn();
+              });
+
+    for (auto &loop : loops)
+    {
+        std::string kind = "for";
+        if (loop.first->getNodeType() == WHILE_STATEMENT_NODE)
+        {
+            kind = "while";
+        }
+        else if (loop.first->getNodeType() == DO_WHILE_STATEMENT_NODE)
+        {
+            kind = "do-while";
+        }
+
+        out << kind << " at " << loop.first->getLine() << ":"
+            << loop.first->getColumn() << " in " << loop.second.function
+            << ": " << loop.second.iterations << " iterations\n";
+    }
+}
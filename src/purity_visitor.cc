@@ -0,0 +1,178 @@
+#include "../lib/purity_visitor.hh"
+
+bool PurityVisitor::isPure(std::string name) { return m_pure.count(name); }
+
+std::unordered_set<std::string> &PurityVisitor::getPureFunctions()
+{
+    return m_pure;
+}
+
+// Start from every function that touches no global and drop the ones that
+// call something impure until nothing changes, so recursion stays pure
+void PurityVisitor::solve()
+{
+    for (auto &name : m_defined)
+    {
+        if (!m_touches_globals.count(name))
+        {
+            m_pure.insert(name);
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (auto it = m_pure.begin(); it != m_pure.end();)
+        {
+            bool pure = true;
+            for (auto &callee : m_callees[*it])
+            {
+                pure = pure && m_pure.count(callee);
+            }
+
+            if (pure)
+            {
+                it++;
+            }
+            else
+            {
+                it = m_pure.erase(it);
+                changed = true;
+            }
+        }
+    }
+}
+
+void PurityVisitor::visitIDENTIFIER(IDENTIFIER *node)
+{
+    if (m_current.empty())
+    {
+        return;
+    }
+
+    std::string name = node->getLabel();
+    Symbol *sym = SymbolTable::getInstance()->lookup(name);
+
+    // Locals and parameters shadow globals, only the global frame's own
+    // symbol counts as global state
+    if (sym != nullptr && sym == SymbolTable::getInstance()->lookupGlobal(name))
+    {
+        m_touches_globals.insert(m_current);
+    }
+}
+
+void PurityVisitor::visitVariableDeclaration(variable_declaration *node)
+{
+    auto &temp = node->getChildrenList();
+    auto it = temp.begin();
+    std::string name = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+    if (temp.size() > 1)
+    {
+        it++;
+        (*it)->accept(*this);
+    }
+
+    // Global initializers are not part of any function
+    if (!m_current.empty())
+    {
+        VarSymbol *sym = new VarSymbol(0, name, T_INT);
+        if (!SymbolTable::getInstance()->insert(sym))
+        {
+            delete sym;
+        }
+    }
+}
+
+void PurityVisitor::visitFunctionCall(function_call *node)
+{
+    auto it = node->getChildrenList().begin();
+    std::string name = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+    if (!m_current.empty())
+    {
+        m_callees[m_current].insert(name);
+    }
+
+    for (it++; it != node->getChildrenList().end(); it++)
+    {
+        (*it)->accept(*this);
+    }
+}
+
+void PurityVisitor::visitFunctionDefinition(function_definition *node)
+{
+    auto it = node->getChildrenList().begin();
+
+    it++;
+    std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+    it++;
+    (*it)->accept(*this);
+    it++;
+    compound_statement *body = static_cast<compound_statement *>(*it);
+
+    m_current = id;
+    m_defined.insert(id);
+    m_callees[id];
+
+    SymbolTable::getInstance()->enterScope(
+        SymbolTable::getInstance()->getCurrentId() + 1);
+
+    for (auto &param : m_params)
+    {
+        SymbolTable::getInstance()->insert(
+            new VarSymbol(0, param.name, param.type));
+    }
+    m_params.clear();
+
+    body->accept(*this);
+
+    SymbolTable::getInstance()->exitScope();
+    m_current.clear();
+}
+
+void PurityVisitor::visitFunctionDeclaration(function_declaration *)
+{
+    // Prototypes have no body to analyze
+}
+
+void PurityVisitor::visitParameterList(parameter_list *node)
+{
+    auto childs = node->getChildrenList();
+
+    if (childs.size() == 3)
+    {
+        auto it = childs.begin();
+        (*it)->accept(*this);
+
+        it++;
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        parameter param = {type, id};
+        m_params.push_back(param);
+    }
+    else if (childs.size() == 2)
+    {
+        auto it = childs.begin();
+        dataType type = static_cast<type_specifier *>(*it)->getType();
+        it++;
+        std::string id = static_cast<IDENTIFIER *>(*it)->getLabel();
+
+        parameter param = {type, id};
+        m_params.push_back(param);
+    }
+    else
+    {
+        // Empty list
+    }
+}
+
+void PurityVisitor::visitProgram(program *node)
+{
+    visitChildren(node);
+    solve();
+}
@@ -0,0 +1,389 @@
+#include "../lib/simplify_cfg_pass.hh"
+#include <algorithm>
+#include <unordered_set>
+
+std::string SimplifyCfgPass::getName() { return "simplify-cfg"; }
+
+// The branch targets of the block's terminator, empty for ret and
+// unreachable
+static std::vector<ir_block *> successors(ir_block *block)
+{
+    if (block->instructions.empty())
+    {
+        return {};
+    }
+
+    ir_instruction &last = block->instructions.back();
+    if (last.op == OP_BR || last.op == OP_COND_BR)
+    {
+        return last.targets;
+    }
+
+    return {};
+}
+
+SimplifyCfgPass::pred_map SimplifyCfgPass::predecessors(ir_function &function)
+{
+    pred_map preds;
+    for (auto &block : function.blocks)
+    {
+        for (ir_block *succ : successors(block.get()))
+        {
+            preds[succ].push_back(block.get());
+        }
+    }
+
+    return preds;
+}
+
+// Drops the phi entries coming from pred, or only the first one of each phi
+// when just one of several edges goes away
+void SimplifyCfgPass::removeIncoming(ir_block *block, ir_block *pred, bool all)
+{
+    for (auto &instr : block->instructions)
+    {
+        if (instr.op != OP_PHI)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < instr.targets.size();)
+        {
+            if (instr.targets[i] == pred)
+            {
+                instr.targets.erase(instr.targets.begin() + i);
+                instr.operands.erase(instr.operands.begin() + i);
+                if (!all)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+// br on a constant or to the same block twice becomes a plain br, and
+// nothing after a terminator is kept
+bool SimplifyCfgPass::foldBranches(ir_function &function)
+{
+    bool changed = false;
+
+    for (auto &block : function.blocks)
+    {
+        auto &instrs = block->instructions;
+
+        auto terminator = std::find_if(
+            instrs.begin(), instrs.end(),
+            [](ir_instruction &instr) { return instr.isTerminator(); });
+        if (terminator != instrs.end() && terminator + 1 != instrs.end())
+        {
+            instrs.erase(terminator + 1, instrs.end());
+            changed = true;
+        }
+
+        if (instrs.empty() || instrs.back().op != OP_COND_BR)
+        {
+            continue;
+        }
+
+        ir_instruction &branch = instrs.back();
+        ir_block *kept;
+        if (branch.operands[0].kind == VAL_INT)
+        {
+            kept = branch.operands[0].ivalue ? branch.targets[0]
+                                             : branch.targets[1];
+        }
+        else if (branch.targets[0] == branch.targets[1])
+        {
+            kept = branch.targets[0];
+        }
+        else
+        {
+            continue;
+        }
+
+        ir_block *dropped =
+            branch.targets[0] == kept ? branch.targets[1] : branch.targets[0];
+        removeIncoming(dropped, block.get(), false);
+
+        branch.op = OP_BR;
+        branch.operands.clear();
+        branch.targets = {kept};
+        changed = true;
+    }
+
+    return changed;
+}
+
+bool SimplifyCfgPass::removeUnreachable(ir_function &function)
+{
+    std::unordered_set<ir_block *> reachable;
+    std::vector<ir_block *> work = {function.blocks.front().get()};
+    reachable.insert(work.back());
+
+    while (!work.empty())
+    {
+        ir_block *block = work.back();
+        work.pop_back();
+
+        for (ir_block *succ : successors(block))
+        {
+            if (reachable.insert(succ).second)
+            {
+                work.push_back(succ);
+            }
+        }
+    }
+
+    std::vector<ir_block *> removed;
+    for (auto &block : function.blocks)
+    {
+        if (reachable.count(block.get()))
+        {
+            continue;
+        }
+
+        for (ir_block *succ : successors(block.get()))
+        {
+            removeIncoming(succ, block.get(), true);
+        }
+        removed.push_back(block.get());
+    }
+
+    eraseBlocks(function, removed);
+    return !removed.empty();
+}
+
+// A phi whose operands are all the same value (or itself) is that value
+bool SimplifyCfgPass::removeTrivialPhis(ir_function &function)
+{
+    bool changed = false;
+
+    for (auto &block : function.blocks)
+    {
+        auto &instrs = block->instructions;
+        for (size_t i = 0; i < instrs.size();)
+        {
+            if (instrs[i].op != OP_PHI)
+            {
+                i++;
+                continue;
+            }
+
+            ir_value same;
+            bool trivial = true;
+            for (auto &operand : instrs[i].operands)
+            {
+                if (operand == instrs[i].result || operand == same)
+                {
+                    continue;
+                }
+                if (same.kind != VAL_NONE)
+                {
+                    trivial = false;
+                    break;
+                }
+                same = operand;
+            }
+
+            if (!trivial || same.kind == VAL_NONE)
+            {
+                i++;
+                continue;
+            }
+
+            int reg = instrs[i].result.reg;
+            instrs.erase(instrs.begin() + i);
+            function.replaceUses(reg, same);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// A block whose only predecessor branches only to it is appended to that
+// predecessor
+bool SimplifyCfgPass::mergeBlocks(ir_function &function)
+{
+    pred_map preds = predecessors(function);
+    std::unordered_set<ir_block *> merged;
+    std::vector<ir_block *> removed;
+
+    for (auto &owner : function.blocks)
+    {
+        ir_block *block = owner.get();
+        if (merged.count(block))
+        {
+            continue;
+        }
+
+        while (!block->instructions.empty() &&
+               block->instructions.back().op == OP_BR)
+        {
+            ir_block *next = block->instructions.back().targets[0];
+            if (next == block || next == function.blocks.front().get() ||
+                preds[next].size() != 1)
+            {
+                break;
+            }
+
+            // Its phis have a single entry, from block
+            block->instructions.pop_back();
+            for (auto &instr : next->instructions)
+            {
+                if (instr.op == OP_PHI)
+                {
+                    function.replaceUses(instr.result.reg, instr.operands[0]);
+                }
+                else
+                {
+                    block->instructions.push_back(instr);
+                }
+            }
+
+            for (ir_block *succ : successors(next))
+            {
+                std::replace(preds[succ].begin(), preds[succ].end(), next,
+                             block);
+                for (auto &instr : succ->instructions)
+                {
+                    if (instr.op == OP_PHI)
+                    {
+                        std::replace(instr.targets.begin(), instr.targets.end(),
+                                     next, block);
+                    }
+                }
+            }
+
+            merged.insert(next);
+            removed.push_back(next);
+        }
+    }
+
+    eraseBlocks(function, removed);
+    return !removed.empty();
+}
+
+// Branches to a block holding nothing but a br go straight to its target.
+// With phis in the target that only works when no predecessor already
+// branches there.
+bool SimplifyCfgPass::forwardEmptyBlocks(ir_function &function)
+{
+    pred_map preds = predecessors(function);
+    std::vector<ir_block *> removed;
+
+    for (size_t b = 1; b < function.blocks.size(); b++)
+    {
+        ir_block *block = function.blocks[b].get();
+        if (block->instructions.size() != 1 ||
+            block->instructions.back().op != OP_BR || preds[block].empty())
+        {
+            continue;
+        }
+
+        ir_block *target = block->instructions.back().targets[0];
+        if (target == block || target == function.blocks.front().get())
+        {
+            continue;
+        }
+
+        bool has_phis = !target->instructions.empty() &&
+                        target->instructions.front().op == OP_PHI;
+        if (has_phis)
+        {
+            bool shared = false;
+            for (ir_block *pred : preds[block])
+            {
+                shared = shared || std::count(preds[target].begin(),
+                                              preds[target].end(), pred);
+            }
+            if (shared)
+            {
+                continue;
+            }
+        }
+
+        // Every edge into block becomes an edge into target with the value
+        // block passed on
+        for (auto &instr : target->instructions)
+        {
+            if (instr.op != OP_PHI)
+            {
+                break;
+            }
+
+            size_t entry = std::find(instr.targets.begin(),
+                                     instr.targets.end(), block) -
+                           instr.targets.begin();
+            ir_value value = instr.operands[entry];
+
+            instr.targets[entry] = preds[block].front();
+            for (size_t i = 1; i < preds[block].size(); i++)
+            {
+                instr.operands.insert(instr.operands.begin() + entry + i,
+                                      value);
+                instr.targets.insert(instr.targets.begin() + entry + i,
+                                     preds[block][i]);
+            }
+        }
+
+        auto &target_preds = preds[target];
+        target_preds.erase(
+            std::find(target_preds.begin(), target_preds.end(), block));
+        for (ir_block *pred : preds[block])
+        {
+            // Once per edge, a pred listed twice is rewritten once
+            auto &branch = pred->instructions.back();
+            auto edge =
+                std::find(branch.targets.begin(), branch.targets.end(), block);
+            *edge = target;
+            target_preds.push_back(pred);
+        }
+
+        preds[block].clear();
+        removed.push_back(block);
+    }
+
+    eraseBlocks(function, removed);
+    return !removed.empty();
+}
+
+void SimplifyCfgPass::eraseBlocks(ir_function &function,
+                                  std::vector<ir_block *> &removed)
+{
+    if (removed.empty())
+    {
+        return;
+    }
+
+    std::unordered_set<ir_block *> dead(removed.begin(), removed.end());
+    auto &blocks = function.blocks;
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [&](std::unique_ptr<ir_block> &block) {
+                                    return dead.count(block.get()) != 0;
+                                }),
+                 blocks.end());
+}
+
+bool SimplifyCfgPass::runOnFunction(ir_function &function)
+{
+    bool changed = false;
+    bool simplified = true;
+
+    while (simplified)
+    {
+        simplified = foldBranches(function);
+        simplified = removeUnreachable(function) || simplified;
+        simplified = removeTrivialPhis(function) || simplified;
+        simplified = mergeBlocks(function) || simplified;
+        simplified = forwardEmptyBlocks(function) || simplified;
+        changed = changed || simplified;
+    }
+
+    return changed;
+}
@@ -0,0 +1,77 @@
+#include "../lib/stream_compiler.hh"
+
+StreamCompiler *g_stream = NULL;
+
+// Bodies are freed right after they are emitted, so none may wait for the
+// thread pool
+StreamCompiler::StreamCompiler(TypeCheckerVisitor &checker,
+                               IREmitterVisitor &emitter, PassManager &passes,
+                               std::ostream &out)
+    : m_checker(checker), m_emitter(emitter), m_passes(passes), m_printer(out)
+{
+    m_emitter.setThreads(1);
+    m_printer.printHeader(m_emitter.getModule());
+}
+
+StreamCompiler::~StreamCompiler()
+{
+    for (external_declaration *global : m_globals)
+    {
+        delete global;
+    }
+}
+
+void StreamCompiler::compile(external_declaration *node)
+{
+    node->accept(m_checker);
+    node->accept(m_folder);
+    node->accept(m_emitter);
+
+    STNode *declaration = *node->getChildrenList().begin();
+    nodeType type = declaration->getNodeType();
+    if (type == VARIABLE_DECLARATION_STATEMENT_NODE)
+    {
+        m_globals.push_back(node);
+        return;
+    }
+    delete node;
+
+    if (type != FUNCTION_DEFINITION_NODE)
+    {
+        return;
+    }
+
+    // The module holds nothing but the new function
+    IRModule &module = m_emitter.getModule();
+    auto &functions = module.getFunctions();
+    if (functions.back()->name == "main")
+    {
+        // finishProgram drops its call to _init_globals when there is none
+        m_main = std::move(functions.back());
+        functions.pop_back();
+        return;
+    }
+
+    m_passes.run(module);
+    m_printer.printFunction(*functions.back());
+    functions.clear();
+}
+
+void StreamCompiler::finish()
+{
+    IRModule &module = m_emitter.getModule();
+    if (m_main)
+    {
+        module.getFunctions().push_back(std::move(m_main));
+    }
+
+    m_emitter.finishProgram();
+    m_passes.run(module);
+
+    for (auto &function : module.getFunctions())
+    {
+        m_printer.printFunction(*function);
+    }
+    module.getFunctions().clear();
+    m_printer.printGlobals(module);
+}
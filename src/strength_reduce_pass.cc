@@ -0,0 +1,223 @@
+#include "../lib/strength_reduce_pass.hh"
+#include <climits>
+
+std::string StrengthReducePass::getName() { return "strength-reduce"; }
+
+// k for 2^k, -1 for anything else
+static int exactLog2(unsigned int value)
+{
+    if (value == 0 || (value & (value - 1)) != 0)
+    {
+        return -1;
+    }
+
+    int k = 0;
+    while (value > 1)
+    {
+        value >>= 1;
+        k++;
+    }
+
+    return k;
+}
+
+// Dividing by 0 must still trap, by 1 and -1 there is nothing to gain and
+// INT_MIN has no positive counterpart
+static bool reducible(int divisor)
+{
+    return divisor != 0 && divisor != 1 && divisor != -1 &&
+           divisor != INT_MIN;
+}
+
+// The signed magic number of a divisor from 3 up that isn't a power of two:
+// x / d is the high half of x * multiplier, plus x when multiplier came out
+// negative, shifted right by shift and rounded towards zero (Hacker's
+// Delight, chapter 10)
+static void magic(unsigned int divisor, int &multiplier, int &shift)
+{
+    const unsigned int two31 = 0x80000000;
+    unsigned int limit = two31 - 1 - two31 % divisor;
+
+    int p = 31;
+    unsigned int q1 = two31 / limit;
+    unsigned int r1 = two31 - q1 * limit;
+    unsigned int q2 = two31 / divisor;
+    unsigned int r2 = two31 - q2 * divisor;
+    unsigned int delta;
+
+    do
+    {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= limit)
+        {
+            q1++;
+            r1 -= limit;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= divisor)
+        {
+            q2++;
+            r2 -= divisor;
+        }
+        delta = divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    multiplier = static_cast<int>(q2 + 1);
+    shift = p - 32;
+}
+
+ir_value StrengthReducePass::append(irOpcode op, irType type,
+                                    std::vector<ir_value> operands,
+                                    ir_value result)
+{
+    ir_instruction instr;
+    instr.op = op;
+    instr.operands = operands;
+    instr.result = result.kind == VAL_NONE ? m_function->newReg(type) : result;
+    m_out->push_back(instr);
+
+    return instr.result;
+}
+
+bool StrengthReducePass::reduceMultiply(ir_instruction &instr)
+{
+    size_t constant = instr.operands[1].kind == VAL_INT ? 1 : 0;
+    if (instr.operands[constant].kind != VAL_INT)
+    {
+        return false;
+    }
+
+    // A shift by 31 would turn the sign around
+    int k = exactLog2(instr.operands[constant].ivalue);
+    if (k < 1 || k > 30)
+    {
+        return false;
+    }
+
+    append(OP_SHL, IR_I32, {instr.operands[1 - constant], irInt(k)},
+           instr.result);
+    m_out->back().nsw = instr.nsw;
+    return true;
+}
+
+// sdiv rounds towards zero. A shift rounds down, so negative dividends get
+// divisor - 1 added first.
+ir_value StrengthReducePass::divide(ir_value x, int divisor, ir_value result)
+{
+    unsigned int magnitude = divisor < 0 ? 0u - divisor : divisor;
+    ir_value quotient = divisor < 0 ? ir_value() : result;
+
+    int k = exactLog2(magnitude);
+    if (k > 0)
+    {
+        ir_value sign = append(OP_ASHR, IR_I32, {x, irInt(31)});
+        ir_value bias = append(OP_AND, IR_I32, {sign, irInt(magnitude - 1)});
+        ir_value biased = append(OP_ADD, IR_I32, {x, bias});
+        quotient = append(OP_ASHR, IR_I32, {biased, irInt(k)}, quotient);
+    }
+    else
+    {
+        int multiplier;
+        int shift;
+        magic(magnitude, multiplier, shift);
+
+        ir_value wide = append(OP_SEXT, IR_I64, {x});
+        ir_value product =
+            append(OP_MUL, IR_I64, {wide, irInt(multiplier, IR_I64)});
+        ir_value high = append(OP_ASHR, IR_I64, {product, irInt(32, IR_I64)});
+        ir_value estimate = append(OP_TRUNC, IR_I32, {high});
+        if (multiplier < 0)
+        {
+            estimate = append(OP_ADD, IR_I32, {estimate, x});
+        }
+        if (shift > 0)
+        {
+            estimate = append(OP_ASHR, IR_I32, {estimate, irInt(shift)});
+        }
+
+        // The estimate is rounded down, one more for negative dividends
+        ir_value sign = append(OP_ASHR, IR_I32, {x, irInt(31)});
+        quotient = append(OP_SUB, IR_I32, {estimate, sign}, quotient);
+    }
+
+    if (divisor < 0)
+    {
+        quotient = append(OP_SUB, IR_I32, {irInt(0), quotient}, result);
+    }
+
+    return quotient;
+}
+
+// srem takes the sign of the dividend, so x % -d is x % d
+ir_value StrengthReducePass::remainder(ir_value x, int divisor,
+                                       ir_value result)
+{
+    unsigned int magnitude = divisor < 0 ? 0u - divisor : divisor;
+
+    int k = exactLog2(magnitude);
+    if (k > 0)
+    {
+        ir_value sign = append(OP_ASHR, IR_I32, {x, irInt(31)});
+        ir_value bias = append(OP_AND, IR_I32, {sign, irInt(magnitude - 1)});
+        ir_value biased = append(OP_ADD, IR_I32, {x, bias});
+        ir_value multiple =
+            append(OP_AND, IR_I32, {biased, irInt(-(int)magnitude)});
+        return append(OP_SUB, IR_I32, {x, multiple}, result);
+    }
+
+    ir_value quotient = divide(x, magnitude, ir_value());
+    ir_value multiple = append(OP_MUL, IR_I32, {quotient, irInt(magnitude)});
+    return append(OP_SUB, IR_I32, {x, multiple}, result);
+}
+
+bool StrengthReducePass::runOnFunction(ir_function &function)
+{
+    m_function = &function;
+    bool changed = false;
+
+    for (auto &block : function.blocks)
+    {
+        std::vector<ir_instruction> out;
+        out.reserve(block->instructions.size());
+        m_out = &out;
+
+        for (auto &instr : block->instructions)
+        {
+            bool reduced = false;
+            if (instr.result.type == IR_I32 && instr.op == OP_MUL)
+            {
+                reduced = reduceMultiply(instr);
+            }
+            else if (instr.result.type == IR_I32 &&
+                     (instr.op == OP_SDIV || instr.op == OP_SREM) &&
+                     instr.operands[1].kind == VAL_INT &&
+                     reducible(instr.operands[1].ivalue))
+            {
+                if (instr.op == OP_SDIV)
+                {
+                    divide(instr.operands[0], instr.operands[1].ivalue,
+                           instr.result);
+                }
+                else
+                {
+                    remainder(instr.operands[0], instr.operands[1].ivalue,
+                              instr.result);
+                }
+                reduced = true;
+            }
+
+            if (!reduced)
+            {
+                out.push_back(instr);
+            }
+            changed = changed || reduced;
+        }
+
+        block->instructions.swap(out);
+    }
+
+    return changed;
+}
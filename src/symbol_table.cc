@@ -3,13 +3,27 @@
 #include <vector>
 
 SymbolTable *SymbolTable::m_instance = nullptr;
+thread_local SymbolTable *SymbolTable::t_instance = nullptr;
 
-SymbolTable::SymbolTable() { enterScope(0); }
+SymbolTable::SymbolTable()
+{
+    enterScope(0);
+    m_global = scopeStack.front().get();
+}
+
+SymbolTable::SymbolTable(ScopeFrame *global)
+{
+    enterScope(0);
+    m_global = global;
+}
 
 SymbolTable::~SymbolTable()
 {
     exitScope();
-    delete m_instance;
+    if (this == m_instance)
+    {
+        m_instance = nullptr;
+    }
 }
 
 void SymbolTable::enterScope(int id)
@@ -32,9 +46,7 @@ bool SymbolTable::insertGlobal(Symbol *sym)
     if (scopeStack.empty())
         return false;
 
-    auto &globalScopePtr = scopeStack.front();
-
-    return globalScopePtr->insert(sym);
+    return m_global->insert(sym);
 }
 
 bool SymbolTable::insert(Symbol *sym)
@@ -56,7 +68,7 @@ Symbol *SymbolTable::lookupGlobal(std::string name)
         return nullptr;
     }
 
-    return scopeStack.front()->lookup(name);
+    return m_global->lookup(name);
 }
 
 Symbol *SymbolTable::lookup(std::string name)
@@ -83,11 +95,16 @@ Symbol *SymbolTable::lookup(std::string name)
     }
 
     // global loopup
-    return scopeStack.front()->lookup(name);
+    return m_global->lookup(name);
 }
 
 SymbolTable *SymbolTable::getInstance()
 {
+    if (t_instance != nullptr)
+    {
+        return t_instance;
+    }
+
     if (m_instance == nullptr)
     {
         m_instance = new SymbolTable();
@@ -95,6 +112,17 @@ SymbolTable *SymbolTable::getInstance()
     return m_instance;
 }
 
+void SymbolTable::attachThread()
+{
+    t_instance = new SymbolTable(getInstance()->m_global);
+}
+
+void SymbolTable::detachThread()
+{
+    delete t_instance;
+    t_instance = nullptr;
+}
+
 Symbol::Symbol(std::string name, SymbolType type)
 {
     m_name = name;
@@ -152,11 +180,13 @@ bool ScopeFrame::insert(Symbol *sym)
 
 Symbol *ScopeFrame::lookup(std::string name)
 {
-    if (m_table.count(name))
+    // find, not operator[], so threads can look up concurrently
+    auto found = m_table.find(name);
+    if (found != m_table.end())
     {
         // .get() returns the raw pointer (observer) without transferring
         // ownership
-        return m_table[name].get();
+        return found->second.get();
     }
     return nullptr;
 }
@@ -166,11 +196,14 @@ VarSymbol::VarSymbol(Value value, std::string name, dataType type)
 {
     m_value = value;
     m_value_type = type;
+    m_slot = 0;
     // m_ir_addr = this->getName();
 }
 
 Value VarSymbol::getValue() { return m_value; }
 
+Value *VarSymbol::getValueAddress() { return &m_value; }
+
 dataType VarSymbol::getValueType() { return m_value_type; }
 
 std::string VarSymbol::getAddress() { return m_ir_addr; }
@@ -179,4 +212,8 @@ void VarSymbol::setValue(Value value) { m_value = value; }
 
 void VarSymbol::setAddress(std::string addr) { m_ir_addr = addr; }
 
+int VarSymbol::getSlot() { return m_slot; }
+
+void VarSymbol::setSlot(int slot) { m_slot = slot; }
+
 int ScopeFrame::getId() { return m_function_id; }
@@ -0,0 +1,134 @@
+#include "../lib/task_pool.hh"
+#include "../lib/native_stack.hh"
+#include <iostream>
+#include <sched.h>
+
+thread_local size_t TaskPool::t_index = 0;
+
+TaskPool::TaskPool(size_t threads, size_t stack_size) : m_stop(false)
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        m_workers.emplace_back(new worker());
+    }
+
+    for (size_t i = 1; i < threads; i++)
+    {
+        auto job = new std::pair<TaskPool *, size_t>(this, i);
+
+        pthread_t thread;
+        bool started = NativeStack::start(
+            thread, stack_size,
+            [](void *arg) -> void * {
+                auto job = static_cast<std::pair<TaskPool *, size_t> *>(arg);
+                job->first->loop(job->second);
+                delete job;
+                return nullptr;
+            },
+            job);
+
+        if (!started)
+        {
+            std::cerr << "Runtime Error: Cannot start worker thread" << std::endl;
+            exit(1);
+        }
+        m_threads.push_back(thread);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    m_stop = true;
+    for (auto &thread : m_threads)
+    {
+        pthread_join(thread, nullptr);
+    }
+}
+
+// Owners take their newest task, it is the one whose data is still hot
+TaskPool::task *TaskPool::pop(size_t index)
+{
+    worker &w = *m_workers[index];
+    std::lock_guard<std::mutex> guard(w.lock);
+
+    if (w.tasks.empty())
+    {
+        return nullptr;
+    }
+
+    task *t = w.tasks.back();
+    w.tasks.pop_back();
+    return t;
+}
+
+// Thieves take the oldest task, near the root it is the biggest one
+TaskPool::task *TaskPool::steal(size_t thief)
+{
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        worker &w = *m_workers[(thief + i) % m_workers.size()];
+        std::lock_guard<std::mutex> guard(w.lock);
+
+        if (!w.tasks.empty())
+        {
+            task *t = w.tasks.front();
+            w.tasks.pop_front();
+            return t;
+        }
+    }
+
+    return nullptr;
+}
+
+bool TaskPool::runOne(size_t index)
+{
+    task *t = pop(index);
+    if (t == nullptr)
+    {
+        t = steal(index);
+    }
+    if (t == nullptr)
+    {
+        return false;
+    }
+
+    t->run();
+    t->done.store(true, std::memory_order_release);
+    return true;
+}
+
+void TaskPool::loop(size_t index)
+{
+    t_index = index;
+
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        if (!runOne(index))
+        {
+            sched_yield();
+        }
+    }
+}
+
+void TaskPool::spawn(task *t)
+{
+    worker &w = *m_workers[t_index];
+    std::lock_guard<std::mutex> guard(w.lock);
+    w.tasks.push_back(t);
+}
+
+void TaskPool::join(task *t)
+{
+    while (!t->done.load(std::memory_order_acquire))
+    {
+        if (!runOne(t_index))
+        {
+            sched_yield();
+        }
+    }
+}
@@ -7,6 +7,7 @@ TypeCheckerVisitor::TypeCheckerVisitor()
 {
     m_last_type = T_VOID;
     m_expected_return_type = T_VOID;
+    m_current_function = nullptr;
     m_found_return = false;
     m_loop_depth = 0;
 }
@@ -186,6 +187,30 @@ void TypeCheckerVisitor::visitMod(mod *node)
     node->setResolvedType(T_INT);
 }
 
+void TypeCheckerVisitor::visitUnaryPlus(unary_plus *node)
+{
+    node->getChildrenList().front()->accept(*this);
+
+    if (m_last_type == T_VOID)
+    {
+        semanticError("Unary plus (+) invalid operand.");
+    }
+
+    node->setResolvedType(m_last_type);
+}
+
+void TypeCheckerVisitor::visitUnaryMinus(unary_minus *node)
+{
+    node->getChildrenList().front()->accept(*this);
+
+    if (m_last_type == T_VOID)
+    {
+        semanticError("Unary minus (-) invalid operand.");
+    }
+
+    node->setResolvedType(m_last_type);
+}
+
 void TypeCheckerVisitor::visitLess(less *node)
 {
     node->getChildrenList().front()->accept(*this);
@@ -735,13 +760,16 @@ void TypeCheckerVisitor::visitFunctionCall(function_call *node)
     {
         it++;
         (*it)->accept(*this);
-        for (auto &expr : m_args)
+
+        // Copy the arguments out because nested calls reuse m_args
+        std::vector<STNode *> args = m_args;
+        m_args.clear();
+
+        for (auto &expr : args)
         {
             expr->accept(*this);
             final_types.push_back(m_last_type);
         }
-
-        m_args.clear();
     }
 
     std::vector<parameter> &func_params = def->getParameters();
@@ -778,7 +806,7 @@ void TypeCheckerVisitor::visitFunctionDeclaration(function_declaration *node)
 
     FuncSymbol *sym = new FuncSymbol(return_type, nullptr, m_params, id);
 
-    if (!SymbolTable::getInstance()->insert(sym))
+    if (!SymbolTable::getInstance()->insertGlobal(sym))
     {
         semanticError("Function \"" + id + "\" already declared");
     }
@@ -820,6 +848,7 @@ void TypeCheckerVisitor::visitFunctionDefinition(function_definition *node)
             semanticError("Function \"" + id + "\" already defined");
         }
         existing->setFunctionBody(body);
+        m_current_function = existing;
     }
     else
     {
@@ -828,6 +857,7 @@ void TypeCheckerVisitor::visitFunctionDefinition(function_definition *node)
         {
             semanticError("Function \"" + id + "\" already defined");
         }
+        m_current_function = sym;
     }
 
     m_expected_return_type = return_type;
@@ -853,6 +883,7 @@ void TypeCheckerVisitor::visitFunctionDefinition(function_definition *node)
     }
 
     m_expected_return_type = T_VOID;
+    m_current_function = nullptr;
 }
 
 void TypeCheckerVisitor::visitVariableDeclaration(variable_declaration *node)
@@ -902,6 +933,10 @@ void TypeCheckerVisitor::visitVariableDeclarationStatement(
     it++;
     (*it)->accept(*this);
 
+    // Globals go to the global frame even when another visitor has a scope
+    // open, as with --stream
+    bool global = node->getParent()->getNodeType() == EXTERNAL_DECLARATION_NODE;
+
     for (auto &var : m_vars)
     {
         var->accept(*this);
@@ -929,7 +964,9 @@ void TypeCheckerVisitor::visitVariableDeclarationStatement(
                 ->getLabel(),
             current_type);
 
-        if (!SymbolTable::getInstance()->insert(sym))
+        bool inserted = global ? SymbolTable::getInstance()->insertGlobal(sym)
+                               : SymbolTable::getInstance()->insert(sym);
+        if (!inserted)
         {
             semanticError("Variable \"" + sym->getName() +
                           "\" already exists.");
@@ -965,6 +1002,29 @@ void TypeCheckerVisitor::visitReturn(return_node *node)
                       "expected return type");
     }
     node->setResolvedType(m_last_type);
+
+    // A call whose result is returned without conversion is in tail
+    // position, back ends can drop the caller's frame for it
+    if (childs.front()->getNodeType() == FUNCTION_CALL_NODE &&
+        m_last_type == m_expected_return_type)
+    {
+        std::string callee_name =
+            static_cast<IDENTIFIER *>(childs.front()->getChildrenList().front())
+                ->getLabel();
+        FuncSymbol *callee = dynamic_cast<FuncSymbol *>(
+            SymbolTable::getInstance()->lookupGlobal(callee_name));
+
+        std::vector<parameter> &ours = m_current_function->getParameters();
+        std::vector<parameter> &theirs = callee->getParameters();
+
+        bool same_signature = ours.size() == theirs.size();
+        for (size_t i = 0; same_signature && i < ours.size(); i++)
+        {
+            same_signature = ours[i].type == theirs[i].type;
+        }
+
+        node->setTailCall(same_signature ? MUST_TAIL_CALL : TAIL_CALL);
+    }
 }
 
 void TypeCheckerVisitor::visitIfStatement(if_statement *node)
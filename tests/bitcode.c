@@ -0,0 +1,54 @@
+// Values the bitcode writer encodes in their own ways: negative and large
+// constants, floats, globals with initial values, comparisons widened to
+// int, phis and void calls. Returns 0, or the number of the first check that
+// failed.
+
+int big = 2147483647;
+int small = -2147483647 - 1;
+float half = 2.0;
+int count;
+
+void tick()
+{
+    count++;
+}
+
+float scale(float x, int n)
+{
+    return x * n - 1.0;
+}
+
+int pick(int c, int a, int b)
+{
+    int r;
+    if (c)
+        r = a;
+    else
+        r = b;
+    return r;
+}
+
+int main()
+{
+    int i;
+    int t = 0;
+
+    if (!(big - 1 == 2147483646) || !(small + 1 == -2147483647))
+        return 1;
+    if (!(scale(half, 3) == 5.0) || !(half * 4 == 8))
+        return 2;
+    for (i = -3; i < 3; i++)
+    {
+        t = t + (i < 0) * 10 + (i == 2);
+    }
+    if (!(t == 31))
+        return 3;
+    if (!(pick(1, -7, 7) == -7) || !(pick(0, -7, 7) == 7))
+        return 4;
+    tick();
+    tick();
+    if (!(count == 2))
+        return 5;
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Statements and expressions the closure compiler turns into closures:
+// nested scopes that shadow a variable, every loop form with break and
+// continue, compound assignments and increments. Returns 0, or the number of
+// the first check that failed.
+
+int g = 100;
+
+int scopes(int x)
+{
+    int y = x;
+    {
+        int x = 5;
+        y = y + x;
+        {
+            int y = 1;
+            x = x + y;
+        }
+        y = y + x;
+    }
+    return y + x;
+}
+
+int loops(int n)
+{
+    int i;
+    int j;
+    int s = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        j = 0;
+        while (1)
+        {
+            j++;
+            if (j > i)
+            {
+                break;
+            }
+            if (j % 3 == 0)
+            {
+                continue;
+            }
+            s += j;
+        }
+    }
+
+    i = 0;
+    do
+    {
+        i += 2;
+    } while (i < n);
+
+    return s * 100 + i;
+}
+
+int main()
+{
+    int a = 17;
+    int b;
+
+    if (!(scopes(1) == 13))
+        return 1;
+    if (!(loops(7) == 3808))
+        return 2;
+
+    a += 3;
+    a -= 5;
+    a *= 4;
+    a /= 7;
+    a %= 5;
+    if (!(a == 3))
+        return 3;
+
+    b = a++ * 10;
+    b += ++a;
+    if (!(b == 35) || !(a == 5))
+        return 4;
+    b = a-- * 10;
+    b -= --a;
+    if (!(b == 47) || !(a == 3))
+        return 5;
+
+    g -= a;
+    g++;
+    if (!(g == 98))
+        return 6;
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+// x op= e evaluates e before it reads x, so an e that assigns x changes the
+// result. Returns 0, or the number of the first check that failed.
+
+int g0;
+
+int set(int v)
+{
+    g0 = v;
+    return 1;
+}
+
+int main()
+{
+    int a = 1;
+
+    g0 = 1;
+    g0 += (g0 = 5);
+    if (!(g0 == 10))
+        return 1;
+
+    a *= (a = 3) + 1;
+    if (!(a == 12))
+        return 2;
+
+    g0 = 7;
+    g0 -= set(20);
+    if (!(g0 == 19))
+        return 3;
+
+    a = 100;
+    a /= (a = 10) - 5;
+    if (!(a == 2))
+        return 4;
+
+    a = 100;
+    a %= (a = 17) - 10;
+    if (!(a == 3))
+        return 5;
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+// Equal computations are reused, but a loaded global only until it is
+// stored to or a call may have changed it. Returns 0, or the number of the
+// first check that failed.
+
+int g;
+
+void set(int x)
+{
+    g = x;
+}
+
+int repeat(int a, int b)
+{
+    int x = (a + b) * (a - b);
+    int y = (a + b) * (a - b);
+    if (a > b)
+        return x + (a + b) * (a - b);
+    return y - (a + b);
+}
+
+int main()
+{
+    int a;
+    int b;
+    int c;
+
+    if (!(repeat(5, 3) == 32) || !(repeat(3, 5) == -24))
+        return 1;
+
+    g = 2;
+    a = g * 10;
+    g = 3;
+    b = g * 10;
+    set(4);
+    c = g * 10;
+    if (!(a == 20) || !(b == 30) || !(c == 40))
+        return 2;
+
+    return 0;
+}
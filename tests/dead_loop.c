@@ -0,0 +1,17 @@
+// A loop that can't be reached after break, its variables have no
+// definition on any path into it. Returns 0.
+
+int main()
+{
+    int a = 0;
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        break;
+        while (a < 3)
+        {
+            a = a + 1;
+        }
+    }
+    return a;
+}
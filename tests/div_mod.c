@@ -0,0 +1,106 @@
+// Division and remainder round towards zero, also for negative operands and
+// when the divisor is a constant the compiler rewrites. Returns 0, or the
+// number of the first check that failed.
+
+int dividend(int i)
+{
+    if (i == 0)
+        return -2147483647 - 1;
+    if (i == 1)
+        return 2147483647;
+    if (i == 2)
+        return -1073741824;
+    if (i == 3)
+        return -100;
+    if (i == 4)
+        return -9;
+    if (i == 5)
+        return -7;
+    if (i == 6)
+        return -1;
+    if (i == 7)
+        return 0;
+    if (i == 8)
+        return 1;
+    if (i == 9)
+        return 9;
+    return 100;
+}
+
+// q and r must satisfy x = q * d + r, with r 0 or of the sign of x, and
+// smaller than d
+int wrong(int x, int d, int q, int r)
+{
+    if (!(q * d + r == x))
+        return 1;
+    if (x < 0 && r > 0)
+        return 1;
+    if (x > 0 && r < 0)
+        return 1;
+    if (d > 0 && (r >= d || -r >= d))
+        return 1;
+    if (d < 0 && (r <= d || -r <= d))
+        return 1;
+    return 0;
+}
+
+int main()
+{
+    int i;
+    int x;
+    int d;
+
+    // Known values, folded at compile time
+    if (!((-2147483647 - 1) / 8 == -268435456))
+        return 1;
+    if (!(-7 / 2 == -3) || !(-7 % 2 == -1))
+        return 2;
+    if (!(7 / -2 == -3) || !(7 % -2 == 1))
+        return 3;
+    if (!(-9 / 7 == -1) || !(-9 % 7 == -2))
+        return 4;
+    if (!(-9 / -7 == 1) || !(-9 % -7 == -2))
+        return 5;
+
+    for (i = 0; i < 11; i++)
+    {
+        x = dividend(i);
+
+        // Same values computed at run time
+        if (i == 0 && (!(x / 8 == -268435456) || !(x % 8 == 0)))
+            return 10;
+        if (i == 4 && (!(x / 7 == -1) || !(x % 7 == -2)))
+            return 11;
+        if (i == 4 && (!(x / -7 == 1) || !(x % -7 == -2)))
+            return 12;
+        if (i == 5 && (!(x / 2 == -3) || !(x % 2 == -1)))
+            return 13;
+        if (i == 5 && (!(x / -2 == 3) || !(x % -2 == -1)))
+            return 14;
+
+        // Constant divisors, powers of two and not
+        if (wrong(x, 2, x / 2, x % 2))
+            return 20 + i;
+        if (wrong(x, -2, x / -2, x % -2))
+            return 40 + i;
+        if (wrong(x, 8, x / 8, x % 8))
+            return 60 + i;
+        if (wrong(x, -8, x / -8, x % -8))
+            return 80 + i;
+        if (wrong(x, 1073741824, x / 1073741824, x % 1073741824))
+            return 100 + i;
+        if (wrong(x, -1073741824, x / -1073741824, x % -1073741824))
+            return 120 + i;
+        if (wrong(x, 7, x / 7, x % 7))
+            return 140 + i;
+        if (wrong(x, -7, x / -7, x % -7))
+            return 160 + i;
+
+        // Divisors only known at run time
+        d = dividend(10 - i);
+        if (!(d == 0) && wrong(x, d, x / d, x % d))
+            return 180 + i;
+    }
+
+    return 0;
+}
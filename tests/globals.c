@@ -0,0 +1,27 @@
+// Constant initializers become the globals' initial values, the rest run in
+// declaration order before main, after every constant one is in place.
+// Returns 0, or the number of the first check that failed.
+
+int a = 6 * 7;
+int b = -5;
+int c = a + 1;
+int d;
+
+int read_e();
+
+int e = 9;
+int f = read_e() * 2;
+
+int read_e()
+{
+    return e;
+}
+
+int main()
+{
+    if (!(a == 42) || !(b == -5) || !(c == 43) || !(d == 0))
+        return 1;
+    if (!(f == 18))
+        return 2;
+    return 0;
+}
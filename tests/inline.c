@@ -0,0 +1,68 @@
+// Small functions are copied into their callers, with several returns,
+// loops, calls of their own and globals. Recursive functions are never
+// copied. Returns 0, or the number of the first check that failed.
+
+int hits;
+
+int clamp(int x, int lo, int hi)
+{
+    if (x < lo)
+        return lo;
+    if (x > hi)
+        return hi;
+    return x;
+}
+
+int square(int x)
+{
+    return x * x;
+}
+
+int norm(int x, int y)
+{
+    return square(x) + square(y);
+}
+
+int hit(int x)
+{
+    hits++;
+    return x;
+}
+
+int triangle(int n)
+{
+    int s = 0;
+    while (n > 0)
+    {
+        s += n;
+        n--;
+    }
+    return s;
+}
+
+int fact(int n)
+{
+    if (n < 2)
+        return 1;
+    return n * fact(n - 1);
+}
+
+int main()
+{
+    int n = 4;
+
+    if (!(clamp(-5, 0, 10) == 0) || !(clamp(50, 0, 10) == 10) ||
+        !(clamp(7, 0, 10) == 7))
+        return 1;
+    if (!(norm(3, 4) == 25))
+        return 2;
+    if (!(hit(1) + hit(2) == 3) || !(hits == 2))
+        return 3;
+    // The parameter is a copy, n keeps its value
+    if (!(triangle(n) == 10) || !(n == 4))
+        return 4;
+    if (!(fact(10) == 3628800))
+        return 5;
+
+    return 0;
+}
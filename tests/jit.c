@@ -0,0 +1,76 @@
+// Everything the template JIT emits code for: arithmetic, comparisons, logic,
+// loops with break and continue, globals, void functions and recursion.
+// Returns 0, or the number of the first check that failed.
+
+int total;
+
+void add(int x)
+{
+    total += x;
+}
+
+int gcd(int a, int b)
+{
+    if (b == 0)
+        return a;
+    return gcd(b, a % b);
+}
+
+int bits(int x)
+{
+    int n = 0;
+    while (x)
+    {
+        n += x & 1;
+        x = x / 2;
+    }
+    return n;
+}
+
+int odd_sum(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < 100; i++)
+    {
+        if (i % 2 == 0)
+        {
+            continue;
+        }
+        if (i > n)
+        {
+            break;
+        }
+        s += i;
+    }
+    return s;
+}
+
+int main()
+{
+    int i = 7;
+
+    if (!(gcd(1071, 462) == 21))
+        return 1;
+    if (!(bits(2147483647) == 31) || !(bits(1023) == 10))
+        return 2;
+    if (!(odd_sum(9) == 25))
+        return 3;
+
+    if (!(-i / 2 == -3) || !(-i % 2 == -1) || !((i ^ 5) == 2) || !(~i == -8))
+        return 4;
+    if (!(i << 3 == 56) || !((i | 8) == 15) || !(!i == 0) || !(i * i == 49))
+        return 5;
+    if (!(i > 6 && i >= 7 && i <= 7 && i < 8) || i == 6)
+        return 6;
+
+    do
+    {
+        add(i);
+        i--;
+    } while (i > 0);
+    if (!(total == 28))
+        return 7;
+
+    return 0;
+}
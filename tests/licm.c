@@ -0,0 +1,70 @@
+// Loop invariant code is moved in front of the loop, but a global is not
+// loaded early when the loop or a call in it stores to it, and a division
+// that could trap stays where it only runs when the loop runs. Returns 0, or
+// the number of the first check that failed.
+
+int g;
+int limit;
+
+void grow()
+{
+    g++;
+}
+
+int invariant(int n, int m)
+{
+    int i;
+    int j;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n * m; j++)
+        {
+            s = s + n * m + limit;
+        }
+    }
+    return s;
+}
+
+int guarded(int n, int d)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        s = s + 100 / d;
+    }
+    return s;
+}
+
+int main()
+{
+    int i;
+    int s = 0;
+
+    limit = 1;
+    if (!(invariant(3, 2) == 3 * 6 * 7))
+        return 1;
+
+    for (i = 0; i < 5; i++)
+    {
+        s = s + g;
+        grow();
+    }
+    if (!(s == 10) || !(g == 5))
+        return 2;
+
+    for (i = 0; i < 5; i++)
+    {
+        s = s + g;
+        g = g + 2;
+    }
+    if (!(s == 55) || !(g == 15))
+        return 3;
+
+    // d is 0 but the loop never runs
+    if (!(guarded(0, 0) == 0) || !(guarded(4, 20) == 20))
+        return 4;
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Calls with more arguments than there are argument registers, the rest are
+// passed on the stack. Returns 0, or the number of the first check that
+// failed.
+
+int sum8(int a, int b, int c, int d, int e, int f, int g, int h)
+{
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h;
+}
+
+// The stack arguments of the tail call are copies in this frame
+int count(int n, int a, int b, int c, int d, int e, int f, int acc)
+{
+    if (n == 0)
+        return acc + a + b + c + d + e + f;
+    return count(n - 1, a, b, c, d, e, f, acc + n);
+}
+
+float mixed(float x0, int a, float x1, int b, float x2, int c, float x3,
+            int d, float x4, int e, float x5, int f, float x6, int g,
+            float x7, int h, float x8, float x9)
+{
+    return x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7 + x8 * 2 + x9 * 4 + a + b +
+           c + d + e + f + g + h * 100;
+}
+
+int hot(int i)
+{
+    return sum8(i, 1, 1, 1, 1, 1, 1, 1) - i;
+}
+
+int main()
+{
+    int i;
+    int s = 0;
+
+    if (!(sum8(1, 1, 1, 1, 1, 1, 1, 1) == 36))
+        return 1;
+
+    // Pending operands around the call change the alignment
+    if (!(1 + (2 + sum8(1, 2, 3, 4, 5, 6, 7, 8) * 2) == 411))
+        return 2;
+
+    // Calls inside the arguments
+    if (!(sum8(sum8(1, 1, 1, 1, 1, 1, 1, 1), 0, 0, 0, 0, 0, 0,
+               sum8(0, 0, 0, 0, 0, 0, 0, 1)) == 100))
+        return 3;
+
+    if (!(count(100, 1, 2, 3, 4, 5, 6, 0) == 5071))
+        return 4;
+
+    if (!(mixed(1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1) ==
+          121.0))
+        return 5;
+
+    // Hot enough to be compiled by the tiered interpreter
+    for (i = 0; i < 3000; i++)
+    {
+        s = s + hot(i);
+    }
+    if (!(s == 3000 * 35))
+        return 6;
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+// Pure functions may be answered from the memo cache, functions that read or
+// write globals, directly or through a call, must run every time. Returns 0,
+// or the number of the first check that failed.
+
+int offset;
+int calls;
+
+int fib(int n)
+{
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int shifted(int n)
+{
+    return n + offset;
+}
+
+int counted(int n)
+{
+    calls++;
+    return n * 2;
+}
+
+int indirect(int n)
+{
+    return shifted(n) - n;
+}
+
+int main()
+{
+    int i;
+
+    if (!(fib(24) == 46368) || !(fib(24) == 46368))
+        return 1;
+
+    for (i = 0; i < 3; i++)
+    {
+        offset = i;
+        if (!(shifted(10) == 10 + i) || !(indirect(10) == i))
+            return 2;
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        counted(7);
+    }
+    if (!(calls == 5))
+        return 3;
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+// With --parallel the right operand of a binary expression of two pure calls
+// is forked, the result must not depend on which side finishes first. Calls
+// that touch globals stay in source order. Returns 0, or the number of the
+// first check that failed.
+
+int trace;
+
+int fib(int n)
+{
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int weight(int n)
+{
+    if (n < 2)
+        return 1;
+    return weight(n - 1) * 2 - weight(n - 2);
+}
+
+int log_call(int digit)
+{
+    trace = trace * 10 + digit;
+    return digit;
+}
+
+int main()
+{
+    int i;
+
+    if (!(fib(23) - fib(22) == 10946))
+        return 1;
+    if (!(weight(20) == 1))
+        return 2;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (!(fib(18 + i) / fib(16 + i) == 2))
+            return 3;
+    }
+
+    if (!(log_call(1) - log_call(2) * log_call(3) == -5) ||
+        !(trace == 123))
+        return 4;
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+// --precompute runs main at compile time and writes its result and the
+// globals into the IR, they must match what the compiled program computes.
+// Returns 0, or the number of the first check that failed.
+
+int g0;
+int count;
+
+int step(int x)
+{
+    count++;
+    if (x % 2 == 0)
+        return x / 2;
+    return 3 * x + 1;
+}
+
+int main()
+{
+    int x = 27;
+    int steps = 0;
+
+    while (x > 1)
+    {
+        x = step(x);
+        steps++;
+    }
+    if (!(steps == 111) || !(count == 111))
+        return 1;
+
+    // The right side of a compound assignment runs first
+    g0 = 1;
+    g0 += (g0 = 5);
+    if (!(g0 == 10))
+        return 2;
+
+    // Wraps like the emitted IR instead of overflowing
+    x = 2147483647;
+    x = x + 1;
+    if (!(x == -2147483647 - 1))
+        return 3;
+    x = 65536;
+    if (!(x * x == 0))
+        return 4;
+    x = -1;
+    if (!(x << 31 == -2147483647 - 1))
+        return 5;
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+// The right side of && and || only runs when it decides the result, both in
+// conditions and where the result is used as a value. Returns 0, or the
+// number of the first check that failed.
+
+int calls;
+
+int yes()
+{
+    calls++;
+    return 1;
+}
+
+int no()
+{
+    calls++;
+    return 0;
+}
+
+int main()
+{
+    int v;
+
+    if (no() && yes())
+        return 1;
+    if (!(yes() || no()))
+        return 2;
+    if (!(calls == 2))
+        return 3;
+
+    v = yes() && no();
+    v = v * 10 + (no() || yes());
+    v = v * 10 + (no() || no() && yes());
+    if (!(v == 10) || !(calls == 8))
+        return 4;
+
+    while (no() || yes() && calls < 12)
+    {
+    }
+    if (!(calls == 12))
+        return 5;
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+// With --stream every function is optimized and printed before the next one
+// is read. A call to a function defined further down may write any global,
+// so the loops and repeated calls of its caller must stay as written.
+// Returns 0, or the number of the first check that failed.
+
+int step;
+int total = 0;
+
+void advance(int n);
+int peek();
+
+int twice()
+{
+    return peek() + peek();
+}
+
+int walk(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        s = s + step;
+        advance(1);
+    }
+    return s;
+}
+
+int first = 40;
+int second = 2;
+
+int main()
+{
+    if (!(walk(4) == 6) || !(step == 4))
+        return 1;
+    if (!(twice() == 9) || !(total == 2))
+        return 2;
+    if (!(first + second == 42))
+        return 3;
+    return 0;
+}
+
+void advance(int n)
+{
+    step = step + n;
+}
+
+int peek()
+{
+    total++;
+    return step + total - 1;
+}
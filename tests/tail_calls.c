@@ -0,0 +1,46 @@
+// Calls in tail position reuse the caller's frame, so they nest far deeper
+// than the call depth limit. Returns 0, or the number of the first check
+// that failed.
+
+int sum(int n, int acc)
+{
+    if (n == 0)
+        return acc;
+    return sum(n - 1, acc + n % 10);
+}
+
+int is_odd(int n);
+
+int is_even(int n)
+{
+    if (n == 0)
+        return 1;
+    return is_odd(n - 1);
+}
+
+int is_odd(int n)
+{
+    if (n == 0)
+        return 0;
+    return is_even(n - 1);
+}
+
+// Not a tail call, the result is still added to
+int depth(int n)
+{
+    if (n == 0)
+        return 0;
+    return 1 + depth(n - 1);
+}
+
+int main()
+{
+    if (!(sum(1000000, 0) == 4500000))
+        return 1;
+    if (!(is_even(300001) == 0) || !(is_odd(300001) == 1))
+        return 2;
+    if (!(depth(5000) == 5000))
+        return 3;
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+// Functions are promoted to compiled code while the program runs: between two
+// calls, from inside a long loop and while interpreted frames of the same
+// function are still on the stack. Returns 0, or the number of the first
+// check that failed.
+
+int calls;
+
+int bump(int x)
+{
+    calls++;
+    return x + 1;
+}
+
+int spin(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        s = s + i % 7;
+    }
+    return s;
+}
+
+int depth(int n)
+{
+    if (n == 0)
+        return spin(3000);
+    return depth(n - 1) + bump(0);
+}
+
+int main()
+{
+    int i;
+    int s = 0;
+
+    for (i = 0; i < 5000; i++)
+    {
+        s = bump(s);
+    }
+    if (!(s == 5000) || !(calls == 5000))
+        return 1;
+
+    if (!(spin(5000) == 14995) || !(spin(5000) == 14995))
+        return 2;
+
+    if (!(depth(2000) == 8994 + 2000) || !(calls == 7000))
+        return 3;
+
+    return 0;
+}
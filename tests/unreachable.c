@@ -0,0 +1,69 @@
+// Code after return, break and continue and branches on constants are
+// dropped, the code that is left must still compute the same. Returns 0, or
+// the number of the first check that failed.
+
+int g;
+
+int early(int x)
+{
+    if (x > 0)
+    {
+        return 1;
+        g = 5;
+    }
+    else
+    {
+        return -1;
+    }
+    g = 6;
+    return 0;
+}
+
+int skip(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (1)
+        {
+            continue;
+            s = s + 100;
+        }
+        s = s + 1000;
+    }
+    while (0)
+    {
+        s = s + 10000;
+    }
+    if (0)
+    {
+        s = -1;
+    }
+    else
+    {
+        s = s + i;
+    }
+    return s;
+}
+
+void nothing()
+{
+    {
+    }
+    if (g)
+    {
+    }
+}
+
+int main()
+{
+    if (!(early(3) == 1) || !(early(-3) == -1) || !(g == 0))
+        return 1;
+    if (!(skip(5) == 5))
+        return 2;
+    nothing();
+    if (2 > 1 && 0)
+        return 3;
+    return 0;
+}